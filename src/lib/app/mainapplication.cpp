@@ -40,12 +40,13 @@
 #include "globalfunctions.h"
 #include "profileupdater.h"
 #include "searchenginesmanager.h"
-#include "databasewriter.h"
+#include "databaseexecutor.h"
 #include "speeddial.h"
 #include "webpage.h"
 #include "settings.h"
 #include "locationbarsettings.h"
 #include "webviewsettings.h"
+#include "locationcompleterindex.h"
 
 #ifdef Q_WS_MAC
 #include <QFileOpenEvent>
@@ -99,7 +100,8 @@ MainApplication::MainApplication(const QList<CommandLineOptions::ActionPair> &cm
     , m_desktopNotifications(0)
     , m_iconProvider(new IconProvider(this))
     , m_searchEnginesManager(0)
-    , m_dbWriter(new DatabaseWriter())
+    , m_dbExecutor(0)
+    , m_completerIndex(0)
     , m_isClosing(false)
     , m_isStateChanged(false)
     , m_isExited(false)
@@ -244,7 +246,6 @@ MainApplication::MainApplication(const QList<CommandLineOptions::ActionPair> &cm
         settings2.setValue("Plugin-Settings/EnablePlugins", false);
     }
 
-    networkManager()->loadCertificates();
     plugins()->loadPlugins();
     loadSettings();
 
@@ -265,9 +266,18 @@ void MainApplication::postLaunch()
         downManager()->show();
     }
 
+    // Download manager resumes downloads interrupted by closing browser
+    Settings settings;
+    if (settings.value("DownloadManager/ResumeDownloads", false).toBool()) {
+        downManager();
+    }
+
     if (m_postLaunchActions.contains(OpenNewTab)) {
         getWindow()->tabWidget()->addView(QUrl(), Qz::NT_SelectedTabAtTheEnd);
     }
+
+    // Index for location bar completion is built in background
+    completerIndex();
 }
 
 void MainApplication::loadSettings()
@@ -539,6 +549,10 @@ void MainApplication::connectDatabase()
         qWarning("Cannot open SQLite database! Continuing without database....");
     }
 
+    // Readers don't block writer (and the other way around) in WAL mode,
+    // the mode is persistent so it only changes on first start
+    db.exec("PRAGMA journal_mode=WAL");
+
     m_databaseConnected = true;
 }
 
@@ -615,6 +629,10 @@ void MainApplication::saveSettings()
     if (deleteCookies) {
         m_cookiejar->clearCookies();
     }
+    if (m_historymodel) {
+        // Write all visits that are still waiting in buffer
+        m_historymodel->flushHistory(true);
+    }
     if (deleteHistory) {
         m_historymodel->clearHistory();
     }
@@ -627,7 +645,16 @@ void MainApplication::saveSettings()
     m_networkmanager->saveCertificates();
     m_plugins->c2f_saveSettings();
     m_plugins->speedDial()->saveSettings();
-    m_iconProvider->saveIconsToDatabase();
+    m_iconProvider->flushIcons();
+
+    if (m_dbExecutor) {
+        // Everything queued until now has to be written before quit
+        m_dbExecutor->flush();
+    }
+
+    if (m_downloadManager) {
+        m_downloadManager->saveDownloads();
+    }
 
     AdBlockManager::instance()->save();
     QFile::remove(getActiveProfilPath() + "WebpageIcons.db");
@@ -658,6 +685,14 @@ CookieManager* MainApplication::cookieManager()
     return m_cookiemanager;
 }
 
+DatabaseExecutor* MainApplication::dbExecutor()
+{
+    if (!m_dbExecutor) {
+        m_dbExecutor = new DatabaseExecutor(m_activeProfil + "browsedata.db", this);
+    }
+    return m_dbExecutor;
+}
+
 HistoryModel* MainApplication::history()
 {
     if (!m_historymodel) {
@@ -715,6 +750,14 @@ DownloadManager* MainApplication::downManager()
     return m_downloadManager;
 }
 
+LocationCompleterIndex* MainApplication::completerIndex()
+{
+    if (!m_completerIndex) {
+        m_completerIndex = new LocationCompleterIndex(this);
+    }
+    return m_completerIndex;
+}
+
 AutoFillModel* MainApplication::autoFill()
 {
     if (!m_autofill) {
@@ -46,7 +46,8 @@ class AutoFillModel;
 class DesktopNotificationsFactory;
 class IconProvider;
 class SearchEnginesManager;
-class DatabaseWriter;
+class DatabaseExecutor;
+class LocationCompleterIndex;
 
 class QT_QUPZILLA_EXPORT MainApplication : public QtSingleApplication
 {
@@ -92,10 +93,11 @@ public:
     DownloadManager* downManager();
     AutoFillModel* autoFill();
     SearchEnginesManager* searchEnginesManager();
+    LocationCompleterIndex* completerIndex();
     QNetworkDiskCache* networkCache() { return m_networkCache; }
     DesktopNotificationsFactory* desktopNotifications();
     IconProvider* iconProvider() { return m_iconProvider; }
-    DatabaseWriter* dbWriter() { return m_dbWriter; }
+    DatabaseExecutor* dbExecutor();
 
 #ifdef Q_WS_MAC
     bool event(QEvent* e);
@@ -141,7 +143,8 @@ private:
     DesktopNotificationsFactory* m_desktopNotifications;
     IconProvider* m_iconProvider;
     SearchEnginesManager* m_searchEnginesManager;
-    DatabaseWriter* m_dbWriter;
+    DatabaseExecutor* m_dbExecutor;
+    LocationCompleterIndex* m_completerIndex;
 
     QList<QWeakPointer<QupZilla> > m_mainWindows;
 
@@ -19,9 +19,17 @@
 #include "qupzilla.h"
 #include "updater.h"
 #include "mainapplication.h"
+#include "historymodel.h"
+#include "fulltextsearch.h"
+#include "iconprovider.h"
 
 #include <QDir>
 #include <QSqlQuery>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QElapsedTimer>
+#include <QDateTime>
+#include <QDebug>
 #include <iostream>
 
 ProfileUpdater::ProfileUpdater(const QString &profilePath)
@@ -54,6 +62,8 @@ void ProfileUpdater::checkProfile()
     versionFile.open(QFile::WriteOnly);
     versionFile.write(QupZilla::VERSION.toUtf8());
     versionFile.close();
+
+    updateDatabase();
 }
 
 void ProfileUpdater::updateProfile(const QString &current, const QString &profile)
@@ -108,6 +118,251 @@ void ProfileUpdater::copyDataToProfile()
     QFile(m_profilePath + "browsedata.db").setPermissions(QFile::ReadUser | QFile::WriteUser);
 }
 
+// Every schema change gets a new migration with the next version number (versions
+// must be consecutive). Upgrade statements are separated with semicolon, changes
+// that need more than plain statements (eg. data conversion) can use upgrade
+// function, which is called after the statements.
+// Downgrade statements are saved into database, so even older versions that don't
+// know about the migration can revert it.
+struct DatabaseMigration {
+    int version;
+    const char* description;
+    bool (*upgrade)(QSqlDatabase &db);
+    const char* upgradeStatements;
+    const char* downgradeStatements;
+};
+
+static bool migrateHistoryFrecency(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    query.exec("SELECT frecency FROM history LIMIT 1");
+    if (!query.lastError().isValid()) {
+        return query.exec("CREATE INDEX IF NOT EXISTS historyFrecency ON history(frecency DESC)");
+    }
+
+    if (!query.exec("ALTER TABLE history ADD COLUMN frecency NUMERIC DEFAULT 0") ||
+            !query.exec("CREATE INDEX IF NOT EXISTS historyFrecency ON history(frecency DESC)")) {
+        return false;
+    }
+
+    // Only count and date of the last visit is known for existing entries,
+    // so all of their visits are counted as made at that time
+    QSqlQuery update(db);
+    update.prepare("UPDATE history SET frecency=? WHERE id=?");
+
+    query.exec("SELECT id, count, date FROM history");
+    while (query.next()) {
+        int count = qMax(1, query.value(1).toInt());
+        qint64 date = query.value(2).toLongLong();
+
+        update.addBindValue(count * HistoryModel::frecencyForVisit(HistoryModel::LinkTransition, date));
+        update.addBindValue(query.value(0).toInt());
+        if (!update.exec()) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Icons were stored as one blob per page url, now every distinct icon is stored only once
+static bool migrateIconStorage(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    query.exec("SELECT name FROM sqlite_master WHERE type='table' AND name='icons'");
+    if (!query.next()) {
+        return true;
+    }
+
+    QSqlQuery insertData(db);
+    insertData.prepare("INSERT OR IGNORE INTO icon_data (hash, icon) VALUES (?, ?)");
+    QSqlQuery insertUrl(db);
+    insertUrl.prepare("INSERT OR REPLACE INTO icon_urls (url, data_id) SELECT ?, id FROM icon_data WHERE hash=?");
+    QSqlQuery insertHost(db);
+    insertHost.prepare("INSERT OR REPLACE INTO icon_hosts (host, data_id) SELECT ?, id FROM icon_data WHERE hash=?");
+
+    query.exec("SELECT url, icon FROM icons");
+    while (query.next()) {
+        const QByteArray url = query.value(0).toByteArray();
+        const QByteArray icon = query.value(1).toByteArray();
+        if (url.isEmpty() || icon.isEmpty()) {
+            continue;
+        }
+
+        const QString hash = IconProvider::iconHash(icon);
+
+        insertData.addBindValue(hash);
+        insertData.addBindValue(icon);
+        insertUrl.addBindValue(QString::fromUtf8(url));
+        insertUrl.addBindValue(hash);
+        insertHost.addBindValue(QUrl::fromEncoded(url).host());
+        insertHost.addBindValue(hash);
+
+        if (!insertData.exec() || !insertUrl.exec() || !insertHost.exec()) {
+            return false;
+        }
+    }
+
+    return query.exec("DROP TABLE icons");
+}
+
+static const DatabaseMigration s_migrations[] = {
+    {
+        1, "visits table and history frecency", migrateHistoryFrecency,
+        "CREATE TABLE IF NOT EXISTS visits (id INTEGER PRIMARY KEY, history_id INTEGER, date NUMERIC, transition NUMERIC);"
+        "CREATE INDEX IF NOT EXISTS visitsHistoryId ON visits(history_id ASC)",
+        0
+    },
+    {
+        2, "indexes for most visited, recent history, bookmark folders and rss", 0,
+        "CREATE INDEX IF NOT EXISTS historyCount ON history(count DESC);"
+        "CREATE INDEX IF NOT EXISTS historyDate ON history(date DESC);"
+        "CREATE INDEX IF NOT EXISTS bookmarksFolder ON bookmarks(folder ASC, toolbar_position ASC);"
+        "CREATE INDEX IF NOT EXISTS rssAddress ON rss(address ASC)",
+        "DROP INDEX IF EXISTS historyCount;"
+        "DROP INDEX IF EXISTS historyDate;"
+        "DROP INDEX IF EXISTS bookmarksFolder;"
+        "DROP INDEX IF EXISTS rssAddress"
+    },
+    {
+        3, "content addressed icon storage", migrateIconStorage,
+        "CREATE TABLE IF NOT EXISTS icon_data (id INTEGER PRIMARY KEY, hash TEXT, icon BLOB);"
+        "CREATE UNIQUE INDEX IF NOT EXISTS iconDataHash ON icon_data(hash ASC);"
+        "CREATE TABLE IF NOT EXISTS icon_urls (url TEXT PRIMARY KEY, data_id INTEGER);"
+        "CREATE INDEX IF NOT EXISTS iconUrlsDataId ON icon_urls(data_id ASC);"
+        "CREATE TABLE IF NOT EXISTS icon_hosts (host TEXT PRIMARY KEY, data_id INTEGER);"
+        "CREATE INDEX IF NOT EXISTS iconHostsDataId ON icon_hosts(data_id ASC)",
+        "CREATE TABLE IF NOT EXISTS icons (icon TEXT, id INTEGER PRIMARY KEY, url TEXT);"
+        "CREATE UNIQUE INDEX IF NOT EXISTS iconsUrl ON icons(url ASC);"
+        "INSERT OR REPLACE INTO icons (icon, url) SELECT d.icon, CAST(u.url AS BLOB) FROM icon_urls u JOIN icon_data d ON d.id=u.data_id;"
+        "DROP TABLE icon_hosts;"
+        "DROP TABLE icon_urls;"
+        "DROP TABLE icon_data"
+    }
+};
+
+static const int s_migrationsCount = sizeof(s_migrations) / sizeof(DatabaseMigration);
+
+static bool execStatements(QSqlDatabase &db, const QString &statements)
+{
+    QSqlQuery query(db);
+    foreach(const QString & statement, statements.split(QLatin1Char(';'), QString::SkipEmptyParts)) {
+        if (!query.exec(statement)) {
+            qWarning() << "ProfileUpdater: Cannot execute" << statement << query.lastError().text();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int ProfileUpdater::databaseVersion()
+{
+    QSqlQuery query;
+    query.exec("PRAGMA user_version");
+    return query.next() ? query.value(0).toInt() : 0;
+}
+
+// Changes of database schema
+void ProfileUpdater::updateDatabase()
+{
+    mApp->connectDatabase();
+
+    QSqlDatabase db = QSqlDatabase::database();
+    QSqlQuery query(db);
+    query.exec("CREATE TABLE IF NOT EXISTS schema_migrations (version INTEGER PRIMARY KEY, description TEXT, downgrade TEXT, date NUMERIC)");
+
+    const int version = databaseVersion();
+    const int latestVersion = s_migrations[s_migrationsCount - 1].version;
+
+    if (version > latestVersion) {
+        downgradeDatabase(version, latestVersion);
+    }
+
+    for (int i = 0; i < s_migrationsCount; ++i) {
+        const DatabaseMigration &migration = s_migrations[i];
+        if (migration.version <= version) {
+            continue;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+
+        db.transaction();
+
+        bool ok = execStatements(db, QString::fromLatin1(migration.upgradeStatements)) &&
+                  (!migration.upgrade || migration.upgrade(db));
+
+        if (ok) {
+            query.prepare("INSERT OR REPLACE INTO schema_migrations (version, description, downgrade, date) VALUES (?, ?, ?, ?)");
+            query.addBindValue(migration.version);
+            query.addBindValue(QString::fromLatin1(migration.description));
+            query.addBindValue(migration.downgradeStatements ? QString::fromLatin1(migration.downgradeStatements) : QString());
+            query.addBindValue(QDateTime::currentMSecsSinceEpoch());
+
+            ok = query.exec() && query.exec(QString("PRAGMA user_version = %1").arg(migration.version));
+        }
+
+        if (!ok || !db.commit()) {
+            db.rollback();
+            qWarning() << "ProfileUpdater: Database migration to version" << migration.version << "failed, schema stays at version" << databaseVersion();
+            break;
+        }
+
+        std::cout << "migrated database to version " << migration.version << " (" << migration.description << ") in "
+                  << timer.elapsed() << " ms" << std::endl;
+    }
+
+    FullTextSearch::createTables(db);
+}
+
+// Database was already migrated by newer version, revert its migrations using
+// statements saved with them
+void ProfileUpdater::downgradeDatabase(int version, int targetVersion)
+{
+    QSqlDatabase db = QSqlDatabase::database();
+    QSqlQuery query(db);
+
+    QList<QPair<int, QString> > downgrades;
+    query.prepare("SELECT version, downgrade FROM schema_migrations WHERE version > ? ORDER BY version DESC");
+    query.addBindValue(targetVersion);
+    query.exec();
+    while (query.next()) {
+        downgrades.append(qMakePair(query.value(0).toInt(), query.value(1).toString()));
+    }
+
+    for (int i = 0; i < downgrades.count(); ++i) {
+        const int migrationVersion = downgrades.at(i).first;
+        const QString &statements = downgrades.at(i).second;
+
+        if (migrationVersion != version || statements.isEmpty()) {
+            qWarning() << "ProfileUpdater: Database version" << version << "cannot be downgraded, keeping newer schema";
+            return;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+
+        db.transaction();
+
+        query.prepare("DELETE FROM schema_migrations WHERE version=?");
+        query.addBindValue(migrationVersion);
+
+        bool ok = execStatements(db, statements) && query.exec() &&
+                  query.exec(QString("PRAGMA user_version = %1").arg(migrationVersion - 1));
+
+        if (!ok || !db.commit()) {
+            db.rollback();
+            qWarning() << "ProfileUpdater: Database downgrade from version" << migrationVersion << "failed, keeping newer schema";
+            return;
+        }
+
+        --version;
+
+        std::cout << "downgraded database to version " << version << " in " << timer.elapsed() << " ms" << std::endl;
+    }
+}
+
 void ProfileUpdater::update100b4()
 {
     std::cout << "upgrading profile version from 1.0.0-b4..." << std::endl;
@@ -31,6 +31,9 @@ public:
 private:
     void updateProfile(const QString &current, const QString &profile);
     void copyDataToProfile();
+    void updateDatabase();
+    void downgradeDatabase(int version, int targetVersion);
+    int databaseVersion();
 
     void update100b4();
     void update100rc1();
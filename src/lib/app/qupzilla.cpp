@@ -22,6 +22,7 @@
 #include "tabbedwebview.h"
 #include "lineedit.h"
 #include "historymodel.h"
+#include "historycache.h"
 #include "locationbar.h"
 #include "searchtoolbar.h"
 #include "websearchbar.h"
@@ -70,7 +71,6 @@
 #include <QTimer>
 #include <QShortcut>
 #include <QStackedWidget>
-#include <QSqlQuery>
 #include <QTextCodec>
 #include <QFileDialog>
 #include <QNetworkRequest>
@@ -426,6 +426,7 @@ void QupZilla::setupMenu()
 
     m_menuHistoryMost = new Menu(tr("Most Visited"), m_menuHistory);
     connect(m_menuHistoryMost, SIGNAL(aboutToShow()), this, SLOT(aboutToShowHistoryMostMenu()));
+    connect(mApp->history()->cache(), SIGNAL(entriesLoaded()), this, SLOT(historyCacheLoaded()));
 
     m_menuHistory->addMenu(m_menuHistoryRecent);
     m_menuHistory->addMenu(m_menuHistoryMost);
@@ -443,6 +444,17 @@ void QupZilla::setupMenu()
     connect(m_menuBookmarks, SIGNAL(aboutToShow()), this, SLOT(aboutToShowBookmarksMenu()));
     connect(m_menuBookmarks, SIGNAL(menuMiddleClicked(Menu*)), this, SLOT(loadFolderBookmarks(Menu*)));
 
+    BookmarksModel* bookmarksModel = mApp->bookmarksModel();
+    connect(bookmarksModel, SIGNAL(bookmarkAdded(BookmarksModel::Bookmark)), this, SLOT(bookmarkAddedToMenu(BookmarksModel::Bookmark)));
+    connect(bookmarksModel, SIGNAL(bookmarkDeleted(BookmarksModel::Bookmark)), this, SLOT(bookmarkDeletedFromMenu(BookmarksModel::Bookmark)));
+    connect(bookmarksModel, SIGNAL(bookmarkEdited(BookmarksModel::Bookmark, BookmarksModel::Bookmark)),
+            this, SLOT(bookmarkEditedInMenu(BookmarksModel::Bookmark, BookmarksModel::Bookmark)));
+    connect(bookmarksModel, SIGNAL(folderAdded(QString)), this, SLOT(bookmarkFoldersChanged()));
+    connect(bookmarksModel, SIGNAL(subfolderAdded(QString)), this, SLOT(bookmarkFoldersChanged()));
+    connect(bookmarksModel, SIGNAL(folderDeleted(QString)), this, SLOT(bookmarkFoldersChanged()));
+    connect(bookmarksModel, SIGNAL(folderRenamed(QString, QString)), this, SLOT(bookmarkFoldersChanged()));
+    connect(bookmarksModel, SIGNAL(bookmarksImported(QList<BookmarksModel::Bookmark>)), this, SLOT(bookmarkFoldersChanged()));
+
     /**************
      * Tools Menu *
      **************/
@@ -702,7 +714,7 @@ void QupZilla::receiveMessage(Qz::AppMessageType mes, bool state)
         break;
 
     case Qz::AM_BookmarksChanged:
-        m_bookmarksMenuChanged = true;
+        // Bookmarks menu is updated from BookmarksModel signals
         break;
 
     case Qz::AM_StartPrivateBrowsing:
@@ -727,14 +739,20 @@ void QupZilla::aboutToHideFileMenu()
 
 void QupZilla::aboutToShowBookmarksMenu()
 {
+    if (m_menuBookmarksAction) {
+        m_menuBookmarksAction->setVisible(m_bookmarksToolbar->isVisible());
+    }
+
     if (!m_bookmarksMenuChanged) {
-        if (m_menuBookmarksAction) {
-            m_menuBookmarksAction->setVisible(m_bookmarksToolbar->isVisible());
-        }
         return;
     }
     m_bookmarksMenuChanged = false;
 
+    rebuildBookmarksMenu();
+}
+
+void QupZilla::rebuildBookmarksMenu()
+{
     while (m_menuBookmarks->actions().count() != 4) {
         QAction* act = m_menuBookmarks->actions().at(4);
         if (act->menu()) {
@@ -744,82 +762,135 @@ void QupZilla::aboutToShowBookmarksMenu()
         delete act;
     }
 
-    QSqlQuery query;
-    query.exec("SELECT title, url, icon FROM bookmarks WHERE folder='bookmarksMenu'");
-    while (query.next()) {
-        QString title = query.value(0).toString();
-        const QUrl &url = query.value(1).toUrl();
-        const QIcon &icon = IconProvider::iconFromImage(QImage::fromData(query.value(2).toByteArray()));
-        if (title.length() > 40) {
-            title.truncate(40);
-            title += "..";
-        }
+    qDeleteAll(m_bookmarksMenuFolders);
+    m_bookmarksMenuFolders.clear();
+    m_bookmarksMenuActions.clear();
 
-        Action* act = new Action(icon, title);
-        act->setData(url);
-        connect(act, SIGNAL(triggered()), this, SLOT(loadActionUrl()));
-        connect(act, SIGNAL(middleClicked()), this, SLOT(loadActionUrlInNewNotSelectedTab()));
-        m_menuBookmarks->addAction(act);
+    BookmarksModel* bookmarksModel = mApp->bookmarksModel();
+
+    foreach(const Bookmark & bookmark, bookmarksModel->folderBookmarks("bookmarksMenu")) {
+        m_menuBookmarks->addAction(createBookmarkAction(bookmark, m_menuBookmarks));
     }
 
     Menu* menuBookmarks = new Menu(_bookmarksToolbar, m_menuBookmarks);
     menuBookmarks->setIcon(QIcon(style()->standardIcon(QStyle::SP_DirOpenIcon)));
 
-    query.exec("SELECT title, url, icon FROM bookmarks WHERE folder='bookmarksToolbar'");
-    while (query.next()) {
-        QString title = query.value(0).toString();
-        const QUrl &url = query.value(1).toUrl();
-        const QIcon &icon = IconProvider::iconFromImage(QImage::fromData(query.value(2).toByteArray()));
-        if (title.length() > 40) {
-            title.truncate(40);
-            title += "..";
-        }
-
-        Action* act = new Action(icon, title);
-        act->setData(url);
-        connect(act, SIGNAL(triggered()), this, SLOT(loadActionUrl()));
-        connect(act, SIGNAL(middleClicked()), this, SLOT(loadActionUrlInNewNotSelectedTab()));
-        menuBookmarks->addAction(act);
+    foreach(const Bookmark & bookmark, bookmarksModel->folderBookmarks("bookmarksToolbar")) {
+        menuBookmarks->addAction(createBookmarkAction(bookmark, menuBookmarks));
     }
     if (menuBookmarks->isEmpty()) {
         menuBookmarks->addAction(tr("Empty"))->setEnabled(false);
     }
     m_menuBookmarksAction = m_menuBookmarks->addMenu(menuBookmarks);
+    m_bookmarksMenuFolders.insert("bookmarksToolbar", menuBookmarks);
 
-    query.exec("SELECT name FROM folders");
-    while (query.next()) {
-        const QString &folderName = query.value(0).toString();
-        Menu* tempFolder = new Menu(folderName, m_menuBookmarks);
+    foreach(const BookmarksModel::Folder & folder, bookmarksModel->folders()) {
+        Menu* tempFolder = new Menu(folder.name, m_menuBookmarks);
         tempFolder->setIcon(QIcon(style()->standardIcon(QStyle::SP_DirOpenIcon)));
 
-        QSqlQuery query2;
-        query2.prepare("SELECT title, url, icon FROM bookmarks WHERE folder=?");
-        query2.addBindValue(folderName);
-        query2.exec();
-        while (query2.next()) {
-            QString title = query2.value(0).toString();
-            const QUrl &url = query2.value(1).toUrl();
-            const QIcon &icon = IconProvider::iconFromImage(QImage::fromData(query2.value(2).toByteArray()));
-            if (title.length() > 40) {
-                title.truncate(40);
-                title += "..";
-            }
-
-            Action* act = new Action(icon, title);
-            act->setData(url);
-            connect(act, SIGNAL(triggered()), this, SLOT(loadActionUrl()));
-            connect(act, SIGNAL(middleClicked()), this, SLOT(loadActionUrlInNewNotSelectedTab()));
-            tempFolder->addAction(act);
+        foreach(const Bookmark & bookmark, bookmarksModel->folderBookmarks(folder.name)) {
+            tempFolder->addAction(createBookmarkAction(bookmark, tempFolder));
         }
         if (tempFolder->isEmpty()) {
             tempFolder->addAction(tr("Empty"))->setEnabled(false);
         }
         m_menuBookmarks->addMenu(tempFolder);
+        m_bookmarksMenuFolders.insert(folder.name, tempFolder);
     }
 
     m_menuBookmarksAction->setVisible(m_bookmarksToolbar->isVisible());
 }
 
+Action* QupZilla::createBookmarkAction(const BookmarksModel::Bookmark &bookmark, QObject* parent)
+{
+    QString title = bookmark.title;
+    if (title.length() > 40) {
+        title.truncate(40);
+        title += "..";
+    }
+
+    Action* act = new Action(IconProvider::iconFromImage(bookmark.image), title, parent);
+    act->setData(bookmark.url);
+    connect(act, SIGNAL(triggered()), this, SLOT(loadActionUrl()));
+    connect(act, SIGNAL(middleClicked()), this, SLOT(loadActionUrlInNewNotSelectedTab()));
+
+    m_bookmarksMenuActions.insert(bookmark.id, act);
+    return act;
+}
+
+void QupZilla::bookmarkAddedToMenu(const BookmarksModel::Bookmark &bookmark)
+{
+    // Menu was not built yet or it is going to be rebuilt
+    if (m_bookmarksMenuChanged) {
+        return;
+    }
+
+    if (bookmark.folder == QLatin1String("bookmarksMenu")) {
+        m_menuBookmarks->insertAction(m_menuBookmarksAction, createBookmarkAction(bookmark, m_menuBookmarks));
+        return;
+    }
+
+    Menu* folderMenu = m_bookmarksMenuFolders.value(bookmark.folder);
+    if (!folderMenu) {
+        return;
+    }
+
+    // Remove "Empty" placeholder
+    if (folderMenu->actions().count() == 1 && !folderMenu->actions().first()->isEnabled()) {
+        delete folderMenu->actions().first();
+    }
+
+    folderMenu->addAction(createBookmarkAction(bookmark, folderMenu));
+}
+
+void QupZilla::bookmarkDeletedFromMenu(const BookmarksModel::Bookmark &bookmark)
+{
+    if (m_bookmarksMenuChanged) {
+        return;
+    }
+
+    delete m_bookmarksMenuActions.take(bookmark.id);
+
+    Menu* folderMenu = m_bookmarksMenuFolders.value(bookmark.folder);
+    if (folderMenu && folderMenu->isEmpty()) {
+        folderMenu->addAction(tr("Empty"))->setEnabled(false);
+    }
+}
+
+void QupZilla::bookmarkEditedInMenu(const BookmarksModel::Bookmark &before, const BookmarksModel::Bookmark &after)
+{
+    if (m_bookmarksMenuChanged) {
+        return;
+    }
+
+    if (before.folder != after.folder) {
+        bookmarkDeletedFromMenu(before);
+        bookmarkAddedToMenu(after);
+        return;
+    }
+
+    Action* act = m_bookmarksMenuActions.value(after.id);
+    if (!act) {
+        return;
+    }
+
+    QString title = after.title;
+    if (title.length() > 40) {
+        title.truncate(40);
+        title += "..";
+    }
+
+    act->setText(title);
+    act->setData(after.url);
+    act->setIcon(IconProvider::iconFromImage(after.image));
+}
+
+void QupZilla::bookmarkFoldersChanged()
+{
+    // Folders are changed rarely (and bulk imports too), whole menu is rebuilt from BookmarksModel on next show
+    m_bookmarksMenuChanged = true;
+}
+
 void QupZilla::aboutToShowHistoryMenu()
 {
     if (!weView()) {
@@ -862,18 +933,19 @@ void QupZilla::aboutToShowClosedTabsMenu()
 void QupZilla::aboutToShowHistoryRecentMenu()
 {
     m_menuHistoryRecent->clear();
-    QSqlQuery query;
-    query.exec("SELECT title, url FROM history ORDER BY date DESC LIMIT 15");
-    while (query.next()) {
-        const QUrl &url = query.value(1).toUrl();
-        QString title = query.value(0).toString();
+
+    HistoryCache* cache = mApp->history()->cache();
+    const QList<HistoryEntry> &recentList = mApp->history()->recentlyVisited(15);
+
+    foreach(const HistoryEntry & entry, recentList) {
+        QString title = entry.title;
         if (title.length() > 40) {
             title.truncate(40);
             title += "..";
         }
 
-        Action* act = new Action(_iconForUrl(url), title);
-        act->setData(url);
+        Action* act = new Action(cache->icon(entry), title);
+        act->setData(entry.url);
         connect(act, SIGNAL(triggered()), this, SLOT(loadActionUrl()));
         connect(act, SIGNAL(middleClicked()), this, SLOT(loadActionUrlInNewNotSelectedTab()));
         m_menuHistoryRecent->addAction(act);
@@ -888,6 +960,7 @@ void QupZilla::aboutToShowHistoryMostMenu()
 {
     m_menuHistoryMost->clear();
 
+    HistoryCache* cache = mApp->history()->cache();
     const QList<HistoryEntry> &mostList = mApp->history()->mostVisited(10);
 
     foreach(const HistoryEntry & entry, mostList) {
@@ -897,7 +970,7 @@ void QupZilla::aboutToShowHistoryMostMenu()
             title += "..";
         }
 
-        Action* act = new Action(_iconForUrl(entry.url), title);
+        Action* act = new Action(cache->icon(entry), title);
         act->setData(entry.url);
         connect(act, SIGNAL(triggered()), this, SLOT(loadActionUrl()));
         connect(act, SIGNAL(middleClicked()), this, SLOT(loadActionUrlInNewNotSelectedTab()));
@@ -909,6 +982,17 @@ void QupZilla::aboutToShowHistoryMostMenu()
     }
 }
 
+void QupZilla::historyCacheLoaded()
+{
+    // Menu was shown before history cache was loaded
+    if (m_menuHistoryRecent->isVisible()) {
+        aboutToShowHistoryRecentMenu();
+    }
+    if (m_menuHistoryMost->isVisible()) {
+        aboutToShowHistoryMostMenu();
+    }
+}
+
 void QupZilla::aboutToShowViewMenu()
 {
     m_actionShowToolbar->setChecked(m_navigationBar->isVisible());
@@ -20,9 +20,11 @@
 
 #include <QMainWindow>
 #include <QUrl>
+#include <QHash>
 #include "qwebkitversion.h"
 
 #include "qz_namespace.h"
+#include "bookmarksmodel.h"
 
 class QMenuBar;
 class QLabel;
@@ -31,6 +33,7 @@ class QSplitter;
 class QWebFrame;
 
 class Menu;
+class Action;
 class TabWidget;
 class TabbedWebView;
 class LineEdit;
@@ -47,6 +50,7 @@ class NavigationBar;
 class ClickableLabel;
 class WebInspectorDockWidget;
 class LocationBar;
+
 class QT_QUPZILLA_EXPORT QupZilla : public QMainWindow
 {
     Q_OBJECT
@@ -141,6 +145,10 @@ private slots:
     void aboutToHideHistoryMenu();
     void aboutToShowClosedTabsMenu();
     void aboutToShowBookmarksMenu();
+    void bookmarkAddedToMenu(const BookmarksModel::Bookmark &bookmark);
+    void bookmarkDeletedFromMenu(const BookmarksModel::Bookmark &bookmark);
+    void bookmarkEditedInMenu(const BookmarksModel::Bookmark &before, const BookmarksModel::Bookmark &after);
+    void bookmarkFoldersChanged();
     void aboutToShowViewMenu();
     void aboutToShowEditMenu();
     void aboutToHideEditMenu();
@@ -160,6 +168,7 @@ private slots:
     void showClearPrivateData();
     void aboutToShowHistoryRecentMenu();
     void aboutToShowHistoryMostMenu();
+    void historyCacheLoaded();
     void showPreferences();
     void showBookmarkImport();
 
@@ -203,6 +212,9 @@ private:
 
     void disconnectObjects();
 
+    void rebuildBookmarksMenu();
+    Action* createBookmarkAction(const BookmarksModel::Bookmark &bookmark, QObject* parent);
+
     bool m_historyMenuChanged;
     bool m_bookmarksMenuChanged;
     bool m_isClosing;
@@ -225,6 +237,9 @@ private:
     Menu* m_menuHistoryMost;
     QMenu* m_menuEncoding;
     QAction* m_menuBookmarksAction;
+    // Bookmarks menu is built once and then updated from BookmarksModel signals
+    QHash<int, Action*> m_bookmarksMenuActions;
+    QHash<QString, Menu*> m_bookmarksMenuFolders;
 #ifdef Q_WS_MAC
     QMenuBar* m_macMenuBar;
 #endif
@@ -22,8 +22,9 @@
 #include "popupwebview.h"
 #include "mainapplication.h"
 #include "autofillnotification.h"
-#include "databasewriter.h"
+#include "databaseexecutor.h"
 #include "settings.h"
+#include "sqlquery.h"
 
 #include <QXmlStreamWriter>
 #include <QXmlStreamReader>
@@ -57,7 +58,7 @@ bool AutoFillModel::isStored(const QUrl &url)
         server = url.toString();
     }
 
-    QSqlQuery query;
+    SqlQuery query("autofill");
     query.exec("SELECT count(id) FROM autofill WHERE server='" + server + "'");
     query.next();
     if (query.value(0).toInt() > 0) {
@@ -77,7 +78,7 @@ bool AutoFillModel::isStoringEnabled(const QUrl &url)
         server = url.toString();
     }
 
-    QSqlQuery query;
+    SqlQuery query("autofill");
     query.exec("SELECT count(id) FROM autofill_exceptions WHERE server='" + server + "'");
     query.next();
     if (query.value(0).toInt() > 0) {
@@ -93,10 +94,7 @@ void AutoFillModel::blockStoringfor(const QUrl &url)
         server = url.toString();
     }
 
-    QSqlQuery query;
-    query.prepare("INSERT INTO autofill_exceptions (server) VALUES (?)");
-    query.addBindValue(server);
-    mApp->dbWriter()->executeQuery(query);
+    mApp->dbExecutor()->exec("INSERT INTO autofill_exceptions (server) VALUES (?)", QVariantList() << server);
 }
 
 QString AutoFillModel::getUsername(const QUrl &url)
@@ -106,7 +104,7 @@ QString AutoFillModel::getUsername(const QUrl &url)
         server = url.toString();
     }
 
-    QSqlQuery query;
+    SqlQuery query("autofill");
     query.exec("SELECT username FROM autofill WHERE server='" + server + "'");
     query.next();
     return query.value(0).toString();
@@ -119,7 +117,7 @@ QString AutoFillModel::getPassword(const QUrl &url)
         server = url.toString();
     }
 
-    QSqlQuery query;
+    SqlQuery query("autofill");
     query.exec("SELECT password FROM autofill WHERE server='" + server + "'");
     query.next();
     return query.value(0).toString();
@@ -128,7 +126,7 @@ QString AutoFillModel::getPassword(const QUrl &url)
 ///HTTP Authorization
 void AutoFillModel::addEntry(const QUrl &url, const QString &name, const QString &pass)
 {
-    QSqlQuery query;
+    SqlQuery query("autofill");
     query.exec("SELECT username FROM autofill WHERE server='" + url.host() + "'");
     if (query.next()) {
         return;
@@ -139,17 +137,14 @@ void AutoFillModel::addEntry(const QUrl &url, const QString &name, const QString
         server = url.toString();
     }
 
-    query.prepare("INSERT INTO autofill (server, username, password) VALUES (?,?,?)");
-    query.bindValue(0, server);
-    query.bindValue(1, name);
-    query.bindValue(2, pass);
-    mApp->dbWriter()->executeQuery(query);
+    mApp->dbExecutor()->exec("INSERT INTO autofill (server, username, password) VALUES (?,?,?)",
+                             QVariantList() << server << name << pass);
 }
 
 ///WEB Form
 void AutoFillModel::addEntry(const QUrl &url, const QByteArray &data, const QString &user, const QString &pass)
 {
-    QSqlQuery query;
+    SqlQuery query("autofill");
     query.exec("SELECT data FROM autofill WHERE server='" + url.host() + "'");
     if (query.next()) {
         return;
@@ -160,12 +155,8 @@ void AutoFillModel::addEntry(const QUrl &url, const QByteArray &data, const QStr
         server = url.toString();
     }
 
-    query.prepare("INSERT INTO autofill (server, data, username, password) VALUES (?,?,?,?)");
-    query.bindValue(0, server);
-    query.bindValue(1, data);
-    query.bindValue(2, user);
-    query.bindValue(3, pass);
-    mApp->dbWriter()->executeQuery(query);
+    mApp->dbExecutor()->exec("INSERT INTO autofill (server, data, username, password) VALUES (?,?,?,?)",
+                             QVariantList() << server << data << user << pass);
 }
 
 void AutoFillModel::completePage(WebPage* page)
@@ -193,7 +184,7 @@ void AutoFillModel::completePage(WebPage* page)
         server = pageUrl.toString();
     }
 
-    QSqlQuery query;
+    SqlQuery query("autofill");
     query.prepare("SELECT data FROM autofill WHERE server=?");
     query.addBindValue(server);
     query.exec();
@@ -362,7 +353,7 @@ QByteArray AutoFillModel::exportPasswords()
     stream.writeStartElement("passwords");
     stream.writeAttribute("version", "1.0");
 
-    QSqlQuery query;
+    SqlQuery query("autofill");
     query.exec("SELECT server, username, password, data FROM autofill");
     while (query.next()) {
         stream.writeStartElement("entry");
@@ -420,7 +411,7 @@ bool AutoFillModel::importPasswords(const QByteArray &data)
                 }
 
                 if (!server.isEmpty() && !password.isEmpty() && !data.isEmpty()) {
-                    QSqlQuery query;
+                    SqlQuery query("autofill");
                     query.prepare("SELECT id FROM autofill WHERE server=? AND password=? AND data=?");
                     query.addBindValue(server);
                     query.addBindValue(password);
@@ -451,7 +442,7 @@ bool AutoFillModel::importPasswords(const QByteArray &data)
                 }
 
                 if (!server.isEmpty()) {
-                    QSqlQuery query;
+                    SqlQuery query("autofill");
                     query.prepare("SELECT id FROM autofill_exceptions WHERE server=?");
                     query.addBindValue(server);
                     query.exec();
@@ -42,6 +42,7 @@ BookmarkIcon::BookmarkIcon(QupZilla* mainClass, QWidget* parent)
     connect(this, SIGNAL(clicked(QPoint)), this, SLOT(iconClicked()));
     connect(m_bookmarksModel, SIGNAL(bookmarkAdded(BookmarksModel::Bookmark)), this, SLOT(bookmarkAdded(BookmarksModel::Bookmark)));
     connect(m_bookmarksModel, SIGNAL(bookmarkDeleted(BookmarksModel::Bookmark)), this, SLOT(bookmarkDeleted(BookmarksModel::Bookmark)));
+    connect(m_bookmarksModel, SIGNAL(bookmarksImported(QList<BookmarksModel::Bookmark>)), this, SLOT(bookmarksImported(QList<BookmarksModel::Bookmark>)));
     connect(m_speedDial, SIGNAL(pagesChanged()), this, SLOT(speedDialChanged()));
 }
 
@@ -57,14 +58,14 @@ void BookmarkIcon::checkBookmark(const QUrl &url, bool forceCheck)
         return;
     }
 
+    m_lastUrl = url;
+
     if (m_bookmarksModel->isBookmarked(url) || !m_speedDial->pageForUrl(url).url.isEmpty()) {
         setBookmarkSaved();
     }
     else {
         setBookmarkDisabled();
     }
-
-    m_lastUrl = url;
 }
 
 void BookmarkIcon::bookmarkDeleted(const BookmarksModel::Bookmark &bookmark)
@@ -81,6 +82,16 @@ void BookmarkIcon::bookmarkAdded(const BookmarksModel::Bookmark &bookmark)
     }
 }
 
+void BookmarkIcon::bookmarksImported(const QList<BookmarksModel::Bookmark> &bookmarks)
+{
+    foreach(const Bookmark & bookmark, bookmarks) {
+        if (bookmark.url == m_lastUrl) {
+            checkBookmark(m_lastUrl, true);
+            return;
+        }
+    }
+}
+
 void BookmarkIcon::speedDialChanged()
 {
     checkBookmark(m_lastUrl, true);
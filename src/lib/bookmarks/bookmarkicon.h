@@ -37,6 +37,7 @@ public:
 private slots:
     void iconClicked();
     void bookmarkAdded(const BookmarksModel::Bookmark &bookmark);
+    void bookmarksImported(const QList<BookmarksModel::Bookmark> &bookmarks);
     void bookmarkDeleted(const BookmarksModel::Bookmark &bookmark);
     void speedDialChanged();
 
@@ -34,7 +34,6 @@
 #include <QDialogButtonBox>
 #include <QShortcut>
 #include <QMenu>
-#include <QSqlQuery>
 
 BookmarksManager::BookmarksManager(QupZilla* mainClass, QWidget* parent)
     : QWidget(parent)
@@ -58,6 +57,7 @@ BookmarksManager::BookmarksManager(QupZilla* mainClass, QWidget* parent)
     connect(m_bookmarksModel, SIGNAL(folderAdded(QString)), this, SLOT(addFolder(QString)));
     connect(m_bookmarksModel, SIGNAL(folderDeleted(QString)), this, SLOT(removeFolder(QString)));
     connect(m_bookmarksModel, SIGNAL(folderRenamed(QString, QString)), this, SLOT(renameFolder(QString, QString)));
+    connect(m_bookmarksModel, SIGNAL(bookmarksImported(QList<BookmarksModel::Bookmark>)), this, SLOT(refreshTable()));
 
     connect(ui->optimizeDb, SIGNAL(clicked(QPoint)), this, SLOT(optimizeDb()));
     connect(ui->importBookmarks, SIGNAL(clicked(QPoint)), this, SLOT(importBookmarks()));
@@ -253,10 +253,8 @@ void BookmarksManager::contextMenuRequested(const QPoint &position)
     moveMenu.addAction(QIcon(":icons/other/unsortedbookmarks.png"), _bookmarksUnsorted, this, SLOT(moveBookmark()))->setData("unsorted");
     moveMenu.addAction(style()->standardIcon(QStyle::SP_DirOpenIcon), _bookmarksMenu, this, SLOT(moveBookmark()))->setData("bookmarksMenu");
     moveMenu.addAction(style()->standardIcon(QStyle::SP_DirOpenIcon), _bookmarksToolbar, this, SLOT(moveBookmark()))->setData("bookmarksToolbar");
-    QSqlQuery query;
-    query.exec("SELECT name FROM folders");
-    while (query.next()) {
-        moveMenu.addAction(style()->standardIcon(QStyle::SP_DirIcon), query.value(0).toString(), this, SLOT(moveBookmark()))->setData(query.value(0).toString());
+    foreach(const BookmarksModel::Folder & folder, m_bookmarksModel->folders()) {
+        moveMenu.addAction(style()->standardIcon(QStyle::SP_DirIcon), folder.name, this, SLOT(moveBookmark()))->setData(folder.name);
     }
     menu.addMenu(&moveMenu);
 
@@ -276,7 +274,6 @@ void BookmarksManager::refreshTable()
     ui->bookmarksTree->setUpdatesEnabled(false);
     ui->bookmarksTree->clear();
 
-    QSqlQuery query;
     QTreeWidgetItem* newItem = new QTreeWidgetItem(ui->bookmarksTree);
     newItem->setText(0, _bookmarksMenu);
     newItem->setIcon(0, style()->standardIcon(QStyle::SP_DirIcon));
@@ -287,21 +284,28 @@ void BookmarksManager::refreshTable()
     bookmarksToolbar->setIcon(0, style()->standardIcon(QStyle::SP_DirIcon));
     ui->bookmarksTree->addTopLevelItem(bookmarksToolbar);
 
-    query.exec("SELECT name FROM folders WHERE subfolder!='yes'");
-    while (query.next()) {
+    foreach(const BookmarksModel::Folder & folder, m_bookmarksModel->folders()) {
+        if (folder.subfolder) {
+            continue;
+        }
+
         newItem = new QTreeWidgetItem(ui->bookmarksTree);
-        newItem->setText(0, query.value(0).toString());
+        newItem->setText(0, folder.name);
         newItem->setIcon(0, style()->standardIcon(QStyle::SP_DirIcon));
         ui->bookmarksTree->addTopLevelItem(newItem);
     }
 
-    query.exec("SELECT title, url, id, folder, icon FROM bookmarks");
-    while (query.next()) {
-        QString title = query.value(0).toString();
-        QUrl url = query.value(1).toUrl();
-        int id = query.value(2).toInt();
-        QString folder = query.value(3).toString();
-        QIcon icon = IconProvider::iconFromImage(QImage::fromData(query.value(4).toByteArray()));
+    foreach(const Bookmark & bookmark, m_bookmarksModel->allBookmarks()) {
+        // Bookmarks of toolbar subfolders are added below
+        if (bookmark.inSubfolder) {
+            continue;
+        }
+
+        const QString &title = bookmark.title;
+        const QUrl &url = bookmark.url;
+        int id = bookmark.id;
+        QString folder = bookmark.folder;
+        QIcon icon = IconProvider::iconFromImage(bookmark.image);
         QTreeWidgetItem* item = new QTreeWidgetItem();
         if (folder == "bookmarksMenu") {
             folder = _bookmarksMenu;
@@ -329,21 +333,20 @@ void BookmarksManager::refreshTable()
         ui->bookmarksTree->addTopLevelItem(item);
     }
 
-    query.exec("SELECT name FROM folders WHERE subfolder='yes'");
-    while (query.next()) {
+    foreach(const BookmarksModel::Folder & folder, m_bookmarksModel->folders()) {
+        if (!folder.subfolder) {
+            continue;
+        }
+
         newItem = new QTreeWidgetItem(bookmarksToolbar);
-        newItem->setText(0, query.value(0).toString());
+        newItem->setText(0, folder.name);
         newItem->setIcon(0, style()->standardIcon(QStyle::SP_DirIcon));
 
-        QSqlQuery query2;
-        query2.prepare("SELECT title, url, id, icon FROM bookmarks WHERE folder=?");
-        query2.addBindValue(query.value(0).toString());
-        query2.exec();
-        while (query2.next()) {
-            QString title = query2.value(0).toString();
-            QUrl url = query2.value(1).toUrl();
-            int id = query2.value(2).toInt();
-            QIcon icon = IconProvider::iconFromImage(QImage::fromData(query2.value(3).toByteArray()));
+        foreach(const Bookmark & bookmark, m_bookmarksModel->folderBookmarks(folder.name)) {
+            const QString &title = bookmark.title;
+            const QUrl &url = bookmark.url;
+            int id = bookmark.id;
+            QIcon icon = IconProvider::iconFromImage(bookmark.image);
             QTreeWidgetItem* item = new QTreeWidgetItem(newItem);
 
             item->setText(0, title);
@@ -562,10 +565,8 @@ void BookmarksManager::insertBookmark(const QUrl &url, const QString &title, con
     combo->addItem(QIcon(":icons/other/unsortedbookmarks.png"), _bookmarksUnsorted);
     combo->addItem(style()->standardIcon(QStyle::SP_DirOpenIcon), _bookmarksMenu);
     combo->addItem(style()->standardIcon(QStyle::SP_DirOpenIcon), _bookmarksToolbar);
-    QSqlQuery query;
-    query.exec("SELECT name FROM folders");
-    while (query.next()) {
-        combo->addItem(style()->standardIcon(QStyle::SP_DirIcon), query.value(0).toString());
+    foreach(const BookmarksModel::Folder & folder, m_bookmarksModel->folders()) {
+        combo->addItem(style()->standardIcon(QStyle::SP_DirIcon), folder.name);
     }
     combo->setCurrentIndex(combo->findText(BookmarksModel::toTranslatedFolder(m_bookmarksModel->lastFolder())));
 
@@ -608,10 +609,8 @@ void BookmarksManager::insertAllTabs()
     combo->addItem(QIcon(":icons/other/unsortedbookmarks.png"), _bookmarksUnsorted);
     combo->addItem(style()->standardIcon(QStyle::SP_DirOpenIcon), _bookmarksMenu);
     combo->addItem(style()->standardIcon(QStyle::SP_DirOpenIcon), _bookmarksToolbar);
-    QSqlQuery query;
-    query.exec("SELECT name FROM folders");
-    while (query.next()) {
-        combo->addItem(style()->standardIcon(QStyle::SP_DirIcon), query.value(0).toString());
+    foreach(const BookmarksModel::Folder & folder, m_bookmarksModel->folders()) {
+        combo->addItem(style()->standardIcon(QStyle::SP_DirIcon), folder.name);
     }
     combo->setCurrentIndex(combo->findText(BookmarksModel::toTranslatedFolder(m_bookmarksModel->lastFolder())));
 
@@ -18,11 +18,17 @@
 #include "bookmarksmodel.h"
 #include "tabbedwebview.h"
 #include "iconprovider.h"
-#include "databasewriter.h"
 #include "mainapplication.h"
 #include "settings.h"
+#include "databaseexecutor.h"
+#include "sqlquery.h"
+#include "globalfunctions.h"
 
 #include <QBuffer>
+#include <QSet>
+#include <QSqlError>
+#include <QDebug>
+#include <QtAlgorithms>
 
 // SQLite DB -> table bookmarks + folders
 // Unique in bookmarks table is id
@@ -33,6 +39,17 @@ BookmarksModel::BookmarksModel(QObject* parent)
     : QObject(parent)
 {
     loadSettings();
+    loadBookmarks();
+
+    // Tree is updated first, so views already see the change when handling these signals
+    connect(this, SIGNAL(bookmarkAdded(BookmarksModel::Bookmark)), this, SLOT(treeBookmarkAdded(BookmarksModel::Bookmark)));
+    connect(this, SIGNAL(bookmarkDeleted(BookmarksModel::Bookmark)), this, SLOT(treeBookmarkDeleted(BookmarksModel::Bookmark)));
+    connect(this, SIGNAL(bookmarkEdited(BookmarksModel::Bookmark, BookmarksModel::Bookmark)),
+            this, SLOT(treeBookmarkEdited(BookmarksModel::Bookmark, BookmarksModel::Bookmark)));
+    connect(this, SIGNAL(folderAdded(QString)), this, SLOT(treeFolderAdded(QString)));
+    connect(this, SIGNAL(subfolderAdded(QString)), this, SLOT(treeSubfolderAdded(QString)));
+    connect(this, SIGNAL(folderDeleted(QString)), this, SLOT(treeFolderDeleted(QString)));
+    connect(this, SIGNAL(folderRenamed(QString, QString)), this, SLOT(treeFolderRenamed(QString, QString)));
 }
 
 void BookmarksModel::loadSettings()
@@ -65,12 +82,13 @@ void BookmarksModel::setShowingOnlyIconsInToolbar(bool state)
 
 bool BookmarksModel::isFolder(const QString &name)
 {
-    QSqlQuery query;
-    query.prepare("SELECT name FROM folders WHERE name = ?");
-    query.bindValue(0, name);
-    query.exec();
+    foreach(const Folder & folder, m_folders) {
+        if (folder.name == name) {
+            return true;
+        }
+    }
 
-    return query.next();
+    return false;
 }
 
 void BookmarksModel::setLastFolder(const QString &folder)
@@ -84,73 +102,65 @@ void BookmarksModel::setLastFolder(const QString &folder)
 
 bool BookmarksModel::isBookmarked(const QUrl &url)
 {
-    QSqlQuery query;
-    query.prepare("SELECT count(id) FROM bookmarks WHERE url=?");
-    query.bindValue(0, url.toString());
-    query.exec();
-    query.next();
-    return query.value(0).toInt() > 0;
+    return m_urlIndex.contains(qz_normalizedUrl(url));
+}
+
+int BookmarksModel::bookmarkCount(const QUrl &url)
+{
+    return m_urlIndex.count(qz_normalizedUrl(url));
 }
 
 // Bookmark search priority:
 // Bookmarks in menu > bookmarks in toolbar -> user folders and unsorted
 int BookmarksModel::bookmarkId(const QUrl &url)
 {
-    QSqlQuery query;
-    query.prepare("SELECT id FROM bookmarks WHERE url=? AND folder='bookmarksMenu' ");
-    query.bindValue(0, url.toString());
-    query.exec();
-    if (query.next()) {
-        return query.value(0).toInt();
-    }
-
-    query.prepare("SELECT id FROM bookmarks WHERE url=? AND folder='bookmarksToolbar' ");
-    query.bindValue(0, url.toString());
-    query.exec();
-    if (query.next()) {
-        return query.value(0).toInt();
-    }
-
-    query.prepare("SELECT id FROM bookmarks WHERE url=? ");
-    query.bindValue(0, url.toString());
-    query.exec();
-    if (query.next()) {
-        return query.value(0).toInt();
-    }
-
-    return -1;
+    int menuId = -1;
+    int toolbarId = -1;
+    int otherId = -1;
+
+    foreach(int id, m_urlIndex.values(qz_normalizedUrl(url))) {
+        const Bookmark &bookmark = m_bookmarks[id];
+        if (bookmark.folder == QLatin1String("bookmarksMenu")) {
+            menuId = menuId == -1 ? bookmark.id : qMin(menuId, bookmark.id);
+        }
+        else if (bookmark.folder == QLatin1String("bookmarksToolbar")) {
+            toolbarId = toolbarId == -1 ? bookmark.id : qMin(toolbarId, bookmark.id);
+        }
+        else {
+            otherId = otherId == -1 ? bookmark.id : qMin(otherId, bookmark.id);
+        }
+    }
+
+    if (menuId != -1) {
+        return menuId;
+    }
+    if (toolbarId != -1) {
+        return toolbarId;
+    }
+    return otherId;
 }
 
 int BookmarksModel::bookmarkId(const QUrl &url, const QString &title, const QString &folder)
 {
-    QSqlQuery query;
-    query.prepare("SELECT id FROM bookmarks WHERE url=? AND title=? AND folder=? ");
-    query.bindValue(0, url.toString());
-    query.bindValue(1, title);
-    query.bindValue(2, folder);
-    query.exec();
-    if (query.next()) {
-        return query.value(0).toInt();
+    int foundId = -1;
+
+    foreach(int id, m_urlIndex.values(qz_normalizedUrl(url))) {
+        const Bookmark &bookmark = m_bookmarks[id];
+        if (bookmark.url == url && bookmark.title == title && bookmark.folder == folder) {
+            foundId = foundId == -1 ? id : qMin(foundId, id);
+        }
     }
-    return -1;
+
+    return foundId;
 }
 
 BookmarksModel::Bookmark BookmarksModel::getBookmark(int id)
 {
-    Bookmark bookmark;
-    QSqlQuery query;
-    query.prepare("SELECT url, title, folder, icon FROM bookmarks WHERE id=?");
-    query.bindValue(0, id);
-    query.exec();
-    if (query.next()) {
-        bookmark.id = id;
-        bookmark.url = query.value(0).toUrl();
-        bookmark.title = query.value(1).toString();
-        bookmark.folder = query.value(2).toString();
-        bookmark.image = QImage::fromData(query.value(3).toByteArray());
-        bookmark.inSubfolder = isSubfolder(bookmark.folder);
+    if (!m_bookmarks.contains(id)) {
+        return Bookmark();
     }
-    return bookmark;
+
+    return treeBookmark(id);
 }
 
 bool BookmarksModel::saveBookmark(const QUrl &url, const QString &title, const QIcon &icon, const QString &folder)
@@ -168,7 +178,7 @@ bool BookmarksModel::saveBookmark(const QUrl &url, const QString &title, const Q
         createFolder(folder);
     }
 
-    QSqlQuery query;
+    SqlQuery query("bookmarks");
     query.prepare("INSERT INTO bookmarks (url, title, folder, icon) VALUES (?,?,?,?)");
     query.bindValue(0, url.toString());
     query.bindValue(1, title);
@@ -204,24 +214,109 @@ bool BookmarksModel::saveBookmark(WebView* view, QString folder)
     return saveBookmark(view->url(), view->title(), view->icon(), folder);
 }
 
+bool BookmarksModel::saveBookmarks(const QList<Bookmark> &bookmarks)
+{
+    if (bookmarks.isEmpty()) {
+        return false;
+    }
+
+    // Queued asynchronous writes would otherwise compete for database lock
+    mApp->dbExecutor()->flush();
+
+    QSqlDatabase db = QSqlDatabase::database();
+    db.transaction();
+
+    SqlQuery folderQuery("bookmarks", db);
+    folderQuery.prepare("INSERT INTO folders (name, subfolder) VALUES (?, 'no')");
+    SqlQuery query("bookmarks", db);
+    query.prepare("INSERT INTO bookmarks (url, title, folder, icon) VALUES (?,?,?,?)");
+
+    // Most imported bookmarks have no icon, default one is encoded only once
+    const QImage defaultImage = QWebSettings::webGraphic(QWebSettings::DefaultFrameIconGraphic).toImage();
+    QByteArray defaultIconData;
+    QBuffer defaultBuffer(&defaultIconData);
+    defaultBuffer.open(QIODevice::WriteOnly);
+    defaultImage.save(&defaultBuffer, "PNG");
+
+    QSet<QString> knownFolders;
+    foreach(const Folder & folder, m_folders) {
+        knownFolders.insert(folder.name);
+    }
+
+    QStringList newFolders;
+    QList<Bookmark> added;
+
+    foreach(const Bookmark & b, bookmarks) {
+        if (b.url.isEmpty() || b.title.isEmpty() || b.folder.isEmpty()) {
+            continue;
+        }
+
+        if (!knownFolders.contains(b.folder)) {
+            folderQuery.bindValue(0, b.folder);
+            if (!folderQuery.exec()) {
+                continue;
+            }
+
+            knownFolders.insert(b.folder);
+            newFolders.append(b.folder);
+        }
+
+        Bookmark bookmark = b;
+        QByteArray iconData;
+
+        if (bookmark.image.isNull()) {
+            bookmark.image = defaultImage;
+            iconData = defaultIconData;
+        }
+        else {
+            QBuffer buffer(&iconData);
+            buffer.open(QIODevice::WriteOnly);
+            bookmark.image.save(&buffer, "PNG");
+        }
+
+        query.bindValue(0, bookmark.url.toString());
+        query.bindValue(1, bookmark.title);
+        query.bindValue(2, bookmark.folder);
+        query.bindValue(3, iconData);
+        if (!query.exec()) {
+            continue;
+        }
+
+        bookmark.id = query.lastInsertId().toInt();
+        added.append(bookmark);
+    }
+
+    if (!db.commit()) {
+        qWarning() << "BookmarksModel::saveBookmarks Cannot commit transaction" << db.lastError().text();
+        db.rollback();
+        return false;
+    }
+
+    foreach(const QString & folder, newFolders) {
+        treeFolderAdded(folder);
+    }
+
+    for (int i = 0; i < added.count(); ++i) {
+        Bookmark &bookmark = added[i];
+        bookmark.inSubfolder = isSubfolder(bookmark.folder);
+        treeBookmarkAdded(bookmark);
+    }
+
+    emit bookmarksImported(added);
+    mApp->sendMessages(Qz::AM_BookmarksChanged, true);
+    return true;
+}
+
 bool BookmarksModel::removeBookmark(int id)
 {
-    QSqlQuery query;
-    query.prepare("SELECT url, title, folder FROM bookmarks WHERE id = ?");
-    query.bindValue(0, id);
-    query.exec();
-    if (!query.next()) {
+    if (!m_bookmarks.contains(id)) {
         return false;
     }
 
-    Bookmark bookmark;
-    bookmark.id = id;
-    bookmark.url = query.value(0).toUrl();
-    bookmark.title = query.value(1).toString();
-    bookmark.folder = query.value(2).toString();
-    bookmark.image = QImage::fromData(query.value(3).toByteArray());
-    bookmark.inSubfolder = isSubfolder(bookmark.folder);
+    // Copy, the stored bookmark is removed by treeBookmarkDeleted()
+    const Bookmark bookmark = treeBookmark(id);
 
+    SqlQuery query("bookmarks");
     if (!query.exec("DELETE FROM bookmarks WHERE id = " + QString::number(id))) {
         return false;
     }
@@ -266,20 +361,12 @@ bool BookmarksModel::editBookmark(int id, const QString &title, const QUrl &url,
     if (title.isEmpty() && url.isEmpty() && folder.isEmpty()) {
         return false;
     }
-    QSqlQuery query;
-    if (!query.exec("SELECT title, url, folder, icon FROM bookmarks WHERE id = " + QString::number(id))) {
+
+    if (!m_bookmarks.contains(id)) {
         return false;
     }
 
-    query.next();
-
-    Bookmark before;
-    before.id = id;
-    before.title = query.value(0).toString();
-    before.url = query.value(1).toUrl();
-    before.folder = query.value(2).toString();
-    before.image = QImage::fromData(query.value(3).toByteArray());
-    before.inSubfolder = isSubfolder(before.folder);
+    const Bookmark before = treeBookmark(id);
 
     Bookmark after;
     after.id = id;
@@ -289,6 +376,7 @@ bool BookmarksModel::editBookmark(int id, const QString &title, const QUrl &url,
     after.image = before.image;
     after.inSubfolder = isSubfolder(after.folder);
 
+    SqlQuery query("bookmarks");
     query.prepare("UPDATE bookmarks SET title=?, url=?, folder=? WHERE id = ?");
     query.bindValue(0, after.title);
     query.bindValue(1, after.url.toString());
@@ -310,7 +398,7 @@ bool BookmarksModel::createFolder(const QString &name)
         return false;
     }
 
-    QSqlQuery query;
+    SqlQuery query("bookmarks");
     query.prepare("INSERT INTO folders (name, subfolder) VALUES (?, 'no')");
     query.bindValue(0, name);
     if (!query.exec()) {
@@ -328,7 +416,7 @@ bool BookmarksModel::removeFolder(const QString &name)
         return false;
     }
 
-    QSqlQuery query;
+    SqlQuery query("bookmarks");
     query.prepare("SELECT id FROM bookmarks WHERE folder = ? ");
     query.bindValue(0, name);
     if (!query.exec()) {
@@ -357,7 +445,7 @@ bool BookmarksModel::removeFolder(const QString &name)
 
 bool BookmarksModel::renameFolder(const QString &before, const QString &after)
 {
-    QSqlQuery query;
+    SqlQuery query("bookmarks");
     query.prepare("SELECT name FROM folders WHERE name = ?");
     query.bindValue(0, after);
     query.exec();
@@ -386,33 +474,60 @@ bool BookmarksModel::renameFolder(const QString &before, const QString &after)
 QList<Bookmark> BookmarksModel::folderBookmarks(const QString &name)
 {
     QList<Bookmark> list;
+    QList<int> ids = m_folderBookmarks.value(name);
 
-    QSqlQuery query;
-    query.prepare("SELECT id, url, title, folder, icon FROM bookmarks WHERE folder=?");
-    query.addBindValue(name);
-    query.exec();
-    while (query.next()) {
-        Bookmark bookmark;
-        bookmark.id = query.value(0).toInt();
-        bookmark.url = query.value(1).toUrl();
-        bookmark.title = query.value(2).toString();
-        bookmark.folder = query.value(3).toString();
-        bookmark.image = QImage::fromData(query.value(4).toByteArray());
-        bookmark.inSubfolder = isSubfolder(bookmark.folder);
+    if (name == QLatin1String("bookmarksToolbar")) {
+        QList<QPair<int, int> > positions;
+        foreach(int id, ids) {
+            positions.append(qMakePair(m_toolbarPositions.value(id), id));
+        }
+        qSort(positions);
+
+        ids.clear();
+        for (int i = 0; i < positions.count(); ++i) {
+            ids.append(positions.at(i).second);
+        }
+    }
+
+    foreach(int id, ids) {
+        list.append(treeBookmark(id));
+    }
+
+    return list;
+}
+
+QList<Bookmark> BookmarksModel::allBookmarks()
+{
+    QList<int> ids = m_bookmarks.keys();
+    qSort(ids);
 
-        list.append(bookmark);
+    QList<Bookmark> list;
+    foreach(int id, ids) {
+        list.append(treeBookmark(id));
     }
 
     return list;
 }
 
+QList<BookmarksModel::Folder> BookmarksModel::folders()
+{
+    return m_folders;
+}
+
+void BookmarksModel::setToolbarPosition(int id, int position)
+{
+    m_toolbarPositions[id] = position;
+
+    mApp->dbExecutor()->exec("UPDATE bookmarks SET toolbar_position=? WHERE id=?", QVariantList() << position << id);
+}
+
 bool BookmarksModel::createSubfolder(const QString &name)
 {
     if (isFolder(name)) {
         return false;
     }
 
-    QSqlQuery query;
+    SqlQuery query("bookmarks");
     query.prepare("INSERT INTO folders (name, subfolder) VALUES (?, 'yes')");
     query.bindValue(0, name);
     if (!query.exec()) {
@@ -426,15 +541,157 @@ bool BookmarksModel::createSubfolder(const QString &name)
 
 bool BookmarksModel::isSubfolder(const QString &name)
 {
-    QSqlQuery query;
-    query.prepare("SELECT subfolder FROM folders WHERE name = ?");
-    query.bindValue(0, name);
-    query.exec();
-    if (!query.next()) {
-        return false;
+    foreach(const Folder & folder, m_folders) {
+        if (folder.name == name) {
+            return folder.subfolder;
+        }
+    }
+
+    return false;
+}
+
+void BookmarksModel::loadBookmarks()
+{
+    SqlQuery query("bookmarks");
+    query.exec("SELECT name, subfolder FROM folders ORDER BY id");
+    while (query.next()) {
+        Folder folder;
+        folder.name = query.value(0).toString();
+        folder.subfolder = query.value(1).toString() == QLatin1String("yes");
+
+        m_folders.append(folder);
+    }
+
+    query.exec("SELECT id, url, title, folder, icon, toolbar_position FROM bookmarks ORDER BY id");
+    while (query.next()) {
+        Bookmark bookmark;
+        bookmark.id = query.value(0).toInt();
+        bookmark.url = query.value(1).toUrl();
+        bookmark.title = query.value(2).toString();
+        bookmark.folder = query.value(3).toString();
+        bookmark.inSubfolder = isSubfolder(bookmark.folder);
+
+        m_bookmarks.insert(bookmark.id, bookmark);
+        m_iconData.insert(bookmark.id, query.value(4).toByteArray());
+        m_toolbarPositions.insert(bookmark.id, query.value(5).toInt());
+        m_folderBookmarks[bookmark.folder].append(bookmark.id);
+        m_urlIndex.insert(qz_normalizedUrl(bookmark.url), bookmark.id);
+    }
+}
+
+const BookmarksModel::Bookmark &BookmarksModel::treeBookmark(int id)
+{
+    Bookmark &bookmark = m_bookmarks[id];
+
+    if (m_iconData.contains(id)) {
+        bookmark.image = QImage::fromData(m_iconData.take(id));
+    }
+
+    return bookmark;
+}
+
+void BookmarksModel::removeFromUrlIndex(const QUrl &url, int id)
+{
+    const QString key = qz_normalizedUrl(url);
+    QMultiHash<QString, int>::iterator it = m_urlIndex.find(key);
+    while (it != m_urlIndex.end() && it.key() == key) {
+        if (it.value() == id) {
+            it = m_urlIndex.erase(it);
+        }
+        else {
+            ++it;
+        }
+    }
+}
+
+void BookmarksModel::treeBookmarkAdded(const BookmarksModel::Bookmark &bookmark)
+{
+    m_bookmarks.insert(bookmark.id, bookmark);
+    m_folderBookmarks[bookmark.folder].append(bookmark.id);
+    m_urlIndex.insert(qz_normalizedUrl(bookmark.url), bookmark.id);
+}
+
+void BookmarksModel::treeBookmarkDeleted(const BookmarksModel::Bookmark &bookmark)
+{
+    m_bookmarks.remove(bookmark.id);
+    m_iconData.remove(bookmark.id);
+    m_toolbarPositions.remove(bookmark.id);
+    m_folderBookmarks[bookmark.folder].removeOne(bookmark.id);
+    removeFromUrlIndex(bookmark.url, bookmark.id);
+}
+
+void BookmarksModel::treeBookmarkEdited(const BookmarksModel::Bookmark &before, const BookmarksModel::Bookmark &after)
+{
+    if (!m_bookmarks.contains(after.id)) {
+        return;
+    }
+
+    Bookmark &bookmark = m_bookmarks[after.id];
+    bookmark.title = after.title;
+    bookmark.url = after.url;
+    bookmark.folder = after.folder;
+    bookmark.inSubfolder = after.inSubfolder;
+
+    if (before.folder != after.folder) {
+        m_folderBookmarks[before.folder].removeOne(after.id);
+        m_folderBookmarks[after.folder].append(after.id);
+    }
+
+    if (before.url != after.url) {
+        removeFromUrlIndex(before.url, after.id);
+        m_urlIndex.insert(qz_normalizedUrl(after.url), after.id);
     }
+}
+
+void BookmarksModel::treeFolderAdded(const QString &name)
+{
+    Folder folder;
+    folder.name = name;
+    folder.subfolder = false;
+
+    m_folders.append(folder);
+}
 
-    return query.value(0).toString() == "yes";
+void BookmarksModel::treeSubfolderAdded(const QString &name)
+{
+    Folder folder;
+    folder.name = name;
+    folder.subfolder = true;
+
+    m_folders.append(folder);
+}
+
+void BookmarksModel::treeFolderDeleted(const QString &name)
+{
+    for (int i = 0; i < m_folders.count(); ++i) {
+        if (m_folders.at(i).name == name) {
+            m_folders.removeAt(i);
+            break;
+        }
+    }
+
+    foreach(int id, m_folderBookmarks.take(name)) {
+        const Bookmark bookmark = m_bookmarks.take(id);
+        m_iconData.remove(id);
+        m_toolbarPositions.remove(id);
+        removeFromUrlIndex(bookmark.url, id);
+    }
+}
+
+void BookmarksModel::treeFolderRenamed(const QString &before, const QString &after)
+{
+    for (int i = 0; i < m_folders.count(); ++i) {
+        if (m_folders.at(i).name == before) {
+            m_folders[i].name = after;
+            break;
+        }
+    }
+
+    const QList<int> ids = m_folderBookmarks.take(before);
+    foreach(int id, ids) {
+        m_bookmarks[id].folder = after;
+    }
+    m_folderBookmarks.insert(after, ids);
 }
 
 bool BookmarksModel::bookmarksEqual(const Bookmark &one, const Bookmark &two)
@@ -26,6 +26,8 @@
 #include <QUrl>
 #include <QImage>
 #include <QVariant>
+#include <QMultiHash>
+#include <QHash>
 
 #include "qz_namespace.h"
 
@@ -60,6 +62,11 @@ public:
         }
     };
 
+    struct Folder {
+        QString name;
+        bool subfolder;
+    };
+
     void loadSettings();
 
     bool isShowingMostVisited() { return m_showMostVisited; }
@@ -72,13 +79,18 @@ public:
     QString lastFolder() { return m_lastFolder; }
     void setLastFolder(const QString &folder);
 
+    // Answered from in-memory index of bookmarked urls, doesn't touch database
     bool isBookmarked(const QUrl &url);
+    int bookmarkCount(const QUrl &url);
     int bookmarkId(const QUrl &url);
     int bookmarkId(const QUrl &url, const QString &title, const QString &folder);
     Bookmark getBookmark(int id);
 
     bool saveBookmark(const QUrl &url, const QString &title, const QIcon &icon, const QString &folder = "unsorted");
     bool saveBookmark(WebView* view, QString folder = QString());
+    // Saves all bookmarks in one transaction, missing folders are created.
+    // Only bookmarksImported() is emitted instead of per-bookmark signals.
+    bool saveBookmarks(const QList<Bookmark> &bookmarks);
 
     bool removeBookmark(int id);
     bool removeBookmark(const QUrl &url);
@@ -91,7 +103,13 @@ public:
     bool createFolder(const QString &name);
     bool removeFolder(const QString &name);
 
+    // Bookmarks are served from in-memory tree loaded once at startup,
+    // icons are decoded on first use and then shared by all views
     QList<Bookmark> folderBookmarks(const QString &name);
+    QList<Bookmark> allBookmarks();
+    // Folders from folders table (without menu, toolbar and unsorted) in order they were created
+    QList<Folder> folders();
+    void setToolbarPosition(int id, int position);
 
     bool createSubfolder(const QString &name);
     bool isSubfolder(const QString &name);
@@ -113,9 +131,36 @@ signals:
     void subfolderAdded(const QString &title);
     void folderRenamed(const QString &before, const QString &after);
 
+    // Bulk insert, may also contain new folders
+    void bookmarksImported(const QList<BookmarksModel::Bookmark> &bookmarks);
+
 public slots:
 
+private slots:
+    void treeBookmarkAdded(const BookmarksModel::Bookmark &bookmark);
+    void treeBookmarkDeleted(const BookmarksModel::Bookmark &bookmark);
+    void treeBookmarkEdited(const BookmarksModel::Bookmark &before, const BookmarksModel::Bookmark &after);
+    void treeFolderAdded(const QString &name);
+    void treeSubfolderAdded(const QString &name);
+    void treeFolderDeleted(const QString &name);
+    void treeFolderRenamed(const QString &before, const QString &after);
+
 private:
+    void loadBookmarks();
+    const Bookmark &treeBookmark(int id);
+    void removeFromUrlIndex(const QUrl &url, int id);
+
+    // In-memory copy of bookmarks and folders tables, kept in sync from own signals.
+    // Icons are kept as PNG data until the bookmark is needed.
+    QHash<int, Bookmark> m_bookmarks;
+    QHash<int, QByteArray> m_iconData;
+    QHash<int, int> m_toolbarPositions;
+    QHash<QString, QList<int> > m_folderBookmarks;
+    QList<Folder> m_folders;
+
+    // Normalized url (qz_normalizedUrl) -> ids of all bookmarks with this url
+    QMultiHash<QString, int> m_urlIndex;
+
     bool m_showMostVisited;
     bool m_showOnlyIconsInToolbar;
     QString m_lastFolder;
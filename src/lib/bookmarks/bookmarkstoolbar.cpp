@@ -21,8 +21,8 @@
 #include "bookmarksmodel.h"
 #include "iconprovider.h"
 #include "historymodel.h"
+#include "historycache.h"
 #include "toolbutton.h"
-#include "databasewriter.h"
 #include "enhancedmenu.h"
 #include "tabwidget.h"
 
@@ -59,6 +59,8 @@ BookmarksToolbar::BookmarksToolbar(QupZilla* mainClass, QWidget* parent)
     connect(m_bookmarksModel, SIGNAL(subfolderAdded(QString)), this, SLOT(subfolderAdded(QString)));
     connect(m_bookmarksModel, SIGNAL(folderDeleted(QString)), this, SLOT(folderDeleted(QString)));
     connect(m_bookmarksModel, SIGNAL(folderRenamed(QString, QString)), this, SLOT(folderRenamed(QString, QString)));
+    connect(m_bookmarksModel, SIGNAL(bookmarksImported(QList<BookmarksModel::Bookmark>)), this, SLOT(bookmarksImported(QList<BookmarksModel::Bookmark>)));
+    connect(m_historyModel->cache(), SIGNAL(entriesLoaded()), this, SLOT(historyCacheLoaded()));
 
     setMaximumWidth(p_QupZilla->width());
 
@@ -140,16 +142,8 @@ void BookmarksToolbar::moveRight()
     Bookmark bookmark = button->data().value<Bookmark>();
     Bookmark bookmarkRight = buttonRight->data().value<Bookmark>();
 
-    QSqlQuery query;
-    query.prepare("UPDATE bookmarks SET toolbar_position=? WHERE id=?");
-    query.addBindValue(index + 1);
-    query.addBindValue(bookmark.id);
-    mApp->dbWriter()->executeQuery(query);
-
-    query.prepare("UPDATE bookmarks SET toolbar_position=? WHERE id=?");
-    query.addBindValue(index);
-    query.addBindValue(bookmarkRight.id);
-    mApp->dbWriter()->executeQuery(query);
+    m_bookmarksModel->setToolbarPosition(bookmark.id, index + 1);
+    m_bookmarksModel->setToolbarPosition(bookmarkRight.id, index);
 
     QWidget* w = m_layout->takeAt(index)->widget();
     m_layout->insertWidget(index + 1, w);
@@ -177,16 +171,8 @@ void BookmarksToolbar::moveLeft()
     Bookmark bookmark = button->data().value<Bookmark>();
     Bookmark bookmarkLeft = buttonLeft->data().value<Bookmark>();
 
-    QSqlQuery query;
-    query.prepare("UPDATE bookmarks SET toolbar_position=? WHERE id=?");
-    query.addBindValue(index - 1);
-    query.addBindValue(bookmark.id);
-    mApp->dbWriter()->executeQuery(query);
-
-    query.prepare("UPDATE bookmarks SET toolbar_position=? WHERE id=?");
-    query.addBindValue(index);
-    query.addBindValue(bookmarkLeft.id);
-    mApp->dbWriter()->executeQuery(query);
+    m_bookmarksModel->setToolbarPosition(bookmark.id, index - 1);
+    m_bookmarksModel->setToolbarPosition(bookmarkLeft.id, index);
 
     QWidget* w = m_layout->takeAt(index)->widget();
     m_layout->insertWidget(index - 1, w);
@@ -418,11 +404,15 @@ void BookmarksToolbar::addBookmark(const BookmarksModel::Bookmark &bookmark)
     int indexForBookmark = indexOfLastBookmark();
     m_layout->insertWidget(indexForBookmark, button);
 
-    QSqlQuery query;
-    query.prepare("UPDATE bookmarks SET toolbar_position=? WHERE id=?");
-    query.addBindValue(indexForBookmark);
-    query.addBindValue(bookmark.id);
-    mApp->dbWriter()->executeQuery(query);
+    m_bookmarksModel->setToolbarPosition(bookmark.id, indexForBookmark);
+}
+
+void BookmarksToolbar::bookmarksImported(const QList<BookmarksModel::Bookmark> &bookmarks)
+{
+    // Only bookmarks imported into toolbar folder are added
+    foreach(const Bookmark & bookmark, bookmarks) {
+        addBookmark(bookmark);
+    }
 }
 
 void BookmarksToolbar::removeBookmark(const BookmarksModel::Bookmark &bookmark)
@@ -482,15 +472,7 @@ void BookmarksToolbar::bookmarkEdited(const BookmarksModel::Bookmark &before, co
 
 void BookmarksToolbar::refreshBookmarks()
 {
-    QSqlQuery query;
-    query.exec("SELECT id, title, url, icon FROM bookmarks WHERE folder='bookmarksToolbar' ORDER BY toolbar_position");
-    while (query.next()) {
-        Bookmark bookmark;
-        bookmark.id = query.value(0).toInt();
-        bookmark.title = query.value(1).toString();
-        bookmark.url = query.value(2).toUrl();
-        bookmark.image = QImage::fromData(query.value(3).toByteArray());
-        bookmark.folder = "bookmarksToolbar";
+    foreach(const Bookmark & bookmark, m_bookmarksModel->folderBookmarks("bookmarksToolbar")) {
         QString title = bookmark.title;
         if (title.length() > 15) {
             title.truncate(13);
@@ -517,16 +499,19 @@ void BookmarksToolbar::refreshBookmarks()
         m_layout->addWidget(button);
     }
 
-    query.exec("SELECT name FROM folders WHERE subfolder='yes'");
-    while (query.next()) {
+    foreach(const BookmarksModel::Folder & folder, m_bookmarksModel->folders()) {
+        if (!folder.subfolder) {
+            continue;
+        }
+
         ToolButton* b = new ToolButton(this);
         b->setPopupMode(QToolButton::InstantPopup);
         b->setToolButtonStyle(m_toolButtonStyle);
         b->setIcon(style()->standardIcon(QStyle::SP_DirIcon));
-        b->setText(query.value(0).toString());
+        b->setText(folder.name);
         connect(b, SIGNAL(middleMouseClicked()), this, SLOT(loadFolderBookmarksInTabs()));
 
-        Menu* menu = new Menu(query.value(0).toString());
+        Menu* menu = new Menu(folder.name);
         b->setMenu(menu);
         connect(menu, SIGNAL(aboutToShow()), this, SLOT(aboutToShowFolderMenu()));
 
@@ -624,10 +609,18 @@ void BookmarksToolbar::showOnlyIconsChanged()
     }
 }
 
+void BookmarksToolbar::historyCacheLoaded()
+{
+    if (m_menuMostVisited->isVisible()) {
+        refreshMostVisited();
+    }
+}
+
 void BookmarksToolbar::refreshMostVisited()
 {
     m_menuMostVisited->clear();
 
+    HistoryCache* cache = m_historyModel->cache();
     QList<HistoryEntry> mostList = m_historyModel->mostVisited(10);
     foreach(const HistoryEntry & entry, mostList) {
         QString title = entry.title;
@@ -636,7 +629,7 @@ void BookmarksToolbar::refreshMostVisited()
             title += "..";
         }
 
-        Action* act = new Action(_iconForUrl(entry.url), title);
+        Action* act = new Action(cache->icon(entry), title);
         act->setData(entry.url);
         connect(act, SIGNAL(triggered()), p_QupZilla, SLOT(loadActionUrl()));
         connect(act, SIGNAL(middleClicked()), p_QupZilla, SLOT(loadActionUrlInNewNotSelectedTab()));
@@ -50,6 +50,7 @@ private slots:
     void loadFolderBookmarksInTabs();
 
     void aboutToShowFolderMenu();
+    void historyCacheLoaded();
     void showBookmarkContextMenu(const QPoint &pos);
     void customContextMenuRequested(const QPoint &pos);
 
@@ -62,6 +63,7 @@ private slots:
     void toggleShowOnlyIcons();
 
     void addBookmark(const BookmarksModel::Bookmark &bookmark);
+    void bookmarksImported(const QList<BookmarksModel::Bookmark> &bookmarks);
     void removeBookmark(const BookmarksModel::Bookmark &bookmark);
     void bookmarkEdited(const BookmarksModel::Bookmark &before, const BookmarksModel::Bookmark &after);
     void subfolderAdded(const QString &name);
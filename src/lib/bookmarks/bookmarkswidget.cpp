@@ -24,7 +24,6 @@
 #include "webview.h"
 
 #include <QToolTip>
-#include <QSqlQuery>
 
 BookmarksWidget::BookmarksWidget(WebView* view, QWidget* parent)
     : QMenu(parent)
@@ -72,10 +71,8 @@ void BookmarksWidget::loadBookmark()
         ui->folder->addItem(QIcon(":icons/other/unsortedbookmarks.png"), _bookmarksUnsorted, "unsorted");
         ui->folder->addItem(style()->standardIcon(QStyle::SP_DirOpenIcon), _bookmarksMenu, "bookmarksMenu");
         ui->folder->addItem(style()->standardIcon(QStyle::SP_DirOpenIcon), _bookmarksToolbar, "bookmarksToolbar");
-        QSqlQuery query;
-        query.exec("SELECT name FROM folders");
-        while (query.next()) {
-            ui->folder->addItem(style()->standardIcon(QStyle::SP_DirIcon), query.value(0).toString(), query.value(0).toString());
+        foreach(const BookmarksModel::Folder & folder, m_bookmarksModel->folders()) {
+            ui->folder->addItem(style()->standardIcon(QStyle::SP_DirIcon), folder.name, folder.name);
         }
 
         ui->folder->setCurrentIndex(ui->folder->findData(bookmark.folder));
@@ -30,6 +30,7 @@
 #include <QMessageBox>
 #include <QFileDialog>
 #include <QThread>
+#include <QtConcurrentRun>
 
 BookmarksImportDialog::BookmarksImportDialog(QWidget* parent)
     : QDialog(parent)
@@ -37,6 +38,10 @@ BookmarksImportDialog::BookmarksImportDialog(QWidget* parent)
     , m_currentPage(0)
     , m_fetcher(0)
     , m_fetcherThread(0)
+    , m_htmlImporter(0)
+    , m_chromeImporter(0)
+    , m_importWatcher(0)
+    , m_importCancelled(false)
 {
     setAttribute(Qt::WA_DeleteOnClose);
     ui->setupUi(this);
@@ -75,7 +80,13 @@ void BookmarksImportDialog::nextPage()
             return;
         }
 
-        if (exportedOK()) {
+        if (m_browser == Html || m_browser == Chrome) {
+            if (startImporting()) {
+                m_currentPage++;
+                ui->stackedWidget->setCurrentIndex(m_currentPage);
+            }
+        }
+        else if (exportedOK()) {
             m_currentPage++;
             ui->stackedWidget->setCurrentIndex(m_currentPage);
             startFetchingIcons();
@@ -92,6 +103,92 @@ void BookmarksImportDialog::nextPage()
     }
 }
 
+bool BookmarksImportDialog::startImporting()
+{
+    QFuture<QList<Bookmark> > future;
+
+    if (m_browser == Html) {
+        m_htmlImporter = new HtmlImporter(this);
+        m_htmlImporter->setFile(ui->fileLine->text());
+        if (!m_htmlImporter->openFile()) {
+            QMessageBox::critical(this, tr("Error!"), m_htmlImporter->errorString());
+            delete m_htmlImporter;
+            m_htmlImporter = 0;
+            return false;
+        }
+
+        connect(m_htmlImporter, SIGNAL(progress(int)), this, SLOT(importProgress(int)));
+        future = QtConcurrent::run(m_htmlImporter, &HtmlImporter::exportBookmarks);
+    }
+    else {
+        m_chromeImporter = new ChromeImporter(this);
+        m_chromeImporter->setFile(ui->fileLine->text());
+        if (!m_chromeImporter->openFile()) {
+            QMessageBox::critical(this, tr("Error!"), m_chromeImporter->errorString());
+            delete m_chromeImporter;
+            m_chromeImporter = 0;
+            return false;
+        }
+
+        connect(m_chromeImporter, SIGNAL(progress(int)), this, SLOT(importProgress(int)));
+        future = QtConcurrent::run(m_chromeImporter, &ChromeImporter::exportBookmarks);
+    }
+
+    m_importCancelled = false;
+    ui->nextButton->setEnabled(false);
+    ui->fetchingLabel->setText(tr("Importing bookmarks, please wait..."));
+    ui->progressBar->setValue(0);
+    ui->progressBar->setMaximum(100);
+
+    m_importWatcher = new QFutureWatcher<QList<Bookmark> >(this);
+    connect(m_importWatcher, SIGNAL(finished()), this, SLOT(importFinished()));
+    m_importWatcher->setFuture(future);
+
+    return true;
+}
+
+void BookmarksImportDialog::importProgress(int percent)
+{
+    ui->progressBar->setValue(percent);
+}
+
+void BookmarksImportDialog::importFinished()
+{
+    const QList<Bookmark> list = m_importWatcher->result();
+    const bool cancelled = m_importCancelled;
+    QString errorString;
+
+    if (m_htmlImporter && m_htmlImporter->error()) {
+        errorString = m_htmlImporter->errorString();
+    }
+    else if (m_chromeImporter && m_chromeImporter->error()) {
+        errorString = m_chromeImporter->errorString();
+    }
+
+    m_importWatcher->deleteLater();
+    m_importWatcher = 0;
+    delete m_htmlImporter;
+    m_htmlImporter = 0;
+    delete m_chromeImporter;
+    m_chromeImporter = 0;
+
+    if (cancelled || !errorString.isEmpty()) {
+        if (!errorString.isEmpty()) {
+            QMessageBox::critical(this, tr("Error!"), errorString);
+        }
+
+        // Back to choosing file
+        m_currentPage--;
+        ui->stackedWidget->setCurrentIndex(m_currentPage);
+        ui->nextButton->setEnabled(true);
+        return;
+    }
+
+    m_exportedBookmarks = list;
+    ui->fetchingLabel->setText(tr("Fetching icons, please wait..."));
+    startFetchingIcons();
+}
+
 void BookmarksImportDialog::startFetchingIcons()
 {
     ui->nextButton->setText(tr("Finish"));
@@ -107,7 +204,12 @@ void BookmarksImportDialog::startFetchingIcons()
     QIcon folderIcon = style()->standardIcon(QStyle::SP_DirIcon);
     QHash<QString, QTreeWidgetItem*> hash;
 
-    foreach(const Bookmark & b, m_exportedBookmarks) {
+    // Icons already known from browsing are not fetched again, once per host
+    QHash<QString, QImage> knownIcons;
+    int knownCount = 0;
+
+    for (int i = 0; i < m_exportedBookmarks.count(); ++i) {
+        Bookmark &b = m_exportedBookmarks[i];
         QTreeWidgetItem* item;
         QTreeWidgetItem* findParent = hash[b.folder];
         if (findParent) {
@@ -123,7 +225,14 @@ void BookmarksImportDialog::startFetchingIcons()
             item = new QTreeWidgetItem(newParent);
         }
 
-        QVariant bookmarkVariant = qVariantFromValue(b);
+        if (b.image.isNull()) {
+            const QString host = b.url.host();
+            if (!knownIcons.contains(host)) {
+                knownIcons.insert(host, host.isEmpty() ? QImage() : mApp->iconProvider()->iconForDomain(b.url));
+            }
+            b.image = knownIcons.value(host);
+        }
+
         item->setText(0, b.title);
         if (b.image.isNull()) {
             item->setIcon(0, defaultIcon);
@@ -132,33 +241,56 @@ void BookmarksImportDialog::startFetchingIcons()
             item->setIcon(0, QIcon(QPixmap::fromImage(b.image)));
         }
         item->setText(1, b.url.toString());
-        item->setData(0, Qt::UserRole + 10, bookmarkVariant);
+        // Index to m_exportedBookmarks
+        item->setData(0, Qt::UserRole + 10, i);
 
         ui->treeWidget->addTopLevelItem(item);
 
-        m_fetcher->addEntry(b.url, item);
+        if (b.image.isNull()) {
+            m_fetcher->addEntry(b.url, item);
+        }
+        else {
+            knownCount++;
+        }
     }
 
     ui->treeWidget->expandAll();
 
     connect(m_fetcher, SIGNAL(iconFetched(QImage, QTreeWidgetItem*)), this, SLOT(iconFetched(QImage, QTreeWidgetItem*)));
-    connect(m_fetcher, SIGNAL(oneFinished()), this, SLOT(loadFinished()));
+    connect(m_fetcher, SIGNAL(entriesFinished(int)), this, SLOT(loadFinished(int)));
 
     m_fetcherThread->start();
     m_fetcher->startFetching();
+
+    loadFinished(knownCount);
 }
 
 void BookmarksImportDialog::stopDownloading()
 {
+    if (m_importWatcher) {
+        m_importCancelled = true;
+        if (m_htmlImporter) {
+            m_htmlImporter->cancel();
+        }
+        if (m_chromeImporter) {
+            m_chromeImporter->cancel();
+        }
+        return;
+    }
+
+    if (m_fetcher) {
+        QMetaObject::invokeMethod(m_fetcher, "cancel");
+    }
+
     ui->nextButton->setEnabled(true);
     ui->stopButton->hide();
     ui->progressBar->setValue(ui->progressBar->maximum());
     ui->fetchingLabel->setText(tr("Please press Finish to complete importing process."));
 }
 
-void BookmarksImportDialog::loadFinished()
+void BookmarksImportDialog::loadFinished(int count)
 {
-    ui->progressBar->setValue(ui->progressBar->value() + 1);
+    ui->progressBar->setValue(ui->progressBar->value() + count);
 
     if (ui->progressBar->value() == ui->progressBar->maximum()) {
         ui->stopButton->hide();
@@ -171,11 +303,10 @@ void BookmarksImportDialog::iconFetched(const QImage &image, QTreeWidgetItem* it
 {
     item->setIcon(0, QIcon(QPixmap::fromImage(image)));
 
-    Bookmark b = item->data(0, Qt::UserRole + 10).value<Bookmark>();
-
-    m_exportedBookmarks.removeOne(b);
-    b.image = image;
-    m_exportedBookmarks.append(b);
+    int index = item->data(0, Qt::UserRole + 10).toInt();
+    if (index >= 0 && index < m_exportedBookmarks.count()) {
+        m_exportedBookmarks[index].image = image;
+    }
 }
 
 bool BookmarksImportDialog::exportedOK()
@@ -193,19 +324,6 @@ bool BookmarksImportDialog::exportedOK()
         }
         return true;
     }
-    else if (m_browser == Chrome) {
-        ChromeImporter chrome(this);
-        chrome.setFile(ui->fileLine->text());
-        if (chrome.openFile()) {
-            m_exportedBookmarks = chrome.exportBookmarks();
-        }
-
-        if (chrome.error()) {
-            QMessageBox::critical(this, tr("Error!"), chrome.errorString());
-            return false;
-        }
-        return true;
-    }
     else if (m_browser == Opera) {
         OperaImporter opera(this);
         opera.setFile(ui->fileLine->text());
@@ -219,20 +337,6 @@ bool BookmarksImportDialog::exportedOK()
         }
         return true;
     }
-    else if (m_browser == Html) {
-        HtmlImporter html(this);
-        html.setFile(ui->fileLine->text());
-        if (html.openFile()) {
-            m_exportedBookmarks = html.exportBookmarks();
-        }
-
-        if (html.error()) {
-            QMessageBox::critical(this, tr("Error!"), html.errorString());
-            return false;
-        }
-        return true;
-    }
-
     return false;
 }
 
@@ -261,11 +365,8 @@ void BookmarksImportDialog::addExportedBookmarks()
 {
     qApp->setOverrideCursor(Qt::WaitCursor);
 
-    BookmarksModel* model = mApp->bookmarksModel();
-
-    foreach(const Bookmark & b, m_exportedBookmarks) {
-        model->saveBookmark(b.url, b.title, IconProvider::iconFromImage(b.image), b.folder);
-    }
+    // One transaction and one change notification for whole import
+    mApp->bookmarksModel()->saveBookmarks(m_exportedBookmarks);
 
     qApp->restoreOverrideCursor();
 }
@@ -345,9 +446,21 @@ void BookmarksImportDialog::setupBrowser(Browser browser)
 
 BookmarksImportDialog::~BookmarksImportDialog()
 {
+    if (m_importWatcher) {
+        if (m_htmlImporter) {
+            m_htmlImporter->cancel();
+        }
+        if (m_chromeImporter) {
+            m_chromeImporter->cancel();
+        }
+        m_importWatcher->waitForFinished();
+    }
+
     delete ui;
 
     if (m_fetcherThread) {
+        // Pending fetches must not outlive tree items
+        QMetaObject::invokeMethod(m_fetcher, "cancel", Qt::BlockingQueuedConnection);
         m_fetcherThread->exit();
         m_fetcherThread->wait();
 
@@ -20,6 +20,7 @@
 
 #include <QDialog>
 #include <QPair>
+#include <QFutureWatcher>
 
 #include "qz_namespace.h"
 #include "bookmarksmodel.h"
@@ -33,6 +34,8 @@ class QTreeWidgetItem;
 class QThread;
 
 class BookmarksImportIconFetcher;
+class HtmlImporter;
+class ChromeImporter;
 
 class QT_QUPZILLA_EXPORT BookmarksImportDialog : public QDialog
 {
@@ -48,13 +51,17 @@ private slots:
 
     void stopDownloading();
     void iconFetched(const QImage &image, QTreeWidgetItem* item);
-    void loadFinished();
+    void loadFinished(int count);
+
+    void importProgress(int percent);
+    void importFinished();
 
 private:
     enum Browser { Firefox = 0, Chrome = 1, Opera = 2, Html = 3, IE = 4};
 
     void setupBrowser(Browser browser);
     bool exportedOK();
+    bool startImporting();
     void startFetchingIcons();
     void addExportedBookmarks();
 
@@ -74,6 +81,12 @@ private:
 
     BookmarksImportIconFetcher* m_fetcher;
     QThread* m_fetcherThread;
+
+    // Html and Chrome files are parsed in worker thread
+    HtmlImporter* m_htmlImporter;
+    ChromeImporter* m_chromeImporter;
+    QFutureWatcher<QList<BookmarksModel::Bookmark> >* m_importWatcher;
+    bool m_importCancelled;
 };
 
 #endif // BOOKMARKSIMPORTDIALOG_H
@@ -19,20 +19,31 @@
 #include "iconfetcher.h"
 
 #include <QTimer>
+#include <QImage>
+#include <QMetaType>
 #include <QNetworkAccessManager>
 
+// Each fetch downloads head of one page and one icon
+#define MAX_RUNNING_FETCHES 6
+
 BookmarksImportIconFetcher::BookmarksImportIconFetcher(QObject* parent)
     : QObject(parent)
+    , m_manager(0)
+    , m_cancelled(false)
 {
+    // Signals are delivered across threads
+    qRegisterMetaType<QTreeWidgetItem*>("QTreeWidgetItem*");
 }
 
 void BookmarksImportIconFetcher::addEntry(const QUrl &url, QTreeWidgetItem* item)
 {
-    Pair pair;
-    pair.url = url;
-    pair.item = item;
+    const QString host = url.host();
+
+    if (!m_hostItems.contains(host)) {
+        m_queue.append(url);
+    }
 
-    m_pairs.append(pair);
+    m_hostItems[host].append(item);
 }
 
 void BookmarksImportIconFetcher::startFetching()
@@ -40,45 +51,75 @@ void BookmarksImportIconFetcher::startFetching()
     QTimer::singleShot(0, this, SLOT(slotStartFetching()));
 }
 
+void BookmarksImportIconFetcher::cancel()
+{
+    m_cancelled = true;
+
+    QHash<IconFetcher*, QString>::const_iterator it = m_fetchers.constBegin();
+    while (it != m_fetchers.constEnd()) {
+        it.key()->abort();
+        it.key()->deleteLater();
+        ++it;
+    }
+
+    m_fetchers.clear();
+    m_queue.clear();
+    m_hostItems.clear();
+}
+
 void BookmarksImportIconFetcher::slotIconFetched(const QImage &image)
 {
     IconFetcher* fetcher = qobject_cast<IconFetcher*>(sender());
-    if (!fetcher) {
+    if (!fetcher || !m_fetchers.contains(fetcher)) {
         return;
     }
 
-    QTreeWidgetItem* itemPointer = static_cast<QTreeWidgetItem*>(fetcher->data().value<void*>());
-
-    emit iconFetched(image, itemPointer);
+    foreach(QTreeWidgetItem * item, m_hostItems.value(m_fetchers.value(fetcher))) {
+        emit iconFetched(image, item);
+    }
 }
 
 void BookmarksImportIconFetcher::slotFetcherFinished()
 {
     IconFetcher* fetcher = qobject_cast<IconFetcher*>(sender());
-    if (!fetcher) {
+    if (!fetcher || !m_fetchers.contains(fetcher)) {
         return;
     }
 
-    m_fetchers.removeOne(fetcher);
+    const QString host = m_fetchers.take(fetcher);
+    fetcher->deleteLater();
+
+    emit entriesFinished(m_hostItems.take(host).count());
 
-    emit oneFinished();
+    startNextFetches();
 }
 
 void BookmarksImportIconFetcher::slotStartFetching()
 {
-    QNetworkAccessManager* manager = new QNetworkAccessManager(this);
+    if (!m_manager) {
+        m_manager = new QNetworkAccessManager(this);
+    }
 
-    foreach(const Pair & pair, m_pairs) {
-        QVariant itemPointer = qVariantFromValue((void*) pair.item);
+    startNextFetches();
+}
 
-        IconFetcher* fetcher = new IconFetcher(this);
-        fetcher->setNetworkAccessManager(manager);
-        fetcher->setData(itemPointer);
-        fetcher->fetchIcon(pair.url);
+void BookmarksImportIconFetcher::startNextFetches()
+{
+    while (!m_cancelled && !m_queue.isEmpty() && m_fetchers.count() < MAX_RUNNING_FETCHES) {
+        const QUrl url = m_queue.takeFirst();
 
+        // Nothing to fetch for urls without host (eg. local files)
+        if (url.host().isEmpty()) {
+            emit entriesFinished(m_hostItems.take(url.host()).count());
+            continue;
+        }
+
+        IconFetcher* fetcher = new IconFetcher(this);
+        fetcher->setNetworkAccessManager(m_manager);
         connect(fetcher, SIGNAL(iconFetched(QImage)), this, SLOT(slotIconFetched(QImage)));
         connect(fetcher, SIGNAL(finished()), this, SLOT(slotFetcherFinished()));
 
-        m_fetchers.append(fetcher);
+        m_fetchers.insert(fetcher, url.host());
+        fetcher->fetchIcon(url);
     }
 }
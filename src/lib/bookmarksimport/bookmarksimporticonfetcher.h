@@ -21,6 +21,7 @@
 #include <QObject>
 #include <QUrl>
 #include <QList>
+#include <QHash>
 
 #include "qz_namespace.h"
 
@@ -30,23 +31,24 @@ class QImage;
 
 class IconFetcher;
 
+// Icon is fetched only once for each host, with limited number of parallel fetches
 class QT_QUPZILLA_EXPORT BookmarksImportIconFetcher : public QObject
 {
     Q_OBJECT
 public:
-    struct Pair {
-        QUrl url;
-        QTreeWidgetItem* item;
-    };
-
     explicit BookmarksImportIconFetcher(QObject* parent = 0);
 
     void addEntry(const QUrl &url, QTreeWidgetItem* item);
     void startFetching();
 
+public slots:
+    // Aborts running fetches and drops queued ones
+    void cancel();
+
 signals:
     void iconFetched(const QImage &image, QTreeWidgetItem* item);
-    void oneFinished();
+    // Number of entries finished (with or without icon)
+    void entriesFinished(int count);
 
 private slots:
     void slotStartFetching();
@@ -55,8 +57,18 @@ private slots:
     void slotFetcherFinished();
 
 private:
-    QList<Pair> m_pairs;
-    QList<IconFetcher*> m_fetchers;
+    void startNextFetches();
+
+    QNetworkAccessManager* m_manager;
+
+    // Host -> items waiting for its icon
+    QHash<QString, QList<QTreeWidgetItem*> > m_hostItems;
+    // First url of each host, in order they were added
+    QList<QUrl> m_queue;
+
+    // Running fetcher -> its host
+    QHash<IconFetcher*, QString> m_fetchers;
+    bool m_cancelled;
 
 };
 
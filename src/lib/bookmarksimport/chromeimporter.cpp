@@ -16,16 +16,14 @@
 * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 * ============================================================ */
 #include "chromeimporter.h"
-#include "globalfunctions.h"
 #include "bookmarksimportdialog.h"
 
-#include <QScriptEngine>
-#include <QScriptValue>
-#include <QScriptValueIterator>
-#include <QRegExp>
+#define CHUNK_SIZE 64 * 1024
 
 ChromeImporter::ChromeImporter(QObject* parent)
     : QObject(parent)
+    , m_pos(0)
+    , m_cancelled(0)
     , m_error(false)
     , m_errorString(BookmarksImportDialog::tr("No Error"))
 {
@@ -46,51 +44,343 @@ bool ChromeImporter::openFile()
         return false;
     }
 
+    m_stream.setDevice(&m_file);
+    m_stream.setCodec("UTF-8");
+
     return true;
 }
 
-QList<BookmarksModel::Bookmark> ChromeImporter::exportBookmarks()
+void ChromeImporter::cancel()
 {
-    QList<BookmarksModel::Bookmark> list;
+    m_cancelled = 1;
+}
 
-    QString bookmarks = QString::fromUtf8(m_file.readAll());
-    m_file.close();
+bool ChromeImporter::readChunk()
+{
+    if (m_stream.atEnd()) {
+        return false;
+    }
+
+    m_buffer = m_stream.read(CHUNK_SIZE);
+    m_pos = 0;
+
+    if (m_file.size() > 0) {
+        emit progress(int(m_file.pos() * 100 / m_file.size()));
+    }
+
+    return !m_buffer.isEmpty();
+}
+
+QChar ChromeImporter::peekChar()
+{
+    // Skips whitespace, returns null character at the end of file
+    forever {
+        if (m_pos >= m_buffer.size() && !readChunk()) {
+            return QChar();
+        }
+
+        const QChar c = m_buffer.at(m_pos);
+        if (!c.isSpace()) {
+            return c;
+        }
+        ++m_pos;
+    }
+}
+
+bool ChromeImporter::expectChar(QChar c)
+{
+    if (peekChar() != c) {
+        return false;
+    }
+
+    ++m_pos;
+    return true;
+}
+
+bool ChromeImporter::parseString(QString &string)
+{
+    if (!expectChar(QLatin1Char('"'))) {
+        return false;
+    }
+
+    string.clear();
+
+    forever {
+        if (m_pos >= m_buffer.size() && !readChunk()) {
+            return false;
+        }
+
+        // Copy everything up to the next quote or escape at once
+        int end = m_pos;
+        while (end < m_buffer.size() && m_buffer.at(end) != QLatin1Char('"') && m_buffer.at(end) != QLatin1Char('\\')) {
+            ++end;
+        }
+        string.append(m_buffer.midRef(m_pos, end - m_pos));
+        m_pos = end;
+
+        if (m_pos >= m_buffer.size()) {
+            continue;
+        }
+
+        if (m_buffer.at(m_pos++) == QLatin1Char('"')) {
+            return true;
+        }
+
+        // Escape sequence
+        if (m_pos >= m_buffer.size() && !readChunk()) {
+            return false;
+        }
+
+        const QChar c = m_buffer.at(m_pos++);
+        switch (c.toLatin1()) {
+        case 'b':
+            string.append(QLatin1Char('\b'));
+            break;
+        case 'f':
+            string.append(QLatin1Char('\f'));
+            break;
+        case 'n':
+            string.append(QLatin1Char('\n'));
+            break;
+        case 'r':
+            string.append(QLatin1Char('\r'));
+            break;
+        case 't':
+            string.append(QLatin1Char('\t'));
+            break;
+        case 'u': {
+            QString hex;
+            while (hex.size() < 4) {
+                if (m_pos >= m_buffer.size() && !readChunk()) {
+                    return false;
+                }
+                hex.append(m_buffer.at(m_pos++));
+            }
+
+            bool ok;
+            ushort code = hex.toUShort(&ok, 16);
+            if (!ok) {
+                return false;
+            }
+            // Characters outside BMP come as two escaped surrogates, appending them one by one is enough
+            string.append(QChar(code));
+            break;
+        }
+        default:
+            string.append(c);
+            break;
+        }
+    }
+}
+
+bool ChromeImporter::skipValue()
+{
+    const QChar c = peekChar();
+
+    if (c == QLatin1Char('"')) {
+        QString dummy;
+        return parseString(dummy);
+    }
+
+    if (c == QLatin1Char('{') || c == QLatin1Char('[')) {
+        const QChar close = c == QLatin1Char('{') ? QLatin1Char('}') : QLatin1Char(']');
+        ++m_pos;
+
+        if (expectChar(close)) {
+            return true;
+        }
+
+        forever {
+            if (c == QLatin1Char('{')) {
+                QString key;
+                if (!parseString(key) || !expectChar(QLatin1Char(':'))) {
+                    return false;
+                }
+            }
+            if (!skipValue()) {
+                return false;
+            }
+            if (expectChar(close)) {
+                return true;
+            }
+            if (!expectChar(QLatin1Char(','))) {
+                return false;
+            }
+        }
+    }
+
+    // Number, true, false or null
+    bool found = false;
+    forever {
+        if (m_pos >= m_buffer.size() && !readChunk()) {
+            return found;
+        }
 
-    QStringList parsedBookmarks;
-    QRegExp rx("\\{(\\s*)\"date_added(.*)\"(\\s*)\\}", Qt::CaseSensitive);
-    rx.setMinimal(true);
+        const QChar ch = m_buffer.at(m_pos);
+        if (ch.isSpace() || ch == QLatin1Char(',') || ch == QLatin1Char('}') || ch == QLatin1Char(']')) {
+            return found;
+        }
+        found = true;
+        ++m_pos;
+    }
+}
 
-    int pos = 0;
-    while ((pos = rx.indexIn(bookmarks, pos)) != -1) {
-        parsedBookmarks << rx.cap(0);
-        pos += rx.matchedLength();
+bool ChromeImporter::parseNode(QList<BookmarksModel::Bookmark> &list)
+{
+    if (m_cancelled || !expectChar(QLatin1Char('{'))) {
+        return false;
     }
 
-    QScriptEngine* scriptEngine = new QScriptEngine();
-    foreach(QString parsedString, parsedBookmarks) {
-        parsedString = "(" + parsedString + ")";
-        if (scriptEngine->canEvaluate(parsedString)) {
-            QScriptValue object = scriptEngine->evaluate(parsedString);
-            QString name = object.property("name").toString();
-            QUrl url = QUrl::fromEncoded(object.property("url").toString().toUtf8());
+    // Children are listed before name of the folder, so their folder
+    // is completed only after whole folder object was parsed
+    const int firstChild = list.count();
+    QString name;
+    QString type;
+    QString url;
+
+    if (!expectChar(QLatin1Char('}'))) {
+        forever {
+            QString key;
+            if (!parseString(key) || !expectChar(QLatin1Char(':'))) {
+                return false;
+            }
+
+            bool ok;
+            if (key == QLatin1String("children")) {
+                ok = expectChar(QLatin1Char('['));
+                if (ok && !expectChar(QLatin1Char(']'))) {
+                    do {
+                        ok = parseNode(list);
+                    }
+                    while (ok && expectChar(QLatin1Char(',')));
+                    ok = ok && expectChar(QLatin1Char(']'));
+                }
+            }
+            else if (key == QLatin1String("name")) {
+                ok = parseString(name);
+            }
+            else if (key == QLatin1String("type")) {
+                ok = parseString(type);
+            }
+            else if (key == QLatin1String("url")) {
+                ok = parseString(url);
+            }
+            else {
+                ok = skipValue();
+            }
 
-            if (name.isEmpty() || url.isEmpty()) {
-                continue;
+            if (!ok) {
+                return false;
             }
+            if (expectChar(QLatin1Char('}'))) {
+                break;
+            }
+            if (!expectChar(QLatin1Char(','))) {
+                return false;
+            }
+        }
+    }
 
+    if (type == QLatin1String("url")) {
+        const QUrl bookmarkUrl = QUrl::fromEncoded(url.toUtf8());
+        if (!name.isEmpty() && !bookmarkUrl.isEmpty()) {
             BookmarksModel::Bookmark b;
-            b.folder = "Chrome Import";
             b.title = name;
-            b.url = url;
+            b.url = bookmarkUrl;
 
             list.append(b);
         }
+    }
+    else if (type == QLatin1String("folder") && !name.isEmpty()) {
+        // Nested folders are flattened into "Parent/Child" folder names
+        for (int i = firstChild; i < list.count(); ++i) {
+            BookmarksModel::Bookmark &b = list[i];
+            b.folder = b.folder.isEmpty() ? name : name + QLatin1Char('/') + b.folder;
+        }
+    }
+
+    return true;
+}
+
+bool ChromeImporter::parseRoots(QList<BookmarksModel::Bookmark> &list)
+{
+    if (!expectChar(QLatin1Char('{'))) {
+        return false;
+    }
+    if (expectChar(QLatin1Char('}'))) {
+        return true;
+    }
+
+    forever {
+        QString key;
+        if (!parseString(key) || !expectChar(QLatin1Char(':'))) {
+            return false;
+        }
+
+        // "bookmark_bar", "other" and "synced" are folder nodes
+        bool ok = peekChar() == QLatin1Char('{') ? parseNode(list) : skipValue();
+        if (!ok) {
+            return false;
+        }
+        if (expectChar(QLatin1Char('}'))) {
+            return true;
+        }
+        if (!expectChar(QLatin1Char(','))) {
+            return false;
+        }
+    }
+}
+
+QList<BookmarksModel::Bookmark> ChromeImporter::exportBookmarks()
+{
+    QList<BookmarksModel::Bookmark> list;
+
+    m_buffer.clear();
+    m_pos = 0;
+
+    bool ok = expectChar(QLatin1Char('{'));
+    bool rootsFound = false;
+
+    while (ok && !expectChar(QLatin1Char('}'))) {
+        QString key;
+        ok = parseString(key) && expectChar(QLatin1Char(':'));
+        if (!ok) {
+            break;
+        }
+
+        if (key == QLatin1String("roots")) {
+            ok = parseRoots(list);
+            rootsFound = true;
+        }
         else {
-            m_error = true;
-            m_errorString = BookmarksImportDialog::tr("Cannot evaluate JSON code.");
+            ok = skipValue();
+        }
+
+        if (ok && peekChar() == QLatin1Char(',')) {
+            ++m_pos;
         }
     }
 
+    m_file.close();
+    m_buffer.clear();
+
+    if (m_cancelled) {
+        return QList<BookmarksModel::Bookmark>();
+    }
+
+    if (!ok || !rootsFound) {
+        m_error = true;
+        m_errorString = BookmarksImportDialog::tr("Cannot evaluate JSON code.");
+        return QList<BookmarksModel::Bookmark>();
+    }
+
+    for (int i = 0; i < list.count(); ++i) {
+        if (list.at(i).folder.isEmpty()) {
+            list[i].folder = "Chrome Import";
+        }
+    }
+
+    emit progress(100);
+
     return list;
 }
-
@@ -20,26 +20,52 @@
 
 #include <QObject>
 #include <QFile>
+#include <QTextStream>
+#include <QAtomicInt>
 
 #include "qz_namespace.h"
 #include "bookmarksmodel.h"
 
 class QT_QUPZILLA_EXPORT ChromeImporter : public QObject
 {
+    Q_OBJECT
+
 public:
     explicit ChromeImporter(QObject* parent = 0);
 
     void setFile(const QString &path);
     bool openFile();
 
+    // Single pass over the file, safe to run in worker thread
     QList<BookmarksModel::Bookmark> exportBookmarks();
 
     bool error() { return m_error; }
     QString errorString() { return m_errorString; }
 
+public slots:
+    void cancel();
+
+signals:
+    // Percentage of file parsed
+    void progress(int percent);
+
 private:
+    bool readChunk();
+    QChar peekChar();
+    bool expectChar(QChar c);
+
+    bool parseRoots(QList<BookmarksModel::Bookmark> &list);
+    bool parseNode(QList<BookmarksModel::Bookmark> &list);
+    bool parseString(QString &string);
+    bool skipValue();
+
     QString m_path;
     QFile m_file;
+    QTextStream m_stream;
+
+    QString m_buffer;
+    int m_pos;
+    QAtomicInt m_cancelled;
 
     bool m_error;
     QString m_errorString;
@@ -17,9 +17,10 @@
 * ============================================================ */
 #include "firefoximporter.h"
 #include "bookmarksimportdialog.h"
+#include "sqlquery.h"
 
-#include <QSqlQuery>
 #include <QSqlError>
+#include <QStringList>
 
 FirefoxImporter::FirefoxImporter(QObject* parent)
     : QObject(parent)
@@ -54,40 +55,107 @@ bool FirefoxImporter::openDatabase()
     return true;
 }
 
+struct FirefoxFolder {
+    int parent;
+    QString title;
+};
+
 QList<BookmarksModel::Bookmark> FirefoxImporter::exportBookmarks()
 {
     QList<BookmarksModel::Bookmark> list;
 
-    QSqlQuery query(db);
-    query.exec("SELECT title, fk FROM moz_bookmarks WHERE title != ''");
-    while (query.next()) {
-        QString title = query.value(0).toString();
-        int placesId = query.value(1).toInt();
+    // Folders and bookmarks are read at once, folder hierarchy is then resolved in memory.
+    // type 1 = bookmark, 2 = folder
+    SqlQuery query("import", db);
+    query.exec("SELECT b.type, b.id, b.parent, b.title, b.guid, p.url FROM moz_bookmarks b "
+               "LEFT JOIN moz_places p ON p.id = b.fk "
+               "WHERE b.type IN (1, 2) ORDER BY b.parent, b.position");
 
-        QSqlQuery query2(db);
-        query2.exec("SELECT url FROM moz_places WHERE id=" + QString::number(placesId));
+    QHash<int, FirefoxFolder> folders;
+    QList<QPair<int, BookmarksModel::Bookmark> > bookmarks;
+    int tagsFolder = -1;
 
-        if (!query2.next()) {
+    while (query.next()) {
+        const int type = query.value(0).toInt();
+        const int id = query.value(1).toInt();
+        const int parent = query.value(2).toInt();
+        const QString title = query.value(3).toString();
+
+        if (type == 2) {
+            FirefoxFolder folder;
+            folder.parent = parent;
+            folder.title = title;
+            folders.insert(id, folder);
+
+            if (query.value(4).toString() == QLatin1String("tags________")) {
+                tagsFolder = id;
+            }
             continue;
         }
 
-        QUrl url = query2.value(0).toUrl();
+        const QUrl url = QUrl::fromEncoded(query.value(5).toByteArray());
 
         if (title.isEmpty() || url.isEmpty() || url.scheme() == "place" || url.scheme() == "about") {
             continue;
         }
 
         BookmarksModel::Bookmark b;
-        b.folder = "Firefox Import";
         b.title = title;
         b.url = url;
 
-        list.append(b);
+        bookmarks.append(qMakePair(parent, b));
     }
 
     if (query.lastError().isValid()) {
         m_error = true;
         m_errorString = query.lastError().text();
+        return list;
+    }
+
+    // Folder id -> "Parent/Child" path, places root (without parent) and tags are skipped
+    QHash<int, QString> paths;
+
+    for (int i = 0; i < bookmarks.count(); ++i) {
+        const int parent = bookmarks.at(i).first;
+        BookmarksModel::Bookmark b = bookmarks.at(i).second;
+
+        if (!paths.contains(parent)) {
+            QStringList path;
+            bool isTag = false;
+            int id = parent;
+
+            // Depth limit protects against cycles in damaged database
+            for (int depth = 0; depth < 100 && folders.contains(id); ++depth) {
+                if (id == tagsFolder) {
+                    isTag = true;
+                    break;
+                }
+
+                const FirefoxFolder &folder = folders[id];
+                if (!folders.contains(folder.parent)) {
+                    break;
+                }
+                if (!folder.title.isEmpty()) {
+                    path.prepend(folder.title);
+                }
+                id = folder.parent;
+            }
+
+            // Null string marks bookmarks in tag folders
+            QString folder;
+            if (!isTag) {
+                folder = path.isEmpty() ? QString("Firefox Import") : path.join(QLatin1String("/"));
+            }
+            paths.insert(parent, folder);
+        }
+
+        const QString folder = paths.value(parent);
+        if (folder.isNull()) {
+            continue;
+        }
+
+        b.folder = folder;
+        list.append(b);
     }
 
     return list;
@@ -18,10 +18,14 @@
 #include "htmlimporter.h"
 #include "bookmarksimportdialog.h"
 
-#include <QRegExp>
+#include <QStack>
+
+#define CHUNK_SIZE 64 * 1024
 
 HtmlImporter::HtmlImporter(QObject* parent)
     : QObject(parent)
+    , m_pos(0)
+    , m_cancelled(0)
     , m_error(false)
     , m_errorString(BookmarksImportDialog::tr("No Error"))
 {
@@ -42,94 +46,278 @@ bool HtmlImporter::openFile()
         return false;
     }
 
+    m_stream.setDevice(&m_file);
+    m_stream.setCodec("UTF-8");
+
+    return true;
+}
+
+void HtmlImporter::cancel()
+{
+    m_cancelled = 1;
+}
+
+bool HtmlImporter::readChunk()
+{
+    if (m_stream.atEnd()) {
+        return false;
+    }
+
+    // Drop already parsed data, only unfinished tag is kept in buffer
+    m_buffer.remove(0, m_pos);
+    m_pos = 0;
+
+    m_buffer.append(m_stream.read(CHUNK_SIZE));
+
+    if (m_file.size() > 0) {
+        emit progress(int(m_file.pos() * 100 / m_file.size()));
+    }
+
     return true;
 }
 
-int qzMin(int a, int b)
+QString HtmlImporter::tagName(const QString &tag)
+{
+    int end = 0;
+    while (end < tag.size() && !tag.at(end).isSpace()) {
+        ++end;
+    }
+
+    return tag.left(end).toUpper();
+}
+
+QString HtmlImporter::tagAttribute(const QString &tag, const QString &attribute)
 {
-    if (a > -1 && b > -1) {
-        return qMin(a, b);
+    const QString search = attribute + QLatin1Char('=');
+
+    int pos = tag.indexOf(search, 0, Qt::CaseInsensitive);
+    while (pos > 0 && !tag.at(pos - 1).isSpace()) {
+        pos = tag.indexOf(search, pos + 1, Qt::CaseInsensitive);
+    }
+
+    if (pos == -1) {
+        return QString();
+    }
+
+    int start = pos + search.size();
+    if (start >= tag.size()) {
+        return QString();
     }
 
-    if (a > -1) {
-        return a;
+    const QChar quote = tag.at(start);
+    int end;
+
+    if (quote == QLatin1Char('"') || quote == QLatin1Char('\'')) {
+        ++start;
+        end = tag.indexOf(quote, start);
+        if (end == -1) {
+            end = tag.size();
+        }
     }
     else {
-        return b;
+        end = start;
+        while (end < tag.size() && !tag.at(end).isSpace()) {
+            ++end;
+        }
     }
+
+    return decodeEntities(tag.mid(start, end - start));
 }
 
-QList<BookmarksModel::Bookmark> HtmlImporter::exportBookmarks()
+QString HtmlImporter::decodeEntities(const QString &text)
 {
-    QList<BookmarksModel::Bookmark> list;
+    if (!text.contains(QLatin1Char('&'))) {
+        return text;
+    }
 
-    QString bookmarks = QString::fromUtf8(m_file.readAll());
-    m_file.close();
+    QString result;
+    result.reserve(text.size());
 
-    bookmarks = bookmarks.mid(0, bookmarks.lastIndexOf("</DL><p>"));
-    int start = bookmarks.indexOf("<DL><p>", Qt::CaseInsensitive);
+    int i = 0;
+    while (i < text.size()) {
+        const QChar c = text.at(i);
+        int semicolon;
 
-    QStringList folders("Html Import");
+        if (c != QLatin1Char('&') || (semicolon = text.indexOf(QLatin1Char(';'), i + 1)) == -1 || semicolon - i > 10) {
+            result.append(c);
+            ++i;
+            continue;
+        }
 
-    while (start > 0) {
-        QString string = bookmarks.mid(start);
+        const QString entity = text.mid(i + 1, semicolon - i - 1);
+        bool ok = true;
 
-        int posOfFolder = string.indexOf("<DT><H3", Qt::CaseInsensitive);
-        int posOfEndFolder = string.indexOf("</DL><p>", Qt::CaseInsensitive);
-        int posOfLink = string.indexOf("<DT><A", Qt::CaseInsensitive);
+        if (entity == QLatin1String("amp")) {
+            result.append(QLatin1Char('&'));
+        }
+        else if (entity == QLatin1String("lt")) {
+            result.append(QLatin1Char('<'));
+        }
+        else if (entity == QLatin1String("gt")) {
+            result.append(QLatin1Char('>'));
+        }
+        else if (entity == QLatin1String("quot")) {
+            result.append(QLatin1Char('"'));
+        }
+        else if (entity == QLatin1String("apos")) {
+            result.append(QLatin1Char('\''));
+        }
+        else if (entity == QLatin1String("nbsp")) {
+            result.append(QLatin1Char(' '));
+        }
+        else if (entity.startsWith(QLatin1Char('#'))) {
+            uint code = entity.startsWith(QLatin1String("#x"), Qt::CaseInsensitive)
+                        ? entity.mid(2).toUInt(&ok, 16)
+                        : entity.mid(1).toUInt(&ok, 10);
+            if (ok) {
+                if (code > 0xffff) {
+                    code -= 0x10000;
+                    result.append(QChar(ushort(0xd800 + (code >> 10))));
+                    result.append(QChar(ushort(0xdc00 + (code & 0x3ff))));
+                }
+                else {
+                    result.append(QChar(ushort(code)));
+                }
+            }
+        }
+        else {
+            ok = false;
+        }
 
-        int nearest = qzMin(posOfLink, qzMin(posOfFolder, posOfEndFolder));
-        if (nearest == -1) {
-            break;
+        if (ok) {
+            i = semicolon + 1;
         }
+        else {
+            result.append(c);
+            ++i;
+        }
+    }
+
+    return result;
+}
 
-        if (nearest == posOfFolder) {
-            // Next is folder
-            QRegExp rx("<DT><H3(.*)>(.*)</H3>", Qt::CaseInsensitive);
-            rx.setMinimal(true);
-            rx.indexIn(string);
+QList<BookmarksModel::Bookmark> HtmlImporter::exportBookmarks()
+{
+    QList<BookmarksModel::Bookmark> list;
+
+    enum State { None, InFolderTitle, InLink };
+    State state = None;
+
+    // Each <DL> pushes name of folder from preceding <H3>, root list pushes empty name
+    QStack<QString> folders;
+    QString folderPath;
+    QString pendingFolder;
 
-//            QString arguments = rx.cap(1);
-            QString folderName = rx.cap(2);
+    QString text;
+    QUrl linkUrl;
 
-            folders.append(folderName);
+    m_buffer.clear();
+    m_pos = 0;
+    readChunk();
 
-            start += posOfFolder + rx.cap(0).size();
+    while (!m_cancelled) {
+        int tagStart = m_buffer.indexOf(QLatin1Char('<'), m_pos);
+        if (tagStart == -1) {
+            if (state != None) {
+                text.append(m_buffer.midRef(m_pos));
+            }
+            m_pos = m_buffer.size();
+
+            if (!readChunk()) {
+                break;
+            }
+            continue;
         }
-        else if (nearest == posOfEndFolder) {
-            // Next is end of folder
-            folders.removeLast();
 
-            start += posOfEndFolder + 8;
+        if (state != None) {
+            text.append(m_buffer.midRef(m_pos, tagStart - m_pos));
+        }
+        m_pos = tagStart;
+
+        // Need at least "<!--" to recognize comments
+        if (m_buffer.size() - m_pos < 4 && readChunk()) {
+            continue;
         }
-        else {
-            // Next is link
-            QRegExp rx("<DT><A(.*)>(.*)</A>", Qt::CaseInsensitive);
-            rx.setMinimal(true);
-            rx.indexIn(string);
 
-            QString arguments = rx.cap(1);
-            QString linkName = rx.cap(2);
+        const bool isComment = m_buffer.midRef(m_pos, 4) == QLatin1String("<!--");
+        int tagEnd = isComment ? m_buffer.indexOf(QLatin1String("-->"), m_pos + 4)
+                     : m_buffer.indexOf(QLatin1Char('>'), m_pos);
 
-            QRegExp rx2("HREF=\"(.*)\"", Qt::CaseInsensitive);
-            rx2.setMinimal(true);
-            rx2.indexIn(arguments);
+        if (tagEnd == -1) {
+            // Unfinished tag at the end of buffer
+            if (!readChunk()) {
+                break;
+            }
+            continue;
+        }
+
+        if (isComment) {
+            m_pos = tagEnd + 3;
+            continue;
+        }
 
-            QUrl url = QUrl::fromEncoded(rx2.cap(1).toUtf8());
+        const QString tag = m_buffer.mid(m_pos + 1, tagEnd - m_pos - 1);
+        const QString name = tagName(tag);
+        m_pos = tagEnd + 1;
 
-            start += posOfLink + rx.cap(0).size();
+        if (name == QLatin1String("H3")) {
+            state = InFolderTitle;
+            text.clear();
+        }
+        else if (name == QLatin1String("/H3")) {
+            if (state == InFolderTitle) {
+                pendingFolder = decodeEntities(text.simplified());
+            }
+            state = None;
+        }
+        else if (name == QLatin1String("A")) {
+            state = InLink;
+            text.clear();
+            linkUrl = QUrl::fromEncoded(tagAttribute(tag, QLatin1String("HREF")).toUtf8());
+        }
+        else if (name == QLatin1String("/A")) {
+            if (state != InLink) {
+                continue;
+            }
+            state = None;
 
-            if (linkName.isEmpty() || url.isEmpty() || url.scheme() == "place" || url.scheme() == "about") {
+            const QString linkName = decodeEntities(text.simplified());
+            if (linkName.isEmpty() || linkUrl.isEmpty() || linkUrl.scheme() == QLatin1String("place") || linkUrl.scheme() == QLatin1String("about")) {
                 continue;
             }
 
             BookmarksModel::Bookmark b;
-            b.folder = folders.last();
+            b.folder = folderPath.isEmpty() ? QString("Html Import") : folderPath;
             b.title = linkName;
-            b.url = url;
+            b.url = linkUrl;
 
             list.append(b);
         }
+        else if (name == QLatin1String("DL") || name == QLatin1String("/DL")) {
+            if (name == QLatin1String("DL")) {
+                folders.push(pendingFolder);
+                pendingFolder.clear();
+            }
+            else if (!folders.isEmpty()) {
+                folders.pop();
+            }
+
+            // Nested folders are flattened into "Parent/Child" folder names
+            QStringList path;
+            foreach(const QString & folder, folders) {
+                if (!folder.isEmpty()) {
+                    path.append(folder);
+                }
+            }
+            folderPath = path.join(QLatin1String("/"));
+        }
+    }
+
+    m_file.close();
+    m_buffer.clear();
+
+    if (!m_cancelled) {
+        emit progress(100);
     }
 
     return list;
@@ -20,26 +20,49 @@
 
 #include <QObject>
 #include <QFile>
+#include <QTextStream>
+#include <QAtomicInt>
 
 #include "qz_namespace.h"
 #include "bookmarksmodel.h"
 
 class QT_QUPZILLA_EXPORT HtmlImporter : public QObject
 {
+    Q_OBJECT
+
 public:
     explicit HtmlImporter(QObject* parent = 0);
 
     void setFile(const QString &path);
     bool openFile();
 
+    // Single pass over the file, safe to run in worker thread
     QList<BookmarksModel::Bookmark> exportBookmarks();
 
     bool error() { return m_error; }
     QString errorString() { return m_errorString; }
 
+public slots:
+    void cancel();
+
+signals:
+    // Percentage of file parsed
+    void progress(int percent);
+
 private:
+    bool readChunk();
+
+    static QString tagName(const QString &tag);
+    static QString tagAttribute(const QString &tag, const QString &attribute);
+    static QString decodeEntities(const QString &text);
+
     QString m_path;
     QFile m_file;
+    QTextStream m_stream;
+
+    QString m_buffer;
+    int m_pos;
+    QAtomicInt m_cancelled;
 
     bool m_error;
     QString m_errorString;
@@ -0,0 +1,134 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "downloadchecksum.h"
+#include "sha256hash.h"
+
+#include <QCryptographicHash>
+#include <QRegExp>
+
+DownloadChecksum::DownloadChecksum(int algorithms)
+    : m_algorithms(algorithms)
+    , m_md5(0)
+    , m_sha1(0)
+    , m_sha256(0)
+{
+    if (m_algorithms & Md5) {
+        m_md5 = new QCryptographicHash(QCryptographicHash::Md5);
+    }
+    if (m_algorithms & Sha1) {
+        m_sha1 = new QCryptographicHash(QCryptographicHash::Sha1);
+    }
+    if (m_algorithms & Sha256) {
+        m_sha256 = new Sha256Hash();
+    }
+}
+
+void DownloadChecksum::addData(const char* data, int length)
+{
+    if (m_md5) {
+        m_md5->addData(data, length);
+    }
+    if (m_sha1) {
+        m_sha1->addData(data, length);
+    }
+    if (m_sha256) {
+        m_sha256->addData(data, length);
+    }
+}
+
+QMap<QString, QString> DownloadChecksum::results() const
+{
+    QMap<QString, QString> results;
+
+    if (m_md5) {
+        results[algorithmName(Md5)] = QString::fromLatin1(m_md5->result().toHex());
+    }
+    if (m_sha1) {
+        results[algorithmName(Sha1)] = QString::fromLatin1(m_sha1->result().toHex());
+    }
+    if (m_sha256) {
+        results[algorithmName(Sha256)] = QString::fromLatin1(m_sha256->result().toHex());
+    }
+
+    return results;
+}
+
+QString DownloadChecksum::algorithmName(Algorithm algorithm)
+{
+    switch (algorithm) {
+    case Md5:
+        return QLatin1String("MD5");
+    case Sha1:
+        return QLatin1String("SHA-1");
+    case Sha256:
+        return QLatin1String("SHA-256");
+    default:
+        return QString();
+    }
+}
+
+int DownloadChecksum::algorithmsFromNames(const QStringList &names)
+{
+    int algorithms = NoAlgorithm;
+
+    foreach(const QString & name, names) {
+        QString n = name.trimmed().toUpper().remove(QLatin1Char('-'));
+        if (n == QLatin1String("MD5")) {
+            algorithms |= Md5;
+        }
+        else if (n == QLatin1String("SHA1")) {
+            algorithms |= Sha1;
+        }
+        else if (n == QLatin1String("SHA256")) {
+            algorithms |= Sha256;
+        }
+    }
+
+    return algorithms;
+}
+
+DownloadChecksum::Algorithm DownloadChecksum::algorithmForChecksum(const QString &checksum)
+{
+    if (!isValidChecksum(checksum)) {
+        return NoAlgorithm;
+    }
+
+    switch (checksum.length()) {
+    case 32:
+        return Md5;
+    case 40:
+        return Sha1;
+    case 64:
+        return Sha256;
+    default:
+        return NoAlgorithm;
+    }
+}
+
+bool DownloadChecksum::isValidChecksum(const QString &checksum)
+{
+    QRegExp rx(QLatin1String("[0-9a-fA-F]{32}|[0-9a-fA-F]{40}|[0-9a-fA-F]{64}"));
+    return rx.exactMatch(checksum);
+}
+
+DownloadChecksum::~DownloadChecksum()
+{
+    delete m_md5;
+    delete m_sha1;
+    delete m_sha256;
+}
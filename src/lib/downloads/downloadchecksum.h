@@ -0,0 +1,62 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef DOWNLOADCHECKSUM_H
+#define DOWNLOADCHECKSUM_H
+
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+#include "qz_namespace.h"
+
+class QCryptographicHash;
+
+class Sha256Hash;
+
+// Digests of downloaded file computed incrementally while the file is written
+class QT_QUPZILLA_EXPORT DownloadChecksum
+{
+public:
+    enum Algorithm { NoAlgorithm = 0, Md5 = 1, Sha1 = 2, Sha256 = 4 };
+
+    explicit DownloadChecksum(int algorithms);
+    ~DownloadChecksum();
+
+    int algorithms() const { return m_algorithms; }
+
+    void addData(const char* data, int length);
+
+    // Algorithm name -> hex digest
+    QMap<QString, QString> results() const;
+
+    static QString algorithmName(Algorithm algorithm);
+    static int algorithmsFromNames(const QStringList &names);
+
+    // Algorithm is guessed from length of hex digest
+    static Algorithm algorithmForChecksum(const QString &checksum);
+    static bool isValidChecksum(const QString &checksum);
+
+private:
+    int m_algorithms;
+
+    QCryptographicHash* m_md5;
+    QCryptographicHash* m_sha1;
+    Sha256Hash* m_sha256;
+};
+
+#endif // DOWNLOADCHECKSUM_H
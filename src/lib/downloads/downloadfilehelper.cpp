@@ -33,6 +33,8 @@
 #include <QDebug>
 #include <QFileDialog>
 #include <QDesktopServices>
+#include <QWebFrame>
+#include <QWebElement>
 
 DownloadFileHelper::DownloadFileHelper(const QString &lastDownloadPath, const QString &downloadPath, bool useNativeDialog, WebPage* page)
     : QObject()
@@ -77,6 +79,8 @@ void DownloadFileHelper::handleUnsupportedContent(QNetworkReply* reply, bool ask
         mimeType.append(QString(" (%1)").arg(DownloadItem::fileSizeToString(size)));
     }
 
+    m_expectedChecksum = findChecksumOnPage(reply->url());
+
     // Close Empty Tab
     if (m_webPage) {
         WebView* view = qobject_cast<WebView*>(m_webPage->view());
@@ -226,6 +230,9 @@ void DownloadFileHelper::fileNameChoosed(const QString &name, bool fileNameAutoG
 
     QListWidgetItem* item = new QListWidgetItem(m_listWidget);
     DownloadItem* downItem = new DownloadItem(item, m_reply, m_path, m_fileName, m_fileIcon, m_timer, m_openFileChoosed, m_downloadPage, m_manager);
+    if (!m_expectedChecksum.isEmpty()) {
+        downItem->setExpectedChecksum(m_expectedChecksum);
+    }
 
     emit itemCreated(item, downItem);
 }
@@ -234,6 +241,51 @@ void DownloadFileHelper::fileNameChoosed(const QString &name, bool fileNameAutoG
 //// End here
 //////////////////////////////////////////////////////
 
+QString DownloadFileHelper::findChecksumOnPage(const QUrl &url)
+{
+    if (!m_webPage || !m_webPage->mainFrame()) {
+        return QString();
+    }
+
+    QWebFrame* frame = m_webPage->mainFrame();
+    QRegExp rx("\\b([0-9a-fA-F]{64}|[0-9a-fA-F]{40}|[0-9a-fA-F]{32})\\b");
+
+    foreach(const QWebElement & link, frame->findAllElements("a[href]")) {
+        QUrl linkUrl = frame->baseUrl().resolved(QUrl::fromEncoded(link.attribute("href").toUtf8()));
+        if (linkUrl != url) {
+            continue;
+        }
+
+        // Checksum is usually published in the same paragraph, list item or table row
+        // as the link. Search stops when more than one checksum is found to not pick
+        // checksum of other file.
+        QWebElement element = link.parent();
+        for (int level = 0; level < 3 && !element.isNull(); ++level) {
+            QString text = element.toPlainText();
+            QStringList checksums;
+
+            int pos = 0;
+            while ((pos = rx.indexIn(text, pos)) != -1) {
+                if (!checksums.contains(rx.cap(1).toLower())) {
+                    checksums.append(rx.cap(1).toLower());
+                }
+                pos += rx.matchedLength();
+            }
+
+            if (checksums.count() == 1) {
+                return checksums.first();
+            }
+            if (checksums.count() > 1) {
+                break;
+            }
+
+            element = element.parent();
+        }
+    }
+
+    return QString();
+}
+
 QString DownloadFileHelper::getFileName(QNetworkReply* reply)
 {
     QString path;
@@ -54,6 +54,7 @@ private slots:
 
 private:
     QString getFileName(QNetworkReply* reply);
+    QString findChecksumOnPage(const QUrl &url);
 
     DownloadManager::DownloadOption m_lastDownloadOption;
     QString m_lastDownloadPath;
@@ -68,6 +69,7 @@ private:
     QNetworkReply* m_reply;
     QPixmap m_fileIcon;
     QUrl m_downloadPage;
+    QString m_expectedChecksum;
     bool m_openFileChoosed;
 
     QListWidget* m_listWidget;
@@ -24,41 +24,150 @@
 #include "downloadmanager.h"
 #include "iconprovider.h"
 #include "networkmanager.h"
+#include "downloadsegment.h"
+#include "downloadwriter.h"
+#include "downloadchecksum.h"
 
 #include <QMenu>
 #include <QClipboard>
 #include <QListWidgetItem>
 #include <QMouseEvent>
 #include <QTimer>
+#include <QFile>
 #include <QFileInfo>
+#include <QFileIconProvider>
 #include <QMessageBox>
 #include <QDesktopServices>
+#include <QDataStream>
+#include <QInputDialog>
 
 //#define DOWNMANAGER_DEBUG
 
+// Smallest range downloaded by its own connection
+#define MINIMUM_SEGMENT_SIZE (1024 * 1024)
+// How many times can failed segment be restarted without receiving any data
+#define MAXIMUM_SEGMENT_RETRIES 5
+// Segments are paused when more data is waiting for writer thread
+#define MAXIMUM_QUEUED_SIZE (32 * 1024 * 1024)
+
+// Version of saved download state
+static const int downloadItemVersion = 0x0003;
+
 DownloadItem::DownloadItem(QListWidgetItem* item, QNetworkReply* reply, const QString &path, const QString &fileName, const QPixmap &fileIcon, QTime* timer, bool openAfterFinishedDownload, const QUrl &downloadPage, DownloadManager* manager)
     : QWidget()
     , ui(new Ui::DownloadItem)
     , m_item(item)
     , m_reply(reply)
+    , m_writer(0)
     , m_path(path)
     , m_fileName(fileName)
     , m_downTimer(timer)
     , m_downUrl(reply->url())
     , m_downloadPage(downloadPage)
+    , m_state(DownloadInProgress)
     , m_downloading(false)
     , m_openAfterFinish(openAfterFinishedDownload)
     , m_downloadStopped(false)
+    , m_segmentsInitialized(false)
+    , m_rangesSupported(false)
+    , m_rangesRejected(false)
+    , m_fileOpened(false)
+    , m_segmentsPaused(false)
+    , m_truncateFile(true)
+    , m_maxSegments(manager->maxDownloadSegments())
+    , m_segmentRetries(0)
+    , m_pendingCloses(0)
+    , m_checksumAlgorithms(manager->checksumAlgorithms())
+    , m_currSpeed(0)
+    , m_received(0)
+    , m_receivedAtStart(0)
+    , m_total(0)
 {
 #ifdef DOWNMANAGER_DEBUG
     qDebug() << __FUNCTION__ << item << reply << path << fileName;
 #endif
-    QString fullPath = path + fileName;
-    if (QFile::exists(fullPath)) {
-        QFile::remove(fullPath);
+    // Existing file is not removed here, it is truncated when first data arrives
+    init(fileIcon, manager, QList<Range>());
+
+    startDownloading();
+}
+
+DownloadItem::DownloadItem(QListWidgetItem* item, const QByteArray &state, DownloadManager* manager)
+    : QWidget()
+    , ui(new Ui::DownloadItem)
+    , m_item(item)
+    , m_reply(0)
+    , m_writer(0)
+    , m_downTimer(new QTime)
+    , m_state(DownloadCancelled)
+    , m_downloading(false)
+    , m_openAfterFinish(false)
+    , m_downloadStopped(true)
+    , m_segmentsInitialized(false)
+    , m_rangesSupported(false)
+    , m_rangesRejected(false)
+    , m_fileOpened(false)
+    , m_segmentsPaused(false)
+    , m_truncateFile(false)
+    , m_maxSegments(manager->maxDownloadSegments())
+    , m_segmentRetries(0)
+    , m_pendingCloses(0)
+    , m_checksumAlgorithms(manager->checksumAlgorithms())
+    , m_currSpeed(0)
+    , m_received(0)
+    , m_receivedAtStart(0)
+    , m_total(0)
+{
+    QDataStream stream(state);
+
+    int version;
+    int downloadState = DownloadCancelled;
+    QUrl requestUrl;
+    QString info;
+    QList<Range> writtenRanges;
+
+    stream >> version;
+    if (version == downloadItemVersion) {
+        stream >> m_downUrl >> requestUrl >> m_downloadPage >> m_path >> m_fileName >> downloadState
+               >> m_total >> m_etag >> m_lastModified >> m_rangesSupported >> info >> writtenRanges
+               >> m_checksums >> m_expectedChecksum;
+    }
+
+    m_state = static_cast<DownloadState>(downloadState);
+    m_request = QNetworkRequest(requestUrl.isEmpty() ? m_downUrl : requestUrl);
+
+    m_downTimer->start();
+
+    QFileIconProvider iconProvider;
+    init(iconProvider.icon(QFileInfo(m_path + m_fileName)).pixmap(30, 30), manager, writtenRanges);
+    m_received = m_writer->bytesWritten();
+
+    if (m_state == DownloadFinished) {
+        ui->downloadInfo->setText(info);
+        ui->progressBar->hide();
+        ui->button->hide();
+        ui->frame->hide();
+        return;
     }
 
-    m_outputFile.setFileName(fullPath);
+    // Download was running when browser was closed
+    if (m_state == DownloadInProgress) {
+        m_state = DownloadInterrupted;
+        info = tr("Interrupted - %1").arg(m_request.url().host());
+    }
+
+    updateProgress();
+    showStoppedState(info);
+}
+
+void DownloadItem::init(const QPixmap &fileIcon, DownloadManager* manager, const QList<Range> &writtenRanges)
+{
+    // File is written in download manager's writer thread
+    m_writer = new DownloadWriter(m_path + m_fileName, writtenRanges);
+    m_writer->moveToThread(manager->writerThread());
+    connect(m_writer, SIGNAL(dataWritten()), this, SLOT(writerDataWritten()));
+    connect(m_writer, SIGNAL(error(QString)), this, SLOT(downloadFailed(QString)));
+    connect(m_writer, SIGNAL(closed()), this, SLOT(writerClosed()));
 
     ui->setupUi(this);
     setMaximumWidth(525);
@@ -70,10 +179,23 @@ DownloadItem::DownloadItem(QListWidgetItem* item, QNetworkReply* reply, const QS
 
     setContextMenuPolicy(Qt::CustomContextMenu);
     connect(this, SIGNAL(customContextMenuRequested(QPoint)), this, SLOT(customContextMenuRequested(QPoint)));
-    connect(ui->button, SIGNAL(clicked(QPoint)), this, SLOT(stop()));
+    connect(ui->button, SIGNAL(clicked(QPoint)), this, SLOT(buttonClicked()));
     connect(manager, SIGNAL(resized(QSize)), this, SLOT(parentResized(QSize)));
+}
 
-    startDownloading();
+QByteArray DownloadItem::saveState()
+{
+    // Only ranges that were really written to disk are saved
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+
+    stream << downloadItemVersion;
+    stream << m_downUrl << m_request.url() << m_downloadPage << m_path << m_fileName << int(m_state)
+           << m_total << m_etag << m_lastModified << m_rangesSupported
+           << ui->downloadInfo->text() << m_writer->writtenRanges()
+           << m_checksums << m_expectedChecksum;
+
+    return data;
 }
 
 void DownloadItem::startDownloading()
@@ -86,24 +208,298 @@ void DownloadItem::startDownloading()
         m_reply = mApp->networkManager()->get(QNetworkRequest(locationHeader));
     }
 
-    m_reply->setParent(this);
-    connect(m_reply, SIGNAL(finished()), this, SLOT(finished()));
-    connect(m_reply, SIGNAL(readyRead()), this, SLOT(readyRead()));
-    connect(m_reply, SIGNAL(downloadProgress(qint64, qint64)), this, SLOT(downloadProgress(qint64, qint64)));
-    connect(m_reply, SIGNAL(error(QNetworkReply::NetworkError)), this, SLOT(error(QNetworkReply::NetworkError)));
+    // Clearing web page info from request, it will be used for range requests
+    m_request = m_reply->request();
+    m_request.setAttribute((QNetworkRequest::Attribute)(QNetworkRequest::User + 100), 0);
+    m_request.setAttribute((QNetworkRequest::Attribute)(QNetworkRequest::User + 101), 0);
+
+    m_reply->setProperty("downReply", true);
     connect(m_reply, SIGNAL(metaDataChanged()), this, SLOT(metaDataChanged()));
 
+    DownloadSegment* segment = new DownloadSegment(m_reply, 0, -1, false, this);
+    addSegment(segment);
+
+    m_downloading = true;
+    m_timer.start(1000, this);
+
+    if (!m_reply->rawHeaderList().isEmpty() || m_reply->isFinished()) {
+        initSegments();
+    }
+
+    segment->start();
+}
+
+void DownloadItem::resume()
+{
+    if (m_downloading || m_state == DownloadFinished) {
+        return;
+    }
+
+    QList<Range> ranges = DownloadWriter::missingRanges(m_writer->writtenRanges(), m_total);
+
+#ifdef DOWNMANAGER_DEBUG
+    qDebug() << __FUNCTION__ << ranges;
+#endif
+    m_state = DownloadInProgress;
     m_downloading = true;
+    m_downloadStopped = false;
+    m_segmentRetries = 0;
+    m_segmentsPaused = false;
+    m_fileOpened = false;
+    m_received = m_writer->bytesWritten();
+    m_receivedAtStart = m_received;
+    m_downTimer->start();
+
+    ui->button->setPixmap(IconProvider::standardIcon(QStyle::SP_BrowserStop).pixmap(20, 20));
+    ui->button->show();
+    ui->progressBar->show();
+    ui->downloadInfo->setText(tr("Remaining time unavailable"));
+    m_item->setSizeHint(sizeHint());
+
+    if (!m_rangesSupported || m_total <= 0 || !QFile::exists(m_path + m_fileName)) {
+        restart();
+        return;
+    }
+
+    m_segmentsInitialized = true;
     m_timer.start(1000, this);
-    readyRead();
-    QTimer::singleShot(200, this, SLOT(updateDownload()));
 
-    if (m_reply->error() != QNetworkReply::NoError) {
-        stop(false);
-        error(m_reply->error());
+    // Whole file was already written
+    if (ranges.isEmpty()) {
+        finishWriting();
+        return;
+    }
+
+    foreach(const Range & range, ranges) {
+        startSegment(range.first, range.second);
+    }
+}
+
+void DownloadItem::restart()
+{
+#ifdef DOWNMANAGER_DEBUG
+    qDebug() << __FUNCTION__;
+#endif
+    abortSegments();
+
+    m_received = 0;
+    m_receivedAtStart = 0;
+    m_total = 0;
+    m_segmentsInitialized = false;
+    m_rangesSupported = false;
+    m_segmentsPaused = false;
+    m_fileOpened = false;
+    m_truncateFile = true;
+    m_etag.clear();
+    m_lastModified.clear();
+    updateProgress();
+
+    m_reply = mApp->networkManager()->get(m_request);
+    startDownloading();
+}
+
+void DownloadItem::initSegments()
+{
+    if (m_segmentsInitialized || !m_reply || m_segments.isEmpty()) {
+        return;
+    }
+
+    m_segmentsInitialized = true;
+    disconnect(m_reply, SIGNAL(metaDataChanged()), this, SLOT(metaDataChanged()));
+
+    m_etag = m_reply->rawHeader("ETag");
+    m_lastModified = m_reply->rawHeader("Last-Modified");
+
+    // Content-Length of compressed content does not match size of received data
+    QByteArray encoding = m_reply->rawHeader("Content-Encoding").toLower();
+    if (!encoding.isEmpty() && encoding != "identity") {
+        return;
+    }
+
+    m_total = m_reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+    if (m_total <= 0) {
+        m_total = 0;
+        return;
+    }
+
+    DownloadSegment* first = m_segments.first();
+    first->setEndOffset(m_total);
+
+    int status = m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    m_rangesSupported = !m_rangesRejected && status == 200 && m_reply->rawHeader("Accept-Ranges").toLower() == "bytes";
+
+    qint64 start = first->position();
+    qint64 size = m_total - start;
+
+    if (!m_rangesSupported || m_maxSegments < 2 || size < 2 * MINIMUM_SEGMENT_SIZE) {
+        return;
+    }
+
+    // First segment continues in original reply, rest of the file is split
+    // into equal ranges, each downloaded by its own connection
+    int count = qMin<qint64>(m_maxSegments, size / MINIMUM_SEGMENT_SIZE);
+    qint64 segmentSize = size / count;
+
+    first->setEndOffset(start + segmentSize);
+
+    for (int i = 1; i < count; ++i) {
+        qint64 segmentStart = start + i * segmentSize;
+        qint64 segmentEnd = i == count - 1 ? m_total : segmentStart + segmentSize;
+
+        startSegment(segmentStart, segmentEnd);
+    }
+}
+
+QByteArray DownloadItem::rangeValidator()
+{
+    // Weak ETags cannot be used in If-Range
+    if (!m_etag.isEmpty() && !m_etag.startsWith("W/")) {
+        return m_etag;
+    }
+
+    return m_lastModified;
+}
+
+void DownloadItem::startSegment(qint64 start, qint64 end)
+{
+    QNetworkReply* reply = mApp->networkManager()->get(DownloadSegment::rangeRequest(m_request, start, end, rangeValidator()));
+    reply->setProperty("downReply", true);
+
+    DownloadSegment* segment = new DownloadSegment(reply, start, end, true, this);
+    segment->setExpectedSize(m_total);
+    addSegment(segment);
+
+    segment->start();
+}
+
+void DownloadItem::addSegment(DownloadSegment* segment)
+{
+    m_segments.append(segment);
+
+    connect(segment, SIGNAL(dataReceived(qint64, QByteArray)), this, SLOT(writeData(qint64, QByteArray)));
+    connect(segment, SIGNAL(finished(DownloadSegment*)), this, SLOT(segmentFinished(DownloadSegment*)));
+    connect(segment, SIGNAL(failed(DownloadSegment*, QString)), this, SLOT(segmentFailed(DownloadSegment*, QString)));
+    connect(segment, SIGNAL(rangeRejected(DownloadSegment*)), this, SLOT(segmentRangeRejected(DownloadSegment*)));
+}
+
+void DownloadItem::removeSegment(DownloadSegment* segment)
+{
+    if (segment->reply() == m_reply) {
+        m_reply = 0;
+    }
+
+    m_segments.removeOne(segment);
+    segment->deleteLater();
+}
+
+void DownloadItem::abortSegments()
+{
+    while (!m_segments.isEmpty()) {
+        DownloadSegment* segment = m_segments.first();
+        segment->abort();
+        removeSegment(segment);
+    }
+}
+
+void DownloadItem::setSegmentsPaused(bool paused)
+{
+    m_segmentsPaused = paused;
+
+    // Resumed segment can finish and be removed from the list
+    QList<DownloadSegment*> segments = m_segments;
+    foreach(DownloadSegment * segment, segments) {
+        segment->setPaused(paused);
+    }
+}
+
+bool DownloadItem::splitSlowestSegment()
+{
+    // Work stealing: connection that finished its range takes over
+    // second half of the range that has the most data left
+    DownloadSegment* slowest = 0;
+    foreach(DownloadSegment * segment, m_segments) {
+        if (segment->isFinished()) {
+            continue;
+        }
+        if (!slowest || segment->remaining() > slowest->remaining()) {
+            slowest = segment;
+        }
+    }
+
+    if (!slowest || slowest->remaining() < 2 * MINIMUM_SEGMENT_SIZE) {
+        return false;
+    }
+
+    qint64 end = slowest->endOffset();
+    qint64 middle = slowest->position() + slowest->remaining() / 2;
+
+    slowest->setEndOffset(middle);
+    startSegment(middle, end);
+
+    return true;
+}
+
+void DownloadItem::segmentFinished(DownloadSegment* segment)
+{
+#ifdef DOWNMANAGER_DEBUG
+    qDebug() << __FUNCTION__ << segment->startOffset() << segment->endOffset();
+#endif
+    removeSegment(segment);
+
+    if (!m_downloading) {
+        return;
+    }
+
+    if (m_rangesSupported && m_maxSegments > 1 && splitSlowestSegment()) {
+        return;
+    }
+
+    if (m_segments.isEmpty()) {
+        finishWriting();
     }
 }
 
+void DownloadItem::segmentFailed(DownloadSegment* segment, const QString &errorString)
+{
+#ifdef DOWNMANAGER_DEBUG
+    qDebug() << __FUNCTION__ << segment->position() << segment->endOffset() << errorString;
+#endif
+    qint64 position = segment->position();
+    qint64 end = segment->endOffset();
+
+    removeSegment(segment);
+
+    if (!m_downloading) {
+        return;
+    }
+
+    // Resume failed range with new connection
+    if (m_rangesSupported && end > position && m_segmentRetries < MAXIMUM_SEGMENT_RETRIES) {
+        ++m_segmentRetries;
+        startSegment(position, end);
+        return;
+    }
+
+    downloadFailed(errorString);
+}
+
+void DownloadItem::segmentRangeRejected(DownloadSegment* segment)
+{
+#ifdef DOWNMANAGER_DEBUG
+    qDebug() << __FUNCTION__ << segment->position() << segment->endOffset();
+#endif
+    removeSegment(segment);
+
+    if (!m_downloading) {
+        return;
+    }
+
+    // File was changed on server (or server does not really support ranges),
+    // already downloaded data cannot be used
+    m_rangesRejected = true;
+    restart();
+}
+
 void DownloadItem::parentResized(const QSize &size)
 {
     if (size.width() < 200) {
@@ -114,27 +510,65 @@ void DownloadItem::parentResized(const QSize &size)
 
 void DownloadItem::metaDataChanged()
 {
+    if (!m_reply) {
+        return;
+    }
+
     QUrl locationHeader = m_reply->header(QNetworkRequest::LocationHeader).toUrl();
     if (locationHeader.isValid()) {
-        m_reply->close();
-        m_reply->deleteLater();
+        DownloadSegment* segment = m_segments.takeFirst();
+        segment->abort();
+        segment->deleteLater();
 
         m_reply = mApp->networkManager()->get(QNetworkRequest(locationHeader));
         startDownloading();
+        return;
+    }
+
+    initSegments();
+}
+
+void DownloadItem::finishWriting()
+{
+    // Download is finished after all data were written to disk
+    ++m_pendingCloses;
+    QMetaObject::invokeMethod(m_writer, "close", Qt::QueuedConnection);
+}
+
+void DownloadItem::writerClosed()
+{
+    --m_pendingCloses;
+
+    if (m_pendingCloses == 0 && m_downloading && m_segments.isEmpty()) {
+        finished();
+    }
+}
+
+void DownloadItem::writerDataWritten()
+{
+    if (m_segmentsPaused && m_writer->bytesQueued() < MAXIMUM_QUEUED_SIZE / 2) {
+        setSegmentsPaused(false);
     }
 }
 
 void DownloadItem::finished()
 {
 #ifdef DOWNMANAGER_DEBUG
-    qDebug() << __FUNCTION__ << m_reply;
+    qDebug() << __FUNCTION__ << m_received << m_total;
 #endif
+    qint64 expected = m_total > 0 ? m_total : m_received;
+    if (m_writer->bytesWritten() != expected) {
+        downloadFailed(tr("Downloaded file is incomplete!"));
+        return;
+    }
+
+    m_state = DownloadFinished;
     m_timer.stop();
-    ui->downloadInfo->setText(tr("Done - %1").arg(m_reply->url().host()));
+    m_checksums = m_writer->checksums();
+    updateFinishedInfo();
     ui->progressBar->hide();
     ui->button->hide();
     ui->frame->hide();
-    m_outputFile.close();
 
     m_item->setSizeHint(sizeHint());
 #if QT_VERSION == 0x040700 // Workaround
@@ -150,28 +584,67 @@ void DownloadItem::finished()
     emit downloadFinished(true);
 }
 
-void DownloadItem::downloadProgress(qint64 received, qint64 total)
+void DownloadItem::downloadFailed(const QString &errorString)
 {
 #ifdef DOWNMANAGER_DEBUG
-    qDebug() << __FUNCTION__ << received << total;
+    qDebug() << __FUNCTION__ << errorString;
 #endif
+    if (!m_downloading) {
+        return;
+    }
+
+    // Data written so far are kept, so the download can be resumed later
+    abortSegments();
+    finishWriting();
+
+    m_state = DownloadFailed;
+    m_openAfterFinish = false;
+    m_timer.stop();
+    m_downloading = false;
+
+    showStoppedState(tr("Error: ") + errorString);
+
+    emit downloadFinished(false);
+}
+
+void DownloadItem::showStoppedState(const QString &info)
+{
+    // Stopped download can be resumed by clicking on the button
+    ui->downloadInfo->setText(info);
+    ui->button->setPixmap(IconProvider::standardIcon(QStyle::SP_BrowserReload).pixmap(20, 20));
+    ui->button->show();
+    ui->progressBar->setVisible(m_total > 0 && m_received > 0);
+    m_item->setSizeHint(sizeHint());
+}
+
+void DownloadItem::buttonClicked()
+{
+    if (m_downloading) {
+        stop();
+    }
+    else {
+        resume();
+    }
+}
+
+void DownloadItem::updateProgress()
+{
     qint64 currentValue = 0;
     qint64 totalValue = 0;
-    if (total > 0) {
-        currentValue = received * 100 / total;
+    if (m_total > 0) {
+        currentValue = qMin(m_received, m_total) * 100 / m_total;
         totalValue = 100;
     }
     ui->progressBar->setValue(currentValue);
     ui->progressBar->setMaximum(totalValue);
-    m_currSpeed = received * 1000.0 / m_downTimer->elapsed();
-    m_received = received;
-    m_total = total;
+    m_currSpeed = (m_received - m_receivedAtStart) * 1000.0 / qMax(1, m_downTimer->elapsed());
 }
 
 void DownloadItem::timerEvent(QTimerEvent* event)
 {
     if (event->timerId() == m_timer.timerId()) {
-        updateDownloadInfo(m_currSpeed, m_received, m_total);
+        updateProgress();
+        updateDownloadInfo(m_currSpeed, m_received, m_total > 0 ? m_total : -1);
     }
     else {
         QWidget::timerEvent(event);
@@ -183,11 +656,6 @@ int DownloadItem::progress()
     return ui->progressBar->value();
 }
 
-bool DownloadItem::isCancelled()
-{
-    return ui->downloadInfo->text().startsWith(tr("Cancelled"));
-}
-
 QString DownloadItem::remaingTimeToString(QTime time)
 {
     if (time < QTime(0, 0, 10)) {
@@ -266,6 +734,10 @@ void DownloadItem::updateDownloadInfo(double currSpeed, qint64 received, qint64
     QString currSize = fileSizeToString(received);
     QString fileSize = fileSizeToString(total);
 
+    if (m_segments.count() > 1) {
+        speed = tr("%1, %2 connections").arg(speed, QString::number(m_segments.count()));
+    }
+
     if (fileSize == tr("Unknown size")) {
         ui->downloadInfo->setText(tr("%2 - unknown size (%3)").arg(currSize, speed));
     }
@@ -280,25 +752,18 @@ void DownloadItem::stop(bool askForDeleteFile)
     qDebug() << __FUNCTION__;
 #endif
 
-    if (m_downloadStopped) {
+    if (m_downloadStopped || !m_downloading) {
         return;
     }
     m_downloadStopped = true;
 
+    // Data written so far are kept, so the download can be resumed later
+    abortSegments();
+    finishWriting();
+
+    m_state = DownloadCancelled;
     m_openAfterFinish = false;
     m_timer.stop();
-    m_reply->abort();
-    QString outputfile = QFileInfo(m_outputFile).absoluteFilePath();
-    m_outputFile.close();
-    ui->downloadInfo->setText(tr("Cancelled - %1").arg(m_reply->url().host()));
-    ui->progressBar->hide();
-    ui->button->hide();
-    m_item->setSizeHint(sizeHint());
-
-#if QT_VERSION == 0x040700 // Workaround
-    ui->button->show();
-    ui->button->hide();
-#endif
     m_downloading = false;
 
     emit downloadFinished(false);
@@ -306,9 +771,14 @@ void DownloadItem::stop(bool askForDeleteFile)
     if (askForDeleteFile) {
         QMessageBox::StandardButton button = QMessageBox::question(m_item->listWidget()->parentWidget(), tr("Delete file"), tr("Do you want to also delete dowloaded file?"), QMessageBox::Yes | QMessageBox::No);
         if (button == QMessageBox::Yes) {
-            QFile::remove(outputfile);
+            QMetaObject::invokeMethod(m_writer, "remove", Qt::BlockingQueuedConnection);
+
+            m_received = 0;
+            updateProgress();
         }
     }
+
+    showStoppedState(tr("Cancelled - %1").arg(m_request.url().host()));
 }
 
 void DownloadItem::mouseDoubleClickEvent(QMouseEvent* e)
@@ -320,19 +790,30 @@ void DownloadItem::mouseDoubleClickEvent(QMouseEvent* e)
 void DownloadItem::customContextMenuRequested(const QPoint &pos)
 {
     QMenu menu;
-    menu.addAction(QIcon::fromTheme("document-open"), tr("Open File"), this, SLOT(openFile()));
+    menu.addAction(QIcon::fromTheme("document-open"), tr("Open File"), this, SLOT(openFile()))->setEnabled(m_state == DownloadFinished);
 
     menu.addAction(tr("Open Folder"), this, SLOT(openFolder()));
     menu.addSeparator();
     menu.addAction(tr("Go to Download Page"), this, SLOT(goToDownloadPage()))->setEnabled(!m_downloadPage.isEmpty());
     menu.addAction(QIcon::fromTheme("edit-copy"), tr("Copy Download Link"), this, SLOT(copyDownloadLink()));
+
+    QMenu* checksumsMenu = menu.addMenu(tr("Checksums"));
+    QMapIterator<QString, QString> it(m_checksums);
+    while (it.hasNext()) {
+        it.next();
+        QAction* act = checksumsMenu->addAction(QIcon::fromTheme("edit-copy"), QString("%1: %2").arg(it.key(), it.value()), this, SLOT(copyChecksum()));
+        act->setData(it.value());
+    }
+    if (!m_checksums.isEmpty()) {
+        checksumsMenu->addSeparator();
+    }
+    checksumsMenu->addAction(tr("Verify Checksum..."), this, SLOT(verifyChecksum()));
+
     menu.addSeparator();
     menu.addAction(IconProvider::standardIcon(QStyle::SP_BrowserStop), tr("Cancel downloading"), this, SLOT(stop()))->setEnabled(m_downloading);
+    menu.addAction(IconProvider::standardIcon(QStyle::SP_BrowserReload), tr("Resume downloading"), this, SLOT(resume()))->setEnabled(!m_downloading && m_state != DownloadFinished);
     menu.addAction(QIcon::fromTheme("list-remove"), tr("Clear"), this, SLOT(clear()))->setEnabled(!m_downloading);
 
-    if (m_downloading || ui->downloadInfo->text().startsWith(tr("Cancelled")) || ui->downloadInfo->text().startsWith(tr("Error"))) {
-        menu.actions().at(0)->setEnabled(false);
-    }
     menu.exec(mapToGlobal(pos));
 }
 
@@ -353,6 +834,88 @@ void DownloadItem::copyDownloadLink()
     QApplication::clipboard()->setText(m_downUrl.toString());
 }
 
+void DownloadItem::copyChecksum()
+{
+    if (QAction* action = qobject_cast<QAction*>(sender())) {
+        QApplication::clipboard()->setText(action->data().toString());
+    }
+}
+
+void DownloadItem::verifyChecksum()
+{
+    QString clipboard = QApplication::clipboard()->text().trimmed();
+    QString checksum = DownloadChecksum::isValidChecksum(clipboard) ? clipboard : m_expectedChecksum;
+
+    bool ok;
+    checksum = QInputDialog::getText(this, tr("Verify Checksum"), tr("Published MD5, SHA-1 or SHA-256 checksum of the file:"),
+                                     QLineEdit::Normal, checksum, &ok).trimmed();
+    if (!ok || checksum.isEmpty()) {
+        return;
+    }
+
+    if (!DownloadChecksum::isValidChecksum(checksum)) {
+        QMessageBox::warning(this, tr("Verify Checksum"), tr("This is not valid MD5, SHA-1 or SHA-256 checksum."));
+        return;
+    }
+
+    setExpectedChecksum(checksum);
+
+    if (m_state == DownloadFinished) {
+        QMessageBox::information(this, tr("Verify Checksum"), checksumStatus());
+    }
+}
+
+void DownloadItem::setExpectedChecksum(const QString &checksum)
+{
+    m_expectedChecksum = checksum.toLower();
+
+    int algorithm = DownloadChecksum::algorithmForChecksum(m_expectedChecksum);
+    if (m_state == DownloadFinished) {
+        updateFinishedInfo();
+        return;
+    }
+
+    if (algorithm == DownloadChecksum::NoAlgorithm || m_checksumAlgorithms & algorithm) {
+        return;
+    }
+
+    // Writer computes new checksum from data already written and continues with the rest
+    m_checksumAlgorithms |= algorithm;
+    if (m_fileOpened) {
+        QMetaObject::invokeMethod(m_writer, "open", Qt::QueuedConnection, Q_ARG(bool, false), Q_ARG(qint64, m_total), Q_ARG(int, m_checksumAlgorithms));
+    }
+}
+
+QString DownloadItem::checksumStatus()
+{
+    if (m_expectedChecksum.isEmpty()) {
+        return QString();
+    }
+
+    QString name = DownloadChecksum::algorithmName(DownloadChecksum::algorithmForChecksum(m_expectedChecksum));
+    if (!m_checksums.contains(name)) {
+        return tr("%1 checksum was not calculated").arg(name);
+    }
+
+    if (m_checksums.value(name) == m_expectedChecksum) {
+        return tr("%1 checksum verified").arg(name);
+    }
+
+    return tr("%1 checksum does not match!").arg(name);
+}
+
+void DownloadItem::updateFinishedInfo()
+{
+    QString info = tr("Done - %1").arg(m_request.url().host());
+
+    QString status = checksumStatus();
+    if (!status.isEmpty()) {
+        info.append(QString(" (%1)").arg(status));
+    }
+
+    ui->downloadInfo->setText(info);
+}
+
 void DownloadItem::clear()
 {
     emit deleteItem(this);
@@ -377,42 +940,39 @@ void DownloadItem::openFolder()
     QDesktopServices::openUrl(QUrl::fromLocalFile(m_path));
 }
 
-void DownloadItem::readyRead()
+void DownloadItem::writeData(qint64 offset, const QByteArray &data)
 {
-#ifdef DOWNMANAGER_DEBUG
-    qDebug() << __FUNCTION__ ;
-#endif
-    if (!m_outputFile.isOpen() && !m_outputFile.open(QIODevice::WriteOnly)) {
-        stop(false);
-        ui->downloadInfo->setText(tr("Error: Cannot write to file!"));
+    if (!m_downloading) {
         return;
     }
-    m_outputFile.write(m_reply->readAll());
-}
 
-void DownloadItem::error(QNetworkReply::NetworkError error)
-{
-#ifdef DOWNMANAGER_DEBUG
-    qDebug() << __FUNCTION__ << error;
-#endif
-    if (error != QNetworkReply::NoError) {
-        ui->downloadInfo->setText(tr("Error: ") + m_reply->errorString());
+    if (!m_fileOpened) {
+        m_fileOpened = true;
+        QMetaObject::invokeMethod(m_writer, "open", Qt::QueuedConnection, Q_ARG(bool, m_truncateFile), Q_ARG(qint64, m_total), Q_ARG(int, m_checksumAlgorithms));
+        m_truncateFile = false;
+    }
+
+    m_writer->write(offset, data);
+
+    // Connection is working again
+    m_segmentRetries = 0;
+    m_received += data.size();
+
+    // Disk is slower than network, stop reading until writer catches up
+    if (!m_segmentsPaused && m_writer->bytesQueued() > MAXIMUM_QUEUED_SIZE) {
+        setSegmentsPaused(true);
     }
 }
 
-void DownloadItem::updateDownload()
+void DownloadItem::flushData()
 {
-#ifdef DOWNMANAGER_DEBUG
-    qDebug() << __FUNCTION__ ;
-#endif
-    if (ui->progressBar->maximum() == 0 && m_outputFile.isOpen() && m_reply->isFinished()) {
-        downloadProgress(0, 0);
-        finished();
-    }
+    QMetaObject::invokeMethod(m_writer, "flush", Qt::BlockingQueuedConnection);
 }
 
 DownloadItem::~DownloadItem()
 {
+    m_writer->deleteLater();
+
     delete ui;
     delete m_item;
     delete m_downTimer;
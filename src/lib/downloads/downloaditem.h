@@ -19,11 +19,12 @@
 #define DOWNLOADITEM_H
 
 #include <QWidget>
-#include <QFile>
 #include <QBasicTimer>
 #include <QUrl>
 #include <QNetworkReply>
 #include <QTime>
+#include <QPair>
+#include <QMap>
 
 #include "qz_namespace.h"
 
@@ -35,20 +36,33 @@ class DownloadItem;
 class QListWidgetItem;
 
 class DownloadManager;
+class DownloadSegment;
+class DownloadWriter;
 
 class QT_QUPZILLA_EXPORT DownloadItem : public QWidget
 {
     Q_OBJECT
 
 public:
+    enum DownloadState { DownloadInProgress, DownloadFinished, DownloadCancelled, DownloadFailed, DownloadInterrupted };
+
     explicit DownloadItem(QListWidgetItem* item, QNetworkReply* reply, const QString &path, const QString &fileName, const QPixmap &fileIcon, QTime* timer, bool openAfterFinishedDownload, const QUrl &downloadPage, DownloadManager* manager);
+    explicit DownloadItem(QListWidgetItem* item, const QByteArray &state, DownloadManager* manager);
     bool isDownloading() { return m_downloading; }
-    bool isCancelled();
+    bool isCancelled() { return m_state == DownloadCancelled; }
+    bool isInterrupted() { return m_state == DownloadInterrupted; }
     QTime remainingTime() { return m_remTime; }
     double currentSpeed() { return m_currSpeed; }
     int progress();
     ~DownloadItem();
 
+    QByteArray saveState();
+
+    // Checksum published on download page, it is verified when download finishes
+    void setExpectedChecksum(const QString &checksum);
+    // Blocks until all received data are written to disk
+    void flushData();
+
     static QString remaingTimeToString(QTime time);
     static QString currentSpeedToString(double speed);
     static QString fileSizeToString(qint64 size);
@@ -57,25 +71,51 @@ signals:
     void deleteItem(DownloadItem*);
     void downloadFinished(bool success);
 
+public slots:
+    void resume();
+
 private slots:
     void parentResized(const QSize &size);
     void finished();
     void metaDataChanged();
-    void downloadProgress(qint64 received, qint64 total);
     void stop(bool askForDeleteFile = true);
+    void buttonClicked();
     void openFile();
     void openFolder();
-    void readyRead();
-    void error(QNetworkReply::NetworkError);
-    void updateDownload();
+    void writeData(qint64 offset, const QByteArray &data);
+    void segmentFinished(DownloadSegment* segment);
+    void segmentFailed(DownloadSegment* segment, const QString &errorString);
+    void segmentRangeRejected(DownloadSegment* segment);
+    void writerDataWritten();
+    void writerClosed();
+    void downloadFailed(const QString &errorString);
     void customContextMenuRequested(const QPoint &pos);
     void clear();
 
     void goToDownloadPage();
     void copyDownloadLink();
+    void copyChecksum();
+    void verifyChecksum();
 
 private:
+    typedef QPair<qint64, qint64> Range;
+
+    void init(const QPixmap &fileIcon, DownloadManager* manager, const QList<Range> &writtenRanges);
     void startDownloading();
+    void restart();
+    void initSegments();
+    void startSegment(qint64 start, qint64 end);
+    void addSegment(DownloadSegment* segment);
+    bool splitSlowestSegment();
+    void removeSegment(DownloadSegment* segment);
+    void abortSegments();
+    void setSegmentsPaused(bool paused);
+    QByteArray rangeValidator();
+    void finishWriting();
+    QString checksumStatus();
+    void updateFinishedInfo();
+    void showStoppedState(const QString &info);
+    void updateProgress();
 
     void timerEvent(QTimerEvent* event);
     void updateDownloadInfo(double currSpeed, qint64 received, qint64 total);
@@ -84,20 +124,42 @@ private:
 
     QListWidgetItem* m_item;
     QNetworkReply* m_reply;
+    QNetworkRequest m_request;
+    QList<DownloadSegment*> m_segments;
+    DownloadWriter* m_writer;
     QString m_path;
     QString m_fileName;
     QTime* m_downTimer;
     QTime m_remTime;
     QBasicTimer m_timer;
-    QFile m_outputFile;
     QUrl m_downUrl;
     QUrl m_downloadPage;
 
+    // Validators used to check that partially downloaded file was not changed on server
+    QByteArray m_etag;
+    QByteArray m_lastModified;
+
+    // Algorithm name -> hex digest
+    QMap<QString, QString> m_checksums;
+    QString m_expectedChecksum;
+
+    DownloadState m_state;
     bool m_downloading;
     bool m_openAfterFinish;
     bool m_downloadStopped;
+    bool m_segmentsInitialized;
+    bool m_rangesSupported;
+    bool m_rangesRejected;
+    bool m_fileOpened;
+    bool m_segmentsPaused;
+    bool m_truncateFile;
+    int m_maxSegments;
+    int m_segmentRetries;
+    int m_pendingCloses;
+    int m_checksumAlgorithms;
     double m_currSpeed;
     qint64 m_received;
+    qint64 m_receivedAtStart;
     qint64 m_total;
 };
 
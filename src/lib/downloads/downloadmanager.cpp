@@ -29,11 +29,15 @@
 #include "webpage.h"
 #include "downloadfilehelper.h"
 #include "settings.h"
+#include "downloadchecksum.h"
 
 #include <QCloseEvent>
 #include <QDir>
 #include <QProcess>
 #include <QMessageBox>
+#include <QWebSettings>
+#include <QThread>
+#include <QDataStream>
 
 #ifdef Q_WS_WIN
 #define DEFAULT_USE_NATIVE_DIALOG false
@@ -41,6 +45,9 @@
 #define DEFAULT_USE_NATIVE_DIALOG true
 #endif
 
+// Version of downloads.dat file
+static const int downloadsVersion = 0x0001;
+
 DownloadManager::DownloadManager(QWidget* parent)
     : QWidget(parent)
     , ui(new Ui::DownloadManager)
@@ -58,6 +65,10 @@ DownloadManager::DownloadManager(QWidget* parent)
 
     m_networkManager = mApp->networkManager();
 
+    // Downloaded data are written to disk in separate thread
+    m_writerThread = new QThread(this);
+    m_writerThread->start();
+
     connect(ui->clearButton, SIGNAL(clicked()), this, SLOT(clearList()));
 
     loadSettings();
@@ -67,6 +78,8 @@ DownloadManager::DownloadManager(QWidget* parent)
         win7.init(this->winId());
     }
 #endif
+
+    restoreDownloads();
 }
 
 void DownloadManager::loadSettings()
@@ -77,6 +90,8 @@ void DownloadManager::loadSettings()
     m_lastDownloadPath = settings.value("lastDownloadPath", QDir::homePath() + "/").toString();
     m_closeOnFinish = settings.value("CloseManagerOnFinish", false).toBool();
     m_useNativeDialog = settings.value("useNativeDialog", DEFAULT_USE_NATIVE_DIALOG).toBool();
+    m_maxSegments = qBound(1, settings.value("MaximumSegments", 4).toInt(), 16);
+    m_checksumAlgorithms = DownloadChecksum::algorithmsFromNames(settings.value("Checksums", QStringList() << "SHA-256").toStringList());
 
     m_useExternalManager = settings.value("UseExternalManager", false).toBool();
     m_externalExecutable = settings.value("ExternalManagerExecutable", "").toString();
@@ -87,10 +102,102 @@ void DownloadManager::loadSettings()
 void DownloadManager::show()
 {
     m_timer.start(1000 * 2, this);
+    m_saveTimer.start(1000 * 10, this);
 
     QWidget::show();
 }
 
+void DownloadManager::saveDownloads()
+{
+    if (mApp->webSettings()->testAttribute(QWebSettings::PrivateBrowsingEnabled)) {
+        return;
+    }
+
+    QList<QByteArray> items;
+    bool isDownloading = false;
+
+    for (int i = 0; i < ui->list->count(); i++) {
+        DownloadItem* downItem = qobject_cast<DownloadItem*>(ui->list->itemWidget(ui->list->item(i)));
+        if (!downItem) {
+            continue;
+        }
+        if (downItem->isDownloading()) {
+            isDownloading = true;
+
+            // Write all buffered data before quitting, so they don't need to be downloaded again
+            if (mApp->isClosing()) {
+                downItem->flushData();
+            }
+        }
+        items.append(downItem->saveState());
+    }
+
+    QFile file(mApp->getActiveProfilPath() + "downloads.dat");
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "DownloadManager::saveDownloads cannot write to" << file.fileName();
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream << downloadsVersion;
+    stream << items;
+    file.close();
+
+    // Download manager will be created on next start to resume unfinished downloads
+    Settings settings;
+    settings.beginGroup("DownloadManager");
+    settings.setValue("ResumeDownloads", isDownloading);
+    settings.endGroup();
+}
+
+void DownloadManager::restoreDownloads()
+{
+    QFile file(mApp->getActiveProfilPath() + "downloads.dat");
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    QDataStream stream(&file);
+
+    int version;
+    QList<QByteArray> items;
+
+    stream >> version;
+    if (version != downloadsVersion) {
+        return;
+    }
+    stream >> items;
+    file.close();
+
+    QList<DownloadItem*> interrupted;
+
+    foreach(const QByteArray & data, items) {
+        QListWidgetItem* item = new QListWidgetItem(ui->list);
+        DownloadItem* downItem = new DownloadItem(item, data, this);
+
+        connect(downItem, SIGNAL(deleteItem(DownloadItem*)), this, SLOT(deleteItem(DownloadItem*)));
+        connect(downItem, SIGNAL(downloadFinished(bool)), this, SLOT(downloadFinished(bool)));
+
+        ui->list->setItemWidget(item, downItem);
+        item->setSizeHint(downItem->sizeHint());
+
+        if (downItem->isInterrupted()) {
+            interrupted.append(downItem);
+        }
+    }
+
+    if (interrupted.isEmpty()) {
+        return;
+    }
+
+    // Downloads that were running when browser was closed are resumed
+    foreach(DownloadItem * downItem, interrupted) {
+        downItem->resume();
+    }
+
+    show();
+}
+
 void DownloadManager::resizeEvent(QResizeEvent* e)
 {
     QWidget::resizeEvent(e);
@@ -169,6 +276,12 @@ void DownloadManager::timerEvent(QTimerEvent* event)
         }
 #endif
     }
+    else if (event->timerId() == m_saveTimer.timerId()) {
+        // Progress of running downloads is saved, so they can be resumed after crash
+        if (!canClose()) {
+            saveDownloads();
+        }
+    }
     else {
         QWidget::timerEvent(event);
     }
@@ -188,6 +301,8 @@ void DownloadManager::clearList()
         items.append(downItem);
     }
     qDeleteAll(items);
+
+    saveDownloads();
 }
 
 void DownloadManager::download(const QNetworkRequest &request, WebPage* page, bool askWhatToDo)
@@ -237,6 +352,8 @@ void DownloadManager::itemCreated(QListWidgetItem* item, DownloadItem* downItem)
     item->setSizeHint(downItem->sizeHint());
     downItem->show();
 
+    saveDownloads();
+
     show();
     raise();
     activateWindow();
@@ -244,6 +361,10 @@ void DownloadManager::itemCreated(QListWidgetItem* item, DownloadItem* downItem)
 
 void DownloadManager::downloadFinished(bool success)
 {
+    if (!m_isClosing) {
+        saveDownloads();
+    }
+
     bool downloadingAllFilesFinished = true;
     for (int i = 0; i < ui->list->count(); i++) {
         DownloadItem* downItem = qobject_cast<DownloadItem*>(ui->list->itemWidget(ui->list->item(i)));
@@ -279,6 +400,8 @@ void DownloadManager::deleteItem(DownloadItem* item)
 {
     if (item && !item->isDownloading()) {
         delete item;
+
+        saveDownloads();
     }
 }
 
@@ -308,7 +431,7 @@ void DownloadManager::closeEvent(QCloseEvent* e)
     if (mApp->windowCount() == 0) { // No main windows -> we are going to quit
         if (!canClose()) {
             QMessageBox::StandardButton button = QMessageBox::warning(this, tr("Warning"),
-                                                 tr("Are you sure to quit? All uncompleted downloads will be cancelled!"), QMessageBox::Yes | QMessageBox::No);
+                                                 tr("Are you sure to quit? All uncompleted downloads will be paused and resumed on next start."), QMessageBox::Yes | QMessageBox::No);
             if (button != QMessageBox::Yes) {
                 e->ignore();
                 return;
@@ -322,5 +445,14 @@ void DownloadManager::closeEvent(QCloseEvent* e)
 
 DownloadManager::~DownloadManager()
 {
+    // Writers of items live in writer thread, their deleteLater() has to be
+    // posted before the thread is stopped (pending deletes run when it finishes)
+    for (int i = ui->list->count() - 1; i >= 0; --i) {
+        delete ui->list->itemWidget(ui->list->item(i));
+    }
+
+    m_writerThread->quit();
+    m_writerThread->wait();
+
     delete ui;
 }
@@ -32,6 +32,7 @@ class QNetworkReply;
 class QNetworkRequest;
 class QListWidgetItem;
 class QUrl;
+class QThread;
 
 class DownloadItem;
 class EcWin7;
@@ -54,6 +55,11 @@ public:
     bool canClose();
     void setLastDownloadPath(const QString &lastPath) { m_lastDownloadPath = lastPath; }
     void setLastDownloadOption(const DownloadOption &option) { m_lastDownloadOption = option; }
+    int maxDownloadSegments() const { return m_maxSegments; }
+    QThread* writerThread() const { return m_writerThread; }
+    int checksumAlgorithms() const { return m_checksumAlgorithms; }
+
+    void saveDownloads();
 
 public slots:
     void show();
@@ -82,16 +88,21 @@ private:
     void resizeEvent(QResizeEvent* e);
 
     void startExternalManager(const QUrl &url);
+    void restoreDownloads();
 
     Ui::DownloadManager* ui;
     NetworkManager* m_networkManager;
+    QThread* m_writerThread;
     QBasicTimer m_timer;
+    QBasicTimer m_saveTimer;
 
     QString m_lastDownloadPath;
     QString m_downloadPath;
     bool m_useNativeDialog;
     bool m_isClosing;
     bool m_closeOnFinish;
+    int m_maxSegments;
+    int m_checksumAlgorithms;
 
     bool m_useExternalManager;
     QString m_externalExecutable;
@@ -0,0 +1,250 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "downloadsegment.h"
+
+#include <QNetworkRequest>
+
+// Maximum size of data buffered in reply while segment is paused
+#define READ_BUFFER_SIZE (1024 * 1024)
+
+DownloadSegment::DownloadSegment(QNetworkReply* reply, qint64 start, qint64 end, bool ranged, QObject* parent)
+    : QObject(parent)
+    , m_reply(reply)
+    , m_start(start)
+    , m_position(start)
+    , m_end(end)
+    , m_expectedSize(0)
+    , m_ranged(ranged)
+    , m_rangeChecked(false)
+    , m_finished(false)
+    , m_paused(false)
+    , m_finishPending(false)
+{
+    m_reply->setParent(this);
+}
+
+void DownloadSegment::start()
+{
+    m_reply->setReadBufferSize(READ_BUFFER_SIZE);
+
+    connect(m_reply, SIGNAL(readyRead()), this, SLOT(readyRead()));
+    connect(m_reply, SIGNAL(finished()), this, SLOT(replyFinished()));
+
+    // Reply may have already finished before we connected to it
+    readyRead();
+    if (!m_finished && m_reply->isFinished()) {
+        replyFinished();
+    }
+}
+
+void DownloadSegment::abort()
+{
+    if (m_finished) {
+        return;
+    }
+
+    m_finished = true;
+    disconnect(m_reply, 0, this, 0);
+    m_reply->abort();
+}
+
+void DownloadSegment::setPaused(bool paused)
+{
+    if (m_paused == paused) {
+        return;
+    }
+
+    m_paused = paused;
+
+    if (!m_paused) {
+        readyRead();
+        if (m_finishPending) {
+            replyFinished();
+        }
+    }
+}
+
+qint64 DownloadSegment::remaining() const
+{
+    if (m_end < 0) {
+        return -1;
+    }
+
+    return m_end - m_position;
+}
+
+void DownloadSegment::setEndOffset(qint64 end)
+{
+    m_end = end;
+
+    if (m_end >= 0 && m_position >= m_end) {
+        finish();
+    }
+}
+
+QNetworkRequest DownloadSegment::rangeRequest(const QNetworkRequest &request, qint64 start, qint64 end, const QByteArray &validator)
+{
+    QNetworkRequest req = request;
+
+    // Ranges of compressed content cannot be decompressed separately
+    req.setRawHeader("Accept-Encoding", "identity");
+
+    // HTTP ranges are inclusive
+    if (end < 0) {
+        req.setRawHeader("Range", "bytes=" + QByteArray::number(start) + "-");
+    }
+    else {
+        req.setRawHeader("Range", "bytes=" + QByteArray::number(start) + "-" + QByteArray::number(end - 1));
+    }
+
+    // Server will send whole file if it was modified since the validator was received
+    if (!validator.isEmpty()) {
+        req.setRawHeader("If-Range", validator);
+    }
+
+    return req;
+}
+
+bool DownloadSegment::checkRangeResponse()
+{
+    if (!m_ranged || m_rangeChecked) {
+        return true;
+    }
+
+    m_rangeChecked = true;
+
+    int status = m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+    if (status == 200) {
+        reject();
+        return false;
+    }
+
+    // Server must return exactly the requested range, otherwise written data would be corrupted
+    QByteArray contentRange = m_reply->rawHeader("Content-Range");
+    QByteArray expected = "bytes " + QByteArray::number(m_position) + "-";
+
+    if (status != 206 || !contentRange.startsWith(expected)) {
+        fail(tr("Server returned invalid range"));
+        return false;
+    }
+
+    qint64 size = contentRange.mid(contentRange.lastIndexOf('/') + 1).toLongLong();
+    if (m_expectedSize > 0 && size > 0 && size != m_expectedSize) {
+        reject();
+        return false;
+    }
+
+    return true;
+}
+
+void DownloadSegment::readyRead()
+{
+    if (m_finished || m_paused || !m_reply->bytesAvailable() || !checkRangeResponse()) {
+        return;
+    }
+
+    qint64 maxSize = m_end < 0 ? m_reply->bytesAvailable() : qMin(m_reply->bytesAvailable(), m_end - m_position);
+    QByteArray data = m_reply->read(maxSize);
+
+    if (!data.isEmpty()) {
+        qint64 offset = m_position;
+        m_position += data.size();
+
+        emit dataReceived(offset, data);
+    }
+
+    if (m_end >= 0 && m_position >= m_end) {
+        finish();
+    }
+}
+
+void DownloadSegment::replyFinished()
+{
+    // Data left in reply will be read when segment is resumed
+    if (m_paused) {
+        m_finishPending = true;
+        return;
+    }
+
+    m_finishPending = false;
+    readyRead();
+
+    if (m_finished) {
+        return;
+    }
+
+    if (m_reply->error() != QNetworkReply::NoError) {
+        fail(m_reply->errorString());
+        return;
+    }
+
+    if (m_end < 0) {
+        m_end = m_position;
+    }
+
+    if (m_position < m_end) {
+        fail(tr("Connection closed before all data was received"));
+        return;
+    }
+
+    finish();
+}
+
+void DownloadSegment::finish()
+{
+    if (m_finished) {
+        return;
+    }
+
+    // Reply may still be sending data that belongs to other segment
+    m_finished = true;
+    disconnect(m_reply, 0, this, 0);
+    if (!m_reply->isFinished()) {
+        m_reply->abort();
+    }
+
+    emit finished(this);
+}
+
+void DownloadSegment::fail(const QString &errorString)
+{
+    if (m_finished) {
+        return;
+    }
+
+    m_finished = true;
+    disconnect(m_reply, 0, this, 0);
+    if (!m_reply->isFinished()) {
+        m_reply->abort();
+    }
+
+    emit failed(this, errorString);
+}
+
+void DownloadSegment::reject()
+{
+    if (m_finished) {
+        return;
+    }
+
+    m_finished = true;
+    disconnect(m_reply, 0, this, 0);
+    m_reply->abort();
+
+    emit rangeRejected(this);
+}
@@ -0,0 +1,88 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef DOWNLOADSEGMENT_H
+#define DOWNLOADSEGMENT_H
+
+#include <QObject>
+#include <QNetworkReply>
+
+#include "qz_namespace.h"
+
+class QNetworkRequest;
+
+// One byte range [start, end) of downloaded file served by one QNetworkReply.
+// End is -1 when size of the file is not known.
+class QT_QUPZILLA_EXPORT DownloadSegment : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DownloadSegment(QNetworkReply* reply, qint64 start, qint64 end, bool ranged, QObject* parent = 0);
+
+    void start();
+    void abort();
+
+    QNetworkReply* reply() const { return m_reply; }
+    qint64 startOffset() const { return m_start; }
+    qint64 position() const { return m_position; }
+    qint64 endOffset() const { return m_end; }
+    qint64 remaining() const;
+
+    void setEndOffset(qint64 end);
+    bool isFinished() const { return m_finished; }
+
+    // Paused segment does not read from reply, so the reply stops
+    // reading from socket once its read buffer is full
+    void setPaused(bool paused);
+    bool isPaused() const { return m_paused; }
+
+    // Size of whole file, checked against Content-Range of response
+    void setExpectedSize(qint64 size) { m_expectedSize = size; }
+
+    static QNetworkRequest rangeRequest(const QNetworkRequest &request, qint64 start, qint64 end, const QByteArray &validator = QByteArray());
+
+signals:
+    void dataReceived(qint64 offset, const QByteArray &data);
+    void finished(DownloadSegment* segment);
+    void failed(DownloadSegment* segment, const QString &errorString);
+    // Server sent whole file instead of requested range (it has changed or ranges are not supported)
+    void rangeRejected(DownloadSegment* segment);
+
+private slots:
+    void readyRead();
+    void replyFinished();
+
+private:
+    bool checkRangeResponse();
+    void finish();
+    void fail(const QString &errorString);
+    void reject();
+
+    QNetworkReply* m_reply;
+    qint64 m_start;
+    qint64 m_position;
+    qint64 m_end;
+    qint64 m_expectedSize;
+
+    bool m_ranged;
+    bool m_rangeChecked;
+    bool m_finished;
+    bool m_paused;
+    bool m_finishPending;
+};
+
+#endif // DOWNLOADSEGMENT_H
@@ -0,0 +1,393 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "downloadwriter.h"
+#include "downloadchecksum.h"
+
+#include <QFile>
+#include <QTimerEvent>
+#include <QMetaType>
+#include <QMutexLocker>
+
+// Contiguous data is written to disk in chunks of at least this size
+#define WRITE_BUFFER_SIZE (512 * 1024)
+// Data smaller than one chunk is written at least once per interval (ms)
+#define FLUSH_INTERVAL 1000
+// Size of chunks read back from file when checksum has to catch up with data written
+// out of order, only one chunk is read before queued writes are processed
+#define CHECKSUM_READ_SIZE (256 * 1024)
+
+DownloadWriter::DownloadWriter(const QString &fileName, const QList<Range> &writtenRanges)
+    : QObject()
+    , m_file(new QFile(fileName, this))
+    , m_truncate(false)
+    , m_failed(false)
+    , m_preallocateSize(0)
+    , m_checksum(0)
+    , m_checksumOffset(0)
+    , m_catchUpScheduled(false)
+    , m_bytesQueued(0)
+    , m_bytesWritten(0)
+{
+    qRegisterMetaType<qint64>("qint64");
+
+    foreach(const Range & range, writtenRanges) {
+        addWrittenRange(range.first, range.second - range.first);
+    }
+}
+
+void DownloadWriter::write(qint64 offset, const QByteArray &data)
+{
+    m_mutex.lock();
+    m_bytesQueued += data.size();
+    m_mutex.unlock();
+
+    QMetaObject::invokeMethod(this, "writeData", Qt::QueuedConnection, Q_ARG(qint64, offset), Q_ARG(QByteArray, data));
+}
+
+qint64 DownloadWriter::bytesQueued()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_bytesQueued;
+}
+
+qint64 DownloadWriter::bytesWritten()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_bytesWritten;
+}
+
+QList<DownloadWriter::Range> DownloadWriter::writtenRanges()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_writtenRanges;
+}
+
+QMap<QString, QString> DownloadWriter::checksums()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_checksums;
+}
+
+QList<DownloadWriter::Range> DownloadWriter::missingRanges(const QList<Range> &writtenRanges, qint64 size)
+{
+    QList<Range> ranges;
+    qint64 position = 0;
+
+    foreach(const Range & range, writtenRanges) {
+        if (range.first > position) {
+            ranges.append(Range(position, qMin(range.first, size)));
+        }
+        position = qMax(position, range.second);
+    }
+
+    if (position < size) {
+        ranges.append(Range(position, size));
+    }
+
+    return ranges;
+}
+
+void DownloadWriter::open(bool truncate, qint64 size, int checksumAlgorithms)
+{
+    m_truncate = truncate;
+    m_preallocateSize = size;
+    m_failed = false;
+
+    if (m_truncate) {
+        // Data still buffered from before restart belong to old file
+        qint64 dropped = dropBuffers();
+
+        // Already opened file would not be truncated in ensureOpened()
+        m_file->close();
+
+        QMutexLocker locker(&m_mutex);
+        m_bytesQueued -= dropped;
+        m_writtenRanges.clear();
+        m_bytesWritten = 0;
+    }
+
+    // Checksum state is kept when download is resumed
+    if (m_truncate || !m_checksum || m_checksum->algorithms() != checksumAlgorithms) {
+        delete m_checksum;
+        m_checksum = checksumAlgorithms ? new DownloadChecksum(checksumAlgorithms) : 0;
+        m_checksumOffset = 0;
+    }
+
+    m_mutex.lock();
+    m_checksums.clear();
+    m_mutex.unlock();
+
+    ensureOpened();
+}
+
+bool DownloadWriter::ensureOpened()
+{
+    if (m_file->isOpen()) {
+        return true;
+    }
+
+    if (m_failed) {
+        return false;
+    }
+
+    // ReadWrite does not truncate file, ranges are written at their offsets
+    QIODevice::OpenMode mode = QIODevice::ReadWrite;
+    if (m_truncate) {
+        mode |= QIODevice::Truncate;
+    }
+
+    if (!m_file->open(mode)) {
+        m_failed = true;
+        emit error(tr("Cannot write to file!"));
+        return false;
+    }
+
+    m_truncate = false;
+
+    // Allocate whole file at once instead of growing it with each write
+    if (m_preallocateSize > m_file->size()) {
+        m_file->resize(m_preallocateSize);
+    }
+
+    return true;
+}
+
+void DownloadWriter::writeData(qint64 offset, const QByteArray &data)
+{
+    for (int i = 0; i < m_buffers.count(); ++i) {
+        Buffer &buffer = m_buffers[i];
+        if (buffer.offset + buffer.data.size() == offset) {
+            buffer.data.append(data);
+
+            if (buffer.data.size() >= WRITE_BUFFER_SIZE) {
+                writeBuffer(i);
+            }
+            return;
+        }
+    }
+
+    Buffer buffer;
+    buffer.offset = offset;
+    buffer.data = data;
+    m_buffers.append(buffer);
+
+    if (data.size() >= WRITE_BUFFER_SIZE) {
+        writeBuffer(m_buffers.count() - 1);
+    }
+    else if (!m_flushTimer.isActive()) {
+        m_flushTimer.start(FLUSH_INTERVAL, this);
+    }
+}
+
+void DownloadWriter::writeBuffer(int index)
+{
+    Buffer buffer = m_buffers.takeAt(index);
+    bool written = false;
+
+    if (ensureOpened()) {
+        written = m_file->seek(buffer.offset) && m_file->write(buffer.data) == buffer.data.size();
+
+        if (!written && !m_failed) {
+            m_failed = true;
+            emit error(tr("Cannot write to file!"));
+        }
+    }
+
+    m_mutex.lock();
+    m_bytesQueued -= buffer.data.size();
+    if (written) {
+        addWrittenRange(buffer.offset, buffer.data.size());
+    }
+    m_mutex.unlock();
+
+    if (written) {
+        updateChecksum(buffer);
+    }
+
+    emit dataWritten();
+}
+
+void DownloadWriter::updateChecksum(const Buffer &buffer)
+{
+    if (!m_checksum) {
+        return;
+    }
+
+    // Data that continues checksummed part of file are used directly
+    qint64 end = buffer.offset + buffer.data.size();
+    if (buffer.offset <= m_checksumOffset && end > m_checksumOffset) {
+        int skip = m_checksumOffset - buffer.offset;
+        m_checksum->addData(buffer.data.constData() + skip, buffer.data.size() - skip);
+        m_checksumOffset = end;
+    }
+
+    if (!m_catchUpScheduled) {
+        catchUpChecksum();
+    }
+}
+
+void DownloadWriter::catchUpChecksum()
+{
+    m_catchUpScheduled = false;
+
+    // Rest is read after writes queued in the meantime
+    if (readBackChecksumChunk()) {
+        m_catchUpScheduled = true;
+        QMetaObject::invokeMethod(this, "catchUpChecksum", Qt::QueuedConnection);
+    }
+}
+
+bool DownloadWriter::readBackChecksumChunk()
+{
+    if (!m_checksum) {
+        return false;
+    }
+
+    // Ranges written out of order are read back once the part before them is complete
+    m_mutex.lock();
+    qint64 contiguousEnd = 0;
+    if (!m_writtenRanges.isEmpty() && m_writtenRanges.first().first == 0) {
+        contiguousEnd = m_writtenRanges.first().second;
+    }
+    m_mutex.unlock();
+
+    if (contiguousEnd <= m_checksumOffset || !m_file->isOpen() || !m_file->seek(m_checksumOffset)) {
+        return false;
+    }
+
+    QByteArray data = m_file->read(qMin<qint64>(CHECKSUM_READ_SIZE, contiguousEnd - m_checksumOffset));
+    if (data.isEmpty()) {
+        return false;
+    }
+
+    m_checksum->addData(data.constData(), data.size());
+    m_checksumOffset += data.size();
+
+    return m_checksumOffset < contiguousEnd;
+}
+
+void DownloadWriter::addWrittenRange(qint64 offset, qint64 size)
+{
+    // Ranges are kept sorted and merged
+    qint64 start = offset;
+    qint64 end = offset + size;
+
+    int i = 0;
+    while (i < m_writtenRanges.count()) {
+        const Range &range = m_writtenRanges.at(i);
+        if (range.second < start) {
+            ++i;
+            continue;
+        }
+        if (range.first > end) {
+            break;
+        }
+
+        start = qMin(start, range.first);
+        end = qMax(end, range.second);
+        m_bytesWritten -= range.second - range.first;
+        m_writtenRanges.removeAt(i);
+    }
+
+    m_writtenRanges.insert(i, Range(start, end));
+    m_bytesWritten += end - start;
+}
+
+void DownloadWriter::flush()
+{
+    m_flushTimer.stop();
+
+    while (!m_buffers.isEmpty()) {
+        writeBuffer(0);
+    }
+
+    if (m_file->isOpen()) {
+        m_file->flush();
+    }
+}
+
+void DownloadWriter::close()
+{
+    flush();
+
+    // Make sure that also empty file is created
+    ensureOpened();
+    // All data are written, rest of read back is done at once
+    while (readBackChecksumChunk()) {
+    }
+    m_file->close();
+
+    // Checksums are valid only when whole file was checksummed
+    if (m_checksum && m_writtenRanges.count() < 2) {
+        qint64 size = m_writtenRanges.isEmpty() ? 0 : m_writtenRanges.first().second;
+        bool complete = m_checksumOffset == size && (m_preallocateSize <= 0 || size == m_preallocateSize);
+
+        QMutexLocker locker(&m_mutex);
+        m_checksums = complete ? m_checksum->results() : QMap<QString, QString>();
+    }
+
+    emit closed();
+}
+
+qint64 DownloadWriter::dropBuffers()
+{
+    m_flushTimer.stop();
+
+    qint64 dropped = 0;
+    foreach(const Buffer & buffer, m_buffers) {
+        dropped += buffer.data.size();
+    }
+    m_buffers.clear();
+
+    return dropped;
+}
+
+void DownloadWriter::remove()
+{
+    qint64 dropped = dropBuffers();
+
+    m_file->close();
+    m_file->remove();
+    m_truncate = true;
+    m_failed = false;
+
+    delete m_checksum;
+    m_checksum = 0;
+    m_checksumOffset = 0;
+
+    QMutexLocker locker(&m_mutex);
+    m_bytesQueued -= dropped;
+    m_writtenRanges.clear();
+    m_bytesWritten = 0;
+    m_checksums.clear();
+}
+
+DownloadWriter::~DownloadWriter()
+{
+    delete m_checksum;
+}
+
+void DownloadWriter::timerEvent(QTimerEvent* event)
+{
+    if (event->timerId() == m_flushTimer.timerId()) {
+        flush();
+    }
+    else {
+        QObject::timerEvent(event);
+    }
+}
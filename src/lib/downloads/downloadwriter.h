@@ -0,0 +1,115 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef DOWNLOADWRITER_H
+#define DOWNLOADWRITER_H
+
+#include <QObject>
+#include <QPair>
+#include <QList>
+#include <QMutex>
+#include <QBasicTimer>
+#include <QMap>
+
+#include "qz_namespace.h"
+
+class QFile;
+
+class DownloadChecksum;
+
+// Writes downloaded data to file in download writer thread.
+// Data of each contiguous range is collected into large buffers, so
+// the file is written in few big writes instead of one write per readyRead.
+// Written ranges of the file are tracked, so unfinished download
+// can be resumed only from data that really was written to disk.
+// Checksums are computed from data in file order as they are written.
+// Data written out of order (other segments, resumed download) are read
+// back from file once the part before them is complete, one chunk at
+// a time between writes.
+class QT_QUPZILLA_EXPORT DownloadWriter : public QObject
+{
+    Q_OBJECT
+public:
+    typedef QPair<qint64, qint64> Range;
+
+    explicit DownloadWriter(const QString &fileName, const QList<Range> &writtenRanges = QList<Range>());
+    ~DownloadWriter();
+
+    // Thread-safe, called from GUI thread
+    void write(qint64 offset, const QByteArray &data);
+    qint64 bytesQueued();
+    qint64 bytesWritten();
+    QList<Range> writtenRanges();
+    // Available after whole file was written and writer closed
+    QMap<QString, QString> checksums();
+
+    static QList<Range> missingRanges(const QList<Range> &writtenRanges, qint64 size);
+
+public slots:
+    // Truncates the file and preallocates size bytes if size is known,
+    // checksumAlgorithms is combination of DownloadChecksum::Algorithm
+    void open(bool truncate, qint64 size, int checksumAlgorithms);
+    void flush();
+    void close();
+    void remove();
+
+signals:
+    // Emitted after buffered data was written to disk
+    void dataWritten();
+    void error(const QString &errorString);
+    void closed();
+
+private slots:
+    void writeData(qint64 offset, const QByteArray &data);
+    void catchUpChecksum();
+
+private:
+    struct Buffer {
+        qint64 offset;
+        QByteArray data;
+    };
+
+    void timerEvent(QTimerEvent* event);
+    bool ensureOpened();
+    void writeBuffer(int index);
+    // Returns size of dropped data, caller updates m_bytesQueued
+    qint64 dropBuffers();
+    void addWrittenRange(qint64 offset, qint64 size);
+    void updateChecksum(const Buffer &buffer);
+    // Returns false when there is nothing more to read back
+    bool readBackChecksumChunk();
+
+    QFile* m_file;
+    QList<Buffer> m_buffers;
+    QBasicTimer m_flushTimer;
+
+    bool m_truncate;
+    bool m_failed;
+    qint64 m_preallocateSize;
+
+    DownloadChecksum* m_checksum;
+    qint64 m_checksumOffset;
+    bool m_catchUpScheduled;
+
+    QMutex m_mutex;
+    QList<Range> m_writtenRanges;
+    qint64 m_bytesQueued;
+    qint64 m_bytesWritten;
+    QMap<QString, QString> m_checksums;
+};
+
+#endif // DOWNLOADWRITER_H
@@ -0,0 +1,282 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "historycache.h"
+#include "iconprovider.h"
+#include "mainapplication.h"
+#include "databaseexecutor.h"
+
+#include <QDebug>
+
+// Number of entries kept in every list, enough for all menus
+#define CACHE_SIZE 30
+
+HistoryCache::HistoryCache(HistoryModel* history)
+    : QObject(history)
+{
+    for (int i = 0; i < 2; ++i) {
+        m_lists[i].loaded = false;
+        m_lists[i].loading = false;
+        m_lists[i].dirty = false;
+        m_lists[i].complete = false;
+    }
+
+    connect(history, SIGNAL(historyEntryAdded(HistoryEntry)), this, SLOT(historyEntryAdded(HistoryEntry)));
+    connect(history, SIGNAL(historyEntryDeleted(HistoryEntry)), this, SLOT(historyEntryDeleted(HistoryEntry)));
+    connect(history, SIGNAL(historyEntryEdited(HistoryEntry, HistoryEntry)), this, SLOT(historyEntryEdited(HistoryEntry, HistoryEntry)));
+    connect(history, SIGNAL(historyClear()), this, SLOT(historyCleared()));
+    connect(mApp->iconProvider(), SIGNAL(iconLoaded(QUrl)), this, SLOT(iconLoaded(QUrl)));
+
+    // Lists are usually ready before any menu is shown
+    load(OrderByFrecency);
+    load(OrderByDate);
+}
+
+QList<HistoryEntry> HistoryCache::entries(Order order, int count)
+{
+    List &list = m_lists[order];
+
+    // Deleted entries may leave list shorter than requested
+    if (!list.loaded || (!list.complete && list.entries.count() < count)) {
+        load(order);
+    }
+
+    return list.entries.mid(0, count);
+}
+
+QIcon HistoryCache::icon(const HistoryEntry &entry)
+{
+    if (m_icons.contains(entry.id)) {
+        return m_icons.value(entry.id);
+    }
+
+    const QIcon icon = IconProvider::iconFromImage(mApp->iconProvider()->cachedIconForUrl(entry.url));
+    m_icons.insert(entry.id, icon);
+
+    return icon;
+}
+
+bool HistoryCache::lessThan(Order order, const HistoryEntry &a, const HistoryEntry &b)
+{
+    if (order == OrderByFrecency) {
+        return a.frecency > b.frecency;
+    }
+
+    return a.date > b.date;
+}
+
+void HistoryCache::load(Order order)
+{
+    List &list = m_lists[order];
+    if (list.loading) {
+        return;
+    }
+
+    list.loading = true;
+    list.dirty = false;
+
+    if (order == OrderByFrecency) {
+        mApp->dbExecutor()->query("SELECT id, count, date, url, title, frecency FROM history ORDER BY frecency DESC LIMIT ?",
+                                  QVariantList() << CACHE_SIZE, this, SLOT(frecencyListLoaded(DatabaseResult)));
+    }
+    else {
+        mApp->dbExecutor()->query("SELECT id, count, date, url, title, frecency FROM history ORDER BY date DESC LIMIT ?",
+                                  QVariantList() << CACHE_SIZE, this, SLOT(dateListLoaded(DatabaseResult)));
+    }
+}
+
+void HistoryCache::frecencyListLoaded(const DatabaseResult &result)
+{
+    listLoaded(OrderByFrecency, result);
+}
+
+void HistoryCache::dateListLoaded(const DatabaseResult &result)
+{
+    listLoaded(OrderByDate, result);
+}
+
+void HistoryCache::listLoaded(Order order, const DatabaseResult &result)
+{
+    List &list = m_lists[order];
+    list.loading = false;
+
+    if (!result.success) {
+        qWarning() << "HistoryCache::listLoaded Cannot load history" << result.error;
+        return;
+    }
+
+    // Query may have run before or after the change was written
+    if (list.dirty) {
+        load(order);
+        return;
+    }
+
+    list.entries.clear();
+
+    foreach(const QVariantList & row, result.rows) {
+        HistoryEntry entry;
+        entry.id = row.at(0).toInt();
+        entry.count = row.at(1).toInt();
+        entry.date = QDateTime::fromMSecsSinceEpoch(row.at(2).toLongLong());
+        entry.url = row.at(3).toUrl();
+        entry.title = row.at(4).toString();
+        entry.frecency = row.at(5).toDouble();
+        list.entries.append(entry);
+    }
+
+    list.loaded = true;
+    list.complete = list.entries.count() < CACHE_SIZE;
+
+    releaseIcons();
+
+    emit entriesLoaded();
+}
+
+void HistoryCache::iconLoaded(const QUrl &url)
+{
+    const QByteArray key = url.toEncoded();
+    bool changed = false;
+
+    for (int i = 0; i < 2; ++i) {
+        foreach(const HistoryEntry & entry, m_lists[i].entries) {
+            if (entry.url.toEncoded(QUrl::RemoveFragment) == key && m_icons.remove(entry.id) > 0) {
+                changed = true;
+            }
+        }
+    }
+
+    if (changed) {
+        emit entriesLoaded();
+    }
+}
+
+void HistoryCache::invalidateLoading()
+{
+    for (int i = 0; i < 2; ++i) {
+        if (m_lists[i].loading) {
+            m_lists[i].dirty = true;
+        }
+    }
+}
+
+void HistoryCache::insertEntry(Order order, const HistoryEntry &entry)
+{
+    List &list = m_lists[order];
+    if (!list.loaded) {
+        return;
+    }
+
+    removeEntry(order, entry.id);
+
+    int i = 0;
+    while (i < list.entries.count() && !lessThan(order, entry, list.entries.at(i))) {
+        ++i;
+    }
+
+    if (i >= CACHE_SIZE) {
+        list.complete = false;
+        return;
+    }
+
+    list.entries.insert(i, entry);
+
+    if (list.entries.count() > CACHE_SIZE) {
+        list.entries.removeLast();
+        list.complete = false;
+    }
+}
+
+void HistoryCache::removeEntry(Order order, int id)
+{
+    QList<HistoryEntry> &entries = m_lists[order].entries;
+
+    for (int i = 0; i < entries.count(); ++i) {
+        if (entries.at(i).id == id) {
+            entries.removeAt(i);
+            return;
+        }
+    }
+}
+
+void HistoryCache::releaseIcons()
+{
+    QHash<int, QIcon>::iterator it = m_icons.begin();
+    while (it != m_icons.end()) {
+        bool cached = false;
+        for (int i = 0; i < 2 && !cached; ++i) {
+            foreach(const HistoryEntry & entry, m_lists[i].entries) {
+                if (entry.id == it.key()) {
+                    cached = true;
+                    break;
+                }
+            }
+        }
+
+        if (cached) {
+            ++it;
+        }
+        else {
+            it = m_icons.erase(it);
+        }
+    }
+}
+
+void HistoryCache::historyEntryAdded(const HistoryEntry &entry)
+{
+    invalidateLoading();
+
+    insertEntry(OrderByFrecency, entry);
+    insertEntry(OrderByDate, entry);
+
+    releaseIcons();
+}
+
+void HistoryCache::historyEntryDeleted(const HistoryEntry &entry)
+{
+    invalidateLoading();
+
+    removeEntry(OrderByFrecency, entry.id);
+    removeEntry(OrderByDate, entry.id);
+
+    m_icons.remove(entry.id);
+}
+
+void HistoryCache::historyEntryEdited(const HistoryEntry &before, const HistoryEntry &after)
+{
+    Q_UNUSED(before)
+
+    invalidateLoading();
+
+    insertEntry(OrderByFrecency, after);
+    insertEntry(OrderByDate, after);
+
+    // Page was visited again, its icon may have changed
+    m_icons.remove(after.id);
+    releaseIcons();
+}
+
+void HistoryCache::historyCleared()
+{
+    invalidateLoading();
+
+    for (int i = 0; i < 2; ++i) {
+        m_lists[i].entries.clear();
+        m_lists[i].complete = true;
+    }
+
+    m_icons.clear();
+}
@@ -0,0 +1,88 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef HISTORYCACHE_H
+#define HISTORYCACHE_H
+
+#include <QObject>
+#include <QHash>
+#include <QIcon>
+
+#include "qz_namespace.h"
+#include "historymodel.h"
+
+struct DatabaseResult;
+
+// Small in-memory lists of top history entries by frecency and by date.
+// Lists are loaded from database in background and then kept up to date
+// from HistoryModel signals, so menus can be shown without any query.
+class QT_QUPZILLA_EXPORT HistoryCache : public QObject
+{
+    Q_OBJECT
+public:
+    enum Order {
+        OrderByFrecency = 0,
+        OrderByDate = 1
+    };
+
+    explicit HistoryCache(HistoryModel* history);
+
+    // List may be incomplete while it is loading, entriesLoaded is
+    // emitted when it is ready
+    QList<HistoryEntry> entries(Order order, int count);
+    // Default icon is returned until the icon is loaded from database,
+    // entriesLoaded is then emitted again
+    QIcon icon(const HistoryEntry &entry);
+
+signals:
+    void entriesLoaded();
+
+private slots:
+    void frecencyListLoaded(const DatabaseResult &result);
+    void dateListLoaded(const DatabaseResult &result);
+    void iconLoaded(const QUrl &url);
+
+    void historyEntryAdded(const HistoryEntry &entry);
+    void historyEntryDeleted(const HistoryEntry &entry);
+    void historyEntryEdited(const HistoryEntry &before, const HistoryEntry &after);
+    void historyCleared();
+
+private:
+    struct List {
+        QList<HistoryEntry> entries;
+        bool loaded;
+        bool loading;
+        // History changed while list was loading, result may be outdated
+        bool dirty;
+        // All entries in database fit into list
+        bool complete;
+    };
+
+    static bool lessThan(Order order, const HistoryEntry &a, const HistoryEntry &b);
+
+    void load(Order order);
+    void listLoaded(Order order, const DatabaseResult &result);
+    void invalidateLoading();
+    void insertEntry(Order order, const HistoryEntry &entry);
+    void removeEntry(Order order, int id);
+    void releaseIcons();
+
+    List m_lists[2];
+    QHash<int, QIcon> m_icons;
+};
+
+#endif // HISTORYCACHE_H
@@ -20,7 +20,7 @@
 #include "qupzilla.h"
 #include "mainapplication.h"
 #include "historymodel.h"
-#include "iconprovider.h"
+#include "historytreemodel.h"
 #include "browsinglibrary.h"
 #include "globalfunctions.h"
 #include "tabwidget.h"
@@ -29,35 +29,32 @@
 #include <QMessageBox>
 #include <QClipboard>
 #include <QTimer>
-#include <QSqlQuery>
+#include <QMouseEvent>
+#include <QScrollBar>
 
 HistoryManager::HistoryManager(QupZilla* mainClass, QWidget* parent)
     : QWidget(parent)
     , ui(new Ui::HistoryManager)
     , p_QupZilla(mainClass)
     , m_historyModel(mApp->history())
+    , m_treeModel(new HistoryTreeModel(m_historyModel, this))
 {
     ui->setupUi(this);
-    ui->historyTree->setDefaultItemShowMode(TreeWidget::ItemsCollapsed);
+    ui->historyTree->setModel(m_treeModel);
     ui->historyTree->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    ui->historyTree->viewport()->installEventFilter(this);
     ui->deleteB->setShortcut(QKeySequence("Del"));
 
-    connect(ui->historyTree, SIGNAL(itemDoubleClicked(QTreeWidgetItem*, int)), this, SLOT(itemDoubleClicked(QTreeWidgetItem*)));
-    connect(ui->historyTree, SIGNAL(itemMiddleButtonClicked(QTreeWidgetItem*)), this, SLOT(itemDoubleClicked(QTreeWidgetItem*)));
+    connect(ui->historyTree, SIGNAL(doubleClicked(QModelIndex)), this, SLOT(itemDoubleClicked(QModelIndex)));
+    connect(ui->historyTree, SIGNAL(expanded(QModelIndex)), this, SLOT(fetchVisibleEntries()));
+    connect(ui->historyTree->verticalScrollBar(), SIGNAL(valueChanged(int)), this, SLOT(fetchVisibleEntries()));
 
     connect(ui->deleteB, SIGNAL(clicked()), this, SLOT(deleteItem()));
     connect(ui->clearAll, SIGNAL(clicked()), this, SLOT(clearHistory()));
     connect(ui->historyTree, SIGNAL(customContextMenuRequested(const QPoint &)), this, SLOT(contextMenuRequested(const QPoint &)));
 
-    connect(m_historyModel, SIGNAL(historyEntryAdded(HistoryEntry)), this, SLOT(historyEntryAdded(HistoryEntry)));
-    connect(m_historyModel, SIGNAL(historyEntryDeleted(HistoryEntry)), this, SLOT(historyEntryDeleted(HistoryEntry)));
-    connect(m_historyModel, SIGNAL(historyEntryEdited(HistoryEntry, HistoryEntry)), this, SLOT(historyEntryEdited(HistoryEntry, HistoryEntry)));
-    connect(m_historyModel, SIGNAL(historyClear()), ui->historyTree, SLOT(clear()));
-
     connect(ui->optimizeDb, SIGNAL(clicked(QPoint)), this, SLOT(optimizeDb()));
 
-    //QTimer::singleShot(0, this, SLOT(refreshTable()));
-
     ui->historyTree->setFocus();
 }
 
@@ -76,14 +73,36 @@ void HistoryManager::setMainWindow(QupZilla* window)
     }
 }
 
-void HistoryManager::itemDoubleClicked(QTreeWidgetItem* item)
+void HistoryManager::itemDoubleClicked(const QModelIndex &index)
 {
-    if (!item || item->text(1).isEmpty()) {
+    if (!index.isValid() || index.data(HistoryTreeModel::IsBucketRole).toBool()) {
         return;
     }
 
-    QUrl url = QUrl::fromEncoded(item->text(1).toUtf8());
-    getQupZilla()->tabWidget()->addView(url, item->text(0));
+    getQupZilla()->tabWidget()->addView(index.data(HistoryTreeModel::UrlRole).toUrl(), index.data(HistoryTreeModel::TitleRole).toString());
+}
+
+bool HistoryManager::eventFilter(QObject* obj, QEvent* event)
+{
+    if (obj == ui->historyTree->viewport() && event->type() == QEvent::MouseButtonPress) {
+        QMouseEvent* ev = static_cast<QMouseEvent*>(event);
+        if (ev->buttons() == Qt::MidButton) {
+            itemDoubleClicked(ui->historyTree->indexAt(ev->pos()));
+        }
+    }
+
+    return QWidget::eventFilter(obj, event);
+}
+
+void HistoryManager::fetchVisibleEntries()
+{
+    // QTreeView fetches only top level items when scrolled to the bottom
+    const QModelIndex &index = ui->historyTree->indexAt(QPoint(1, ui->historyTree->viewport()->height() - 1));
+    const QModelIndex &parent = index.isValid() ? index.parent() : QModelIndex();
+
+    if (parent.isValid() && m_treeModel->canFetchMore(parent) && index.row() >= m_treeModel->rowCount(parent) - 20) {
+        m_treeModel->fetchMore(parent);
+    }
 }
 
 void HistoryManager::loadInNewTab()
@@ -95,10 +114,12 @@ void HistoryManager::loadInNewTab()
 
 void HistoryManager::contextMenuRequested(const QPoint &position)
 {
-    if (!ui->historyTree->itemAt(position)) {
+    const QModelIndex &index = ui->historyTree->indexAt(position);
+    if (!index.isValid() || index.data(HistoryTreeModel::IsBucketRole).toBool()) {
         return;
     }
-    QUrl link = QUrl::fromEncoded(ui->historyTree->itemAt(position)->text(1).toUtf8());
+
+    QUrl link = index.data(HistoryTreeModel::UrlRole).toUrl();
     if (link.isEmpty()) {
         return;
     }
@@ -124,100 +145,19 @@ void HistoryManager::copyUrl()
 
 void HistoryManager::deleteItem()
 {
-    foreach(QTreeWidgetItem * item, ui->historyTree->selectedItems()) {
-        if (!item) {
-            return;
-        }
+    QList<int> list;
 
-        if (!item->parent()) {
-            for (int i = 0; i < item->childCount(); i++) {
-                QTreeWidgetItem* children = item->child(i);
-                int id = children->whatsThis(1).toInt();
-                m_historyModel->deleteHistoryEntry(id);
-
-                ui->historyTree->deleteItem(children);
-                m_ignoredIds.append(id);
-            }
-            ui->historyTree->deleteItem(item);
+    foreach(const QModelIndex & index, ui->historyTree->selectionModel()->selectedRows()) {
+        if (index.data(HistoryTreeModel::IsBucketRole).toBool()) {
+            list += m_treeModel->bucketEntryIds(index);
         }
         else {
-            int id = item->whatsThis(1).toInt();
-            m_historyModel->deleteHistoryEntry(id);
-
-            ui->historyTree->deleteItem(item);
-            m_ignoredIds.append(id);
+            list.append(index.data(HistoryTreeModel::IdRole).toInt());
         }
     }
-}
-
-void HistoryManager::historyEntryAdded(const HistoryEntry &entry)
-{
-    QDate todayDate = QDate::currentDate();
-    QDate startOfWeekDate = todayDate.addDays(1 - todayDate.dayOfWeek());
-
-    QDate date = entry.date.date();
-    QString localDate;
-
-    if (date == todayDate) {
-        localDate = tr("Today");
-    }
-    else if (date >= startOfWeekDate) {
-        localDate = tr("This Week");
-    }
-    else if (date.month() == todayDate.month()) {
-        localDate = tr("This Month");
-    }
-    else {
-        localDate = QString("%1 %2").arg(HistoryModel::titleCaseLocalizedMonth(date.month()), QString::number(date.year()));
-    }
-
-    QTreeWidgetItem* item = new QTreeWidgetItem();
-    QTreeWidgetItem* parentItem;
-    QList<QTreeWidgetItem*> findParent = ui->historyTree->findItems(localDate, 0);
-    if (findParent.count() == 1) {
-        parentItem = findParent.at(0);
-    }
-    else {
-        parentItem = new QTreeWidgetItem();
-        parentItem->setText(0, localDate);
-        parentItem->setIcon(0, QIcon(":/icons/menu/history_entry.png"));
-        ui->historyTree->insertTopLevelItem(0, parentItem);
-    }
 
-    item->setText(0, entry.title);
-    item->setText(1, entry.url.toEncoded());
-    item->setToolTip(0, entry.title);
-    item->setToolTip(1, entry.url.toEncoded());
-
-    item->setWhatsThis(1, QString::number(entry.id));
-    item->setIcon(0, _iconForUrl(entry.url));
-    ui->historyTree->prependToParentItem(parentItem, item);
-}
-
-void HistoryManager::historyEntryDeleted(const HistoryEntry &entry)
-{
-    if (m_ignoredIds.contains(entry.id)) {
-        m_ignoredIds.removeOne(entry.id);
-        return;
-    }
-
-    QList<QTreeWidgetItem*> list = ui->historyTree->allItems();
-    foreach(QTreeWidgetItem * item, list) {
-        if (!item) {
-            continue;
-        }
-        if (item->whatsThis(1).toInt() != entry.id) {
-            continue;
-        }
-        ui->historyTree->deleteItem(item);
-        return;
-    }
-}
-
-void HistoryManager::historyEntryEdited(const HistoryEntry &before, const HistoryEntry &after)
-{
-    historyEntryDeleted(before);
-    historyEntryAdded(after);
+    // Items are removed from tree once they are deleted from database
+    m_historyModel->deleteHistoryEntry(list);
 }
 
 void HistoryManager::clearHistory()
@@ -239,98 +179,12 @@ void HistoryManager::refreshTable()
 
 void HistoryManager::slotRefreshTable()
 {
-    QApplication::setOverrideCursor(Qt::WaitCursor);
-    ui->historyTree->clear();
-
-    QDate todayDate = QDate::currentDate();
-    QDate startOfWeekDate = todayDate.addDays(1 - todayDate.dayOfWeek());
-    QSqlQuery query;
-    query.exec("SELECT title, url, id, date FROM history ORDER BY date DESC");
-
-    int counter = 0;
-    QHash<QString, QTreeWidgetItem*> hash;
-    while (query.next()) {
-        const QString &title = query.value(0).toString();
-        const QUrl &url = query.value(1).toUrl();
-        int id = query.value(2).toInt();
-        const QDate &date = QDateTime::fromMSecsSinceEpoch(query.value(3).toLongLong()).date();
-        QString localDate;
-
-        if (date == todayDate) {
-            localDate = tr("Today");
-        }
-        else if (date >= startOfWeekDate) {
-            localDate = tr("This Week");
-        }
-        else if (date.month() == todayDate.month()) {
-            localDate = tr("This Month");
-        }
-        else {
-            localDate = QString("%1 %2").arg(HistoryModel::titleCaseLocalizedMonth(date.month()), QString::number(date.year()));
-        }
-
-        QTreeWidgetItem* item;
-        QTreeWidgetItem* findParent = hash[localDate];
-        if (findParent) {
-            item = new QTreeWidgetItem(findParent);
-        }
-        else {
-            QTreeWidgetItem* newParent = new QTreeWidgetItem(ui->historyTree);
-            newParent->setText(0, localDate);
-            newParent->setIcon(0, QIcon(":/icons/menu/history_entry.png"));
-            ui->historyTree->addTopLevelItem(newParent);
-            hash[localDate] = newParent;
-
-            item = new QTreeWidgetItem(newParent);
-        }
-
-        item->setText(0, title);
-        item->setText(1, url.toEncoded());
-        item->setToolTip(0, title);
-        item->setToolTip(1, url.toEncoded());
-
-        item->setWhatsThis(1, QString::number(id));
-        item->setIcon(0, _iconForUrl(url));
-        ui->historyTree->addTopLevelItem(item);
-
-        ++counter;
-        if (counter > 200) {
-            QApplication::processEvents();
-            counter = 0;
-        }
-    }
-
-    QApplication::restoreOverrideCursor();
+    m_treeModel->refresh();
 }
 
 void HistoryManager::search(const QString &searchText)
 {
-    ui->historyTree->filterString(searchText);
-//    if (searchText.isEmpty()) {
-//        refreshTable();
-//        return;
-//    }
-
-//    refreshTable();
-//    ui->historyTree->setUpdatesEnabled(false);
-
-//    QList<QTreeWidgetItem*> items = ui->historyTree->findItems("*" + searchText + "*", Qt::MatchRecursive | Qt::MatchWildcard);
-
-//    QList<QTreeWidgetItem*> foundItems;
-//    foreach(QTreeWidgetItem * fitem, items) {
-//        if (fitem->text(1).isEmpty()) {
-//            continue;
-//        }
-//        QTreeWidgetItem* item = new QTreeWidgetItem();
-//        item->setText(0, fitem->text(0));
-//        item->setText(1, fitem->text(1));
-//        item->setWhatsThis(1, fitem->whatsThis(1));
-//        item->setIcon(0, _iconForUrl(fitem->text(1)));
-//        foundItems.append(item);
-//    }
-//    ui->historyTree->clear();
-//    ui->historyTree->addTopLevelItems(foundItems);
-//    ui->historyTree->setUpdatesEnabled(true);
+    m_treeModel->setSearchString(searchText);
 }
 
 void HistoryManager::optimizeDb()
@@ -20,6 +20,7 @@
 
 #include <QWidget>
 #include <QWeakPointer>
+#include <QModelIndex>
 
 #include "qz_namespace.h"
 #include "historymodel.h"
@@ -29,9 +30,8 @@ namespace Ui
 class HistoryManager;
 }
 
-class QTreeWidgetItem;
-
 class QupZilla;
+class HistoryTreeModel;
 
 class QT_QUPZILLA_EXPORT HistoryManager : public QWidget
 {
@@ -49,8 +49,9 @@ public slots:
 
 private slots:
     void optimizeDb();
-    void itemDoubleClicked(QTreeWidgetItem* item);
+    void itemDoubleClicked(const QModelIndex &index);
     void slotRefreshTable();
+    void fetchVisibleEntries();
 
     void deleteItem();
     void clearHistory();
@@ -58,17 +59,14 @@ private slots:
     void loadInNewTab();
     void copyUrl();
 
-    void historyEntryAdded(const HistoryEntry &entry);
-    void historyEntryDeleted(const HistoryEntry &entry);
-    void historyEntryEdited(const HistoryEntry &before, const HistoryEntry &after);
-
 private:
+    bool eventFilter(QObject* obj, QEvent* event);
+
     QupZilla* getQupZilla();
     Ui::HistoryManager* ui;
     QWeakPointer<QupZilla> p_QupZilla;
     HistoryModel* m_historyModel;
-
-    QList<int> m_ignoredIds;
+    HistoryTreeModel* m_treeModel;
 };
 
 #endif // HISTORYMANAGER_H
@@ -16,29 +16,66 @@
 * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 * ============================================================ */
 #include "historymodel.h"
+#include "historycache.h"
+#include "historywriter.h"
+#include "databaseexecutor.h"
 #include "tabbedwebview.h"
 #include "qupzilla.h"
 #include "iconprovider.h"
-#include "databasewriter.h"
+#include "mainapplication.h"
 #include "settings.h"
+#include "sqlquery.h"
 
-#include <QThread>
+#include <QTimerEvent>
+#include <qmath.h>
+
+// Pending visits are written after FLUSH_INTERVAL or when there is
+// MAXIMUM_PENDING_VISITS of them
+#define FLUSH_INTERVAL 2000
+#define MAXIMUM_PENDING_VISITS 50
+
+// Retention policy is enforced PRUNE_DELAY after start and then every PRUNE_INTERVAL
+#define PRUNE_DELAY (5 * 60 * 1000)
+#define PRUNE_INTERVAL (6 * 60 * 60 * 1000)
+
+// Visit frecency points are doubled every FRECENCY_HALF_LIFE since FRECENCY_EPOCH
+#define FRECENCY_EPOCH Q_INT64_C(1325376000000)
+#define FRECENCY_HALF_LIFE (30.0 * 24 * 60 * 60 * 1000)
 
 HistoryModel::HistoryModel(QupZilla* mainClass)
     : QObject()
     , m_isSaving(true)
+    , m_maxAge(0)
+    , m_maxEntries(0)
+    , m_keepVisitCount(0)
+    , m_writer(new HistoryWriter())
+    , m_cache(new HistoryCache(this))
     , p_QupZilla(mainClass)
 {
     loadSettings();
 
     qRegisterMetaType<HistoryEntry>("HistoryEntry");
+    qRegisterMetaType<QList<HistoryEntry> >("QList<HistoryEntry>");
+    qRegisterMetaType<QList<HistoryModel::Visit> >("QList<HistoryModel::Visit>");
+    qRegisterMetaType<QList<int> >("QList<int>");
+
+    // Writer uses database connection of executor thread, so its
+    // requests are processed in order with other queued statements
+    m_writer->moveToThread(mApp->dbExecutor()->workerThread());
+
+    connect(m_writer, SIGNAL(visitsWritten(QList<HistoryEntry>, QList<HistoryEntry>)),
+            this, SLOT(visitsWritten(QList<HistoryEntry>, QList<HistoryEntry>)));
+    connect(m_writer, SIGNAL(entryDeleted(HistoryEntry)), this, SIGNAL(historyEntryDeleted(HistoryEntry)));
+    connect(m_writer, SIGNAL(historyPruned(int, int, int, qint64, bool)), this, SLOT(pruneFinished(int, int, int, qint64, bool)));
+
+    m_pruneTimer.start(PRUNE_DELAY, this);
+}
 
-    QThread* t = new QThread(this);
-    t->start();
-    moveToThread(t);
+HistoryModel::~HistoryModel()
+{
+    flushHistory(true);
 
-    connect(this, SIGNAL(signalAddHistoryEntry(QUrl, QString)), this, SLOT(slotAddHistoryEntry(QUrl, QString)));
-    connect(this, SIGNAL(signalDeleteHistoryEntry(int)), this, SLOT(slotDeleteHistoryEntry(int)));
+    m_writer->deleteLater();
 }
 
 void HistoryModel::loadSettings()
@@ -46,11 +83,15 @@ void HistoryModel::loadSettings()
     Settings settings;
     settings.beginGroup("Web-Browser-Settings");
     m_isSaving = settings.value("allowHistory", true).toBool();
+    // Pruning is off until user enables it
+    m_maxAge = settings.value("historyMaxAge", 0).toInt();
+    m_maxEntries = settings.value("historyMaxEntries", 0).toInt();
+    m_keepVisitCount = settings.value("historyKeepVisitCount", 20).toInt();
     settings.endGroup();
 }
 
 // AddHistoryEntry
-void HistoryModel::addHistoryEntry(WebView* view)
+void HistoryModel::addHistoryEntry(WebView* view, VisitTransition transition)
 {
     if (!m_isSaving) {
         return;
@@ -59,15 +100,10 @@ void HistoryModel::addHistoryEntry(WebView* view)
     const QUrl &url = view->url();
     const QString &title = view->title();
 
-    addHistoryEntry(url, title);
-}
-
-void HistoryModel::addHistoryEntry(const QUrl &url, QString title)
-{
-    emit signalAddHistoryEntry(url, title);
+    addHistoryEntry(url, title, transition);
 }
 
-void HistoryModel::slotAddHistoryEntry(const QUrl &url, QString title)
+void HistoryModel::addHistoryEntry(const QUrl &url, QString title, VisitTransition transition)
 {
     if (!m_isSaving) {
         return;
@@ -80,55 +116,96 @@ void HistoryModel::slotAddHistoryEntry(const QUrl &url, QString title)
         title = tr("No Named Page");
     }
 
-    QSqlQuery query;
-    query.prepare("SELECT id FROM history WHERE url=?");
-    query.bindValue(0, url);
-    query.exec();
-    if (!query.next()) {
-        query.prepare("INSERT INTO history (count, date, url, title) VALUES (1,?,?,?)");
-        query.bindValue(0, QDateTime::currentMSecsSinceEpoch());
-        query.bindValue(1, url);
-        query.bindValue(2, title);
-        query.exec();
-
-        int id = query.lastInsertId().toInt();
-        HistoryEntry entry;
-        entry.id = id;
-        entry.count = 1;
-        entry.date = QDateTime::currentDateTime();
-        entry.url = url;
-        entry.title = title;
+    Visit visit;
+    visit.url = url;
+    visit.title = title;
+    visit.date = QDateTime::currentMSecsSinceEpoch();
+    visit.transition = transition;
+
+    // Visits are not written immediately, bursts of navigations
+    // (redirects, fragment changes) are stored in one transaction
+    m_pendingVisits.append(visit);
+
+    if (m_pendingVisits.count() >= MAXIMUM_PENDING_VISITS) {
+        flushHistory();
+    }
+    else if (!m_flushTimer.isActive()) {
+        m_flushTimer.start(FLUSH_INTERVAL, this);
+    }
+}
+
+void HistoryModel::flushHistory(bool wait)
+{
+    m_flushTimer.stop();
+
+    if (!m_pendingVisits.isEmpty()) {
+        QMetaObject::invokeMethod(m_writer, "writeVisits", Qt::QueuedConnection,
+                                  Q_ARG(QList<HistoryModel::Visit>, m_pendingVisits));
+        m_pendingVisits.clear();
+    }
+
+    if (wait) {
+        // Writer thread processes requests in order, so this returns
+        // after all previously queued visits are written
+        QMetaObject::invokeMethod(m_writer, "sync", Qt::BlockingQueuedConnection);
+    }
+}
+
+void HistoryModel::timerEvent(QTimerEvent* event)
+{
+    if (event->timerId() == m_flushTimer.timerId()) {
+        flushHistory();
+        return;
+    }
+
+    if (event->timerId() == m_pruneTimer.timerId()) {
+        m_pruneTimer.start(PRUNE_INTERVAL, this);
+        pruneHistory();
+        return;
+    }
+
+    QObject::timerEvent(event);
+}
+
+void HistoryModel::visitsWritten(const QList<HistoryEntry> &added, const QList<HistoryEntry> &edited)
+{
+    // Only one signal for every entry is emitted, even if it was
+    // visited multiple times since last write
+    foreach(const HistoryEntry & entry, added) {
         emit historyEntryAdded(entry);
     }
-    else {
-        int id = query.value(0).toInt();
-        query.prepare("UPDATE history SET count = count + 1, date=?, title=? WHERE url=?");
-        query.bindValue(0, QDateTime::currentMSecsSinceEpoch());
-        query.bindValue(1, title);
-        query.bindValue(2, url);
-        query.exec();
 
+    foreach(const HistoryEntry & entry, edited) {
         HistoryEntry before;
-        before.id = id;
+        before.id = entry.id;
 
-        HistoryEntry after;
-        after.id = id;
-        after.date = QDateTime::currentDateTime();
-        after.url = url;
-        after.title = title;
-        emit historyEntryEdited(before, after);
+        emit historyEntryEdited(before, entry);
     }
 }
 
 // DeleteHistoryEntry
 void HistoryModel::deleteHistoryEntry(int index)
 {
-    emit signalDeleteHistoryEntry(index);
+    deleteHistoryEntry(QList<int>() << index);
+}
+
+void HistoryModel::deleteHistoryEntry(const QList<int> &list)
+{
+    if (list.isEmpty()) {
+        return;
+    }
+
+    flushHistory();
+
+    // All entries are deleted in one transaction
+    QMetaObject::invokeMethod(m_writer, "deleteEntries", Qt::QueuedConnection, Q_ARG(QList<int>, list));
 }
 
 void HistoryModel::deleteHistoryEntry(const QString &url, const QString &title)
 {
-    QSqlQuery query;
+    flushHistory(true);
+
+    SqlQuery query("history");
     query.prepare("SELECT id FROM history WHERE url=? AND title=?");
     query.bindValue(0, url);
     query.bindValue(1, title);
@@ -139,73 +216,113 @@ void HistoryModel::deleteHistoryEntry(const QString &url, const QString &title)
     }
 }
 
-void HistoryModel::slotDeleteHistoryEntry(int index)
+bool HistoryModel::urlIsStored(const QString &url)
 {
-    QSqlQuery query;
-    query.prepare("SELECT id, count, date, url, title FROM history WHERE id=?");
-    query.bindValue(0, index);
-    query.exec();
-    if (!query.next()) {
-        return;
+    foreach(const Visit & visit, m_pendingVisits) {
+        if (visit.url.toString() == url) {
+            return true;
+        }
     }
 
-    HistoryEntry entry;
-    entry.id = query.value(0).toInt();
-    entry.count = query.value(1).toInt();
-    entry.date = QDateTime::fromMSecsSinceEpoch(query.value(2).toLongLong());
-    entry.url = query.value(3).toUrl();
-    entry.title = query.value(4).toString();
-
-    query.prepare("DELETE FROM history WHERE id=?");
-    query.bindValue(0, index);
-    query.exec();
-    query.prepare("DELETE FROM icons WHERE url=?");
-    query.bindValue(0, entry.url.toEncoded(QUrl::RemoveFragment));
+    SqlQuery query("history");
+    query.prepare("SELECT id FROM history WHERE url=?");
+    query.bindValue(0, url);
     query.exec();
+    return query.next();
+}
+
+qreal HistoryModel::frecencyForVisit(VisitTransition transition, qint64 date)
+{
+    qreal weight;
+    switch (transition) {
+    case TypedTransition:
+        weight = 200;
+        break;
+    case BookmarkTransition:
+        weight = 150;
+        break;
+    default:
+        weight = 100;
+        break;
+    }
 
-    emit historyEntryDeleted(entry);
+    return weight * qPow(2.0, (date - FRECENCY_EPOCH) / FRECENCY_HALF_LIFE);
 }
 
-bool HistoryModel::urlIsStored(const QString &url)
+qreal HistoryModel::decayedFrecency(qreal frecency, qint64 now)
 {
-    QSqlQuery query;
-    query.prepare("SELECT id FROM history WHERE url=?");
-    query.bindValue(0, url);
-    query.exec();
-    return query.next();
+    return frecency / qPow(2.0, (now - FRECENCY_EPOCH) / FRECENCY_HALF_LIFE);
 }
 
 QList<HistoryEntry> HistoryModel::mostVisited(int count)
 {
-    QList<HistoryEntry> list;
-    QSqlQuery query;
-    query.exec(QString("SELECT count, date, id, title, url FROM history ORDER BY count DESC LIMIT %1").arg(count));
-    while (query.next()) {
-        HistoryEntry entry;
-        entry.count = query.value(0).toInt();
-        entry.date = query.value(1).toDateTime();
-        entry.id = query.value(2).toInt();
-        entry.title = query.value(3).toString();
-        entry.url = query.value(4).toUrl();
-        list.append(entry);
-    }
-    return list;
+    return m_cache->entries(HistoryCache::OrderByFrecency, count);
+}
+
+QList<HistoryEntry> HistoryModel::recentlyVisited(int count)
+{
+    return m_cache->entries(HistoryCache::OrderByDate, count);
+}
+
+HistoryCache* HistoryModel::cache() const
+{
+    return m_cache;
 }
 
 bool HistoryModel::optimizeHistory()
 {
-    QSqlQuery query;
-    return query.exec("VACUUM");
+    flushHistory();
+
+    bool ok = false;
+    QMetaObject::invokeMethod(m_writer, "optimizeDatabase", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, ok));
+    return ok;
+}
+
+void HistoryModel::pruneHistory()
+{
+    flushHistory();
+
+    QMetaObject::invokeMethod(m_writer, "pruneHistory", Qt::QueuedConnection,
+                              Q_ARG(int, m_maxAge), Q_ARG(int, m_maxEntries), Q_ARG(int, m_keepVisitCount));
+}
+
+HistoryModel::PruneReport HistoryModel::lastPruneReport() const
+{
+    return m_lastPruneReport;
+}
+
+void HistoryModel::pruneFinished(int entries, int visits, int icons, qint64 bytes, bool incrementalVacuum)
+{
+    m_lastPruneReport.entries = entries;
+    m_lastPruneReport.visits = visits;
+    m_lastPruneReport.icons = icons;
+    m_lastPruneReport.bytes = bytes;
+    m_lastPruneReport.incrementalVacuum = incrementalVacuum;
+
+    emit historyPruned();
 }
 
 bool HistoryModel::clearHistory()
 {
-    QSqlQuery query;
-    if (query.exec("DELETE FROM history")) {
+    m_flushTimer.stop();
+    m_pendingVisits.clear();
+
+    bool ok = false;
+    QMetaObject::invokeMethod(m_writer, "clearHistory", Qt::BlockingQueuedConnection, Q_RETURN_ARG(bool, ok));
+
+    if (ok) {
         emit historyClear();
-        return true;
     }
-    return false;
+    return ok;
+}
+
+void HistoryModel::clearHistory(const QDateTime &since)
+{
+    flushHistory();
+
+    // Deleted entries are announced one by one with historyEntryDeleted
+    QMetaObject::invokeMethod(m_writer, "deleteEntriesSince", Qt::BlockingQueuedConnection,
+                              Q_ARG(qint64, since.toMSecsSinceEpoch()));
 }
 
 void HistoryModel::setSaving(bool state)
@@ -22,6 +22,7 @@
 #include <QList>
 #include <QDateTime>
 #include <QUrl>
+#include <QBasicTimer>
 
 #include "qz_namespace.h"
 
@@ -29,12 +30,21 @@ class QIcon;
 
 class QupZilla;
 class WebView;
+class HistoryWriter;
+class HistoryCache;
 
 class QT_QUPZILLA_EXPORT HistoryModel : public QObject
 {
     Q_OBJECT
 public:
     HistoryModel(QupZilla* mainClass);
+    ~HistoryModel();
+
+    enum VisitTransition {
+        LinkTransition = 0,
+        TypedTransition = 1,
+        BookmarkTransition = 2
+    };
 
     struct HistoryEntry {
         int id;
@@ -42,43 +52,97 @@ public:
         QDateTime date;
         QUrl url;
         QString title;
+        qreal frecency;
+
+        HistoryEntry() : id(0), count(0), frecency(0) { }
+    };
+
+    struct Visit {
+        QUrl url;
+        QString title;
+        qint64 date;
+        int transition;
+    };
+
+    struct PruneReport {
+        int entries;
+        int visits;
+        int icons;
+        qint64 bytes;
+        // Without incremental auto_vacuum no space is reclaimed
+        bool incrementalVacuum;
+
+        PruneReport() : entries(0), visits(0), icons(0), bytes(0), incrementalVacuum(true) { }
     };
 
     static QString titleCaseLocalizedMonth(int month);
 
-    void addHistoryEntry(WebView* view);
-    void addHistoryEntry(const QUrl &url, QString title);
+    // Frecency is sum of points of all visits. Points of visit decay with
+    // its age, but instead of decaying stored values, new visits are given
+    // exponentially growing points. Order of entries then never changes
+    // with time and frecency can be updated incrementally with every visit.
+    static qreal frecencyForVisit(VisitTransition transition, qint64 date);
+    // Frecency expressed in points of visits made at the given time
+    static qreal decayedFrecency(qreal frecency, qint64 now);
+
+    void addHistoryEntry(WebView* view, VisitTransition transition = LinkTransition);
+    void addHistoryEntry(const QUrl &url, QString title, VisitTransition transition = LinkTransition);
 
     void deleteHistoryEntry(int index);
+    void deleteHistoryEntry(const QList<int> &list);
     void deleteHistoryEntry(const QString &url, const QString &title);
 
     bool urlIsStored(const QString &url);
 
+    // Both lists are served from memory, count should not exceed 30
     QList<HistoryEntry> mostVisited(int count);
+    QList<HistoryEntry> recentlyVisited(int count);
+    HistoryCache* cache() const;
 
     bool clearHistory();
+    // Deletes entries visited after date, returns after they are deleted
+    void clearHistory(const QDateTime &since);
     bool optimizeHistory();
+
+    // Deletes entries not allowed by retention policy in background
+    void pruneHistory();
+    PruneReport lastPruneReport() const;
     bool isSaving();
     void setSaving(bool state);
 
     void loadSettings();
 
+    // Visits are written in batches, with wait = true it returns
+    // after all visits are stored in database
+    void flushHistory(bool wait = false);
+
 private slots:
-    void slotAddHistoryEntry(const QUrl &url, QString title);
-    void slotDeleteHistoryEntry(int index);
+    void visitsWritten(const QList<HistoryEntry> &added, const QList<HistoryEntry> &edited);
+    void pruneFinished(int entries, int visits, int icons, qint64 bytes, bool incrementalVacuum);
 
 signals:
     void historyEntryAdded(HistoryEntry entry);
     void historyEntryDeleted(HistoryEntry entry);
     void historyEntryEdited(HistoryEntry before, HistoryEntry after);
-    //WARNING: Incomplete HistoryEntry structs are passed to historyEntryEdited!
+    //WARNING: Incomplete HistoryEntry struct is passed as before to historyEntryEdited!
     void historyClear();
-
-    void signalAddHistoryEntry(QUrl url, QString title);
-    void signalDeleteHistoryEntry(int index);
+    void historyPruned();
 
 private:
+    void timerEvent(QTimerEvent* event);
+
     bool m_isSaving;
+    int m_maxAge;
+    int m_maxEntries;
+    int m_keepVisitCount;
+    PruneReport m_lastPruneReport;
+
+    HistoryWriter* m_writer;
+    HistoryCache* m_cache;
+    QList<Visit> m_pendingVisits;
+    QBasicTimer m_flushTimer;
+    QBasicTimer m_pruneTimer;
+
     QupZilla* p_QupZilla;
 };
 
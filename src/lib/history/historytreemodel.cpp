@@ -0,0 +1,557 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "historytreemodel.h"
+#include "fulltextsearch.h"
+#include "iconprovider.h"
+#include "mainapplication.h"
+#include "sqlquery.h"
+
+#include <QCoreApplication>
+
+// Entries are fetched from database in pages of PAGE_SIZE
+#define PAGE_SIZE 100
+#define MAXIMUM_SEARCH_RESULTS 1000
+#define END_OF_TIME Q_INT64_C(0x7fffffffffffffff)
+
+static qint64 msecsForDate(const QDate &date)
+{
+    return QDateTime(date).toMSecsSinceEpoch();
+}
+
+HistoryTreeModel::HistoryTreeModel(HistoryModel* history, QObject* parent)
+    : QAbstractItemModel(parent)
+    , m_history(history)
+    , m_searchResults(0)
+    , m_bucketIcon(QIcon(":/icons/menu/history_entry.png"))
+{
+    connect(m_history, SIGNAL(historyEntryAdded(HistoryEntry)), this, SLOT(historyEntryAdded(HistoryEntry)));
+    connect(m_history, SIGNAL(historyEntryDeleted(HistoryEntry)), this, SLOT(historyEntryDeleted(HistoryEntry)));
+    connect(m_history, SIGNAL(historyEntryEdited(HistoryEntry, HistoryEntry)), this, SLOT(historyEntryEdited(HistoryEntry, HistoryEntry)));
+    connect(m_history, SIGNAL(historyClear()), this, SLOT(historyCleared()));
+    connect(mApp->iconProvider(), SIGNAL(iconLoaded(QUrl)), this, SLOT(iconLoaded(QUrl)));
+}
+
+HistoryTreeModel::~HistoryTreeModel()
+{
+    clearBuckets();
+}
+
+QModelIndex HistoryTreeModel::index(int row, int column, const QModelIndex &parent) const
+{
+    if (!hasIndex(row, column, parent)) {
+        return QModelIndex();
+    }
+
+    if (!parent.isValid()) {
+        return createIndex(row, column, m_searchResults);
+    }
+
+    return createIndex(row, column, m_buckets.at(parent.row()));
+}
+
+QModelIndex HistoryTreeModel::parent(const QModelIndex &index) const
+{
+    if (!index.isValid()) {
+        return QModelIndex();
+    }
+
+    Bucket* bucket = static_cast<Bucket*>(index.internalPointer());
+    if (!bucket || bucket == m_searchResults) {
+        return QModelIndex();
+    }
+
+    return indexForBucket(bucket);
+}
+
+int HistoryTreeModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.column() > 0) {
+        return 0;
+    }
+
+    if (!parent.isValid()) {
+        return m_searchResults ? m_searchResults->entries.count() : m_buckets.count();
+    }
+
+    Bucket* bucket = bucketForIndex(parent);
+    return bucket ? bucket->entries.count() : 0;
+}
+
+int HistoryTreeModel::columnCount(const QModelIndex &parent) const
+{
+    Q_UNUSED(parent)
+
+    return 2;
+}
+
+bool HistoryTreeModel::hasChildren(const QModelIndex &parent) const
+{
+    if (!parent.isValid()) {
+        return rowCount(parent) > 0;
+    }
+
+    Bucket* bucket = bucketForIndex(parent);
+    return bucket && bucket->count > 0;
+}
+
+QVariant HistoryTreeModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid()) {
+        return QVariant();
+    }
+
+    if (Bucket* bucket = bucketForIndex(index)) {
+        switch (role) {
+        case Qt::DisplayRole:
+            return index.column() == 0 ? bucket->title : QVariant();
+        case Qt::DecorationRole:
+            return index.column() == 0 ? m_bucketIcon : QVariant();
+        case IsBucketRole:
+            return true;
+        default:
+            return QVariant();
+        }
+    }
+
+    Bucket* parentBucket = static_cast<Bucket*>(index.internalPointer());
+    if (!parentBucket || index.row() >= parentBucket->entries.count()) {
+        return QVariant();
+    }
+
+    const Entry &entry = parentBucket->entries.at(index.row());
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::ToolTipRole:
+        return index.column() == 0 ? entry.title : QString(entry.url.toEncoded());
+    case Qt::DecorationRole:
+        if (index.column() != 0) {
+            return QVariant();
+        }
+        // Icons are loaded only for rows that are shown, default icon
+        // is replaced in iconLoaded()
+        if (entry.icon.isNull()) {
+            entry.icon = IconProvider::iconFromImage(mApp->iconProvider()->cachedIconForUrl(entry.url));
+        }
+        return entry.icon;
+    case IdRole:
+        return entry.id;
+    case UrlRole:
+        return entry.url;
+    case TitleRole:
+        return entry.title;
+    case IsBucketRole:
+        return false;
+    default:
+        return QVariant();
+    }
+}
+
+QVariant HistoryTreeModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractItemModel::headerData(section, orientation, role);
+    }
+
+    return section == 0 ? QCoreApplication::translate("HistoryManager", "Title")
+           : QCoreApplication::translate("HistoryManager", "Url");
+}
+
+bool HistoryTreeModel::canFetchMore(const QModelIndex &parent) const
+{
+    Bucket* bucket = bucketForIndex(parent);
+    return bucket && bucket->entries.count() < bucket->count;
+}
+
+void HistoryTreeModel::fetchMore(const QModelIndex &parent)
+{
+    Bucket* bucket = bucketForIndex(parent);
+    if (!bucket || bucket->entries.count() >= bucket->count) {
+        return;
+    }
+
+    // Next page starts after the last fetched entry
+    SqlQuery query("history");
+    if (bucket->entries.isEmpty()) {
+        query.prepare("SELECT id, title, url, date FROM history WHERE date >= ? AND date < ? "
+                      "ORDER BY date DESC, id DESC LIMIT ?");
+        query.addBindValue(bucket->start);
+        query.addBindValue(bucket->end);
+    }
+    else {
+        const Entry &last = bucket->entries.last();
+        query.prepare("SELECT id, title, url, date FROM history WHERE date >= ? AND (date < ? OR (date = ? AND id < ?)) "
+                      "ORDER BY date DESC, id DESC LIMIT ?");
+        query.addBindValue(bucket->start);
+        query.addBindValue(last.date);
+        query.addBindValue(last.date);
+        query.addBindValue(last.id);
+    }
+    query.addBindValue(PAGE_SIZE);
+    query.exec();
+
+    QList<Entry> entries;
+    while (query.next()) {
+        Entry entry;
+        entry.id = query.value(0).toInt();
+        entry.title = query.value(1).toString();
+        entry.url = query.value(2).toUrl();
+        entry.date = query.value(3).toLongLong();
+        entries.append(entry);
+    }
+
+    // Count may be outdated when entry was moved to other bucket by new visit
+    if (entries.count() < PAGE_SIZE) {
+        bucket->count = bucket->entries.count() + entries.count();
+    }
+
+    if (entries.isEmpty()) {
+        return;
+    }
+
+    beginInsertRows(parent, bucket->entries.count(), bucket->entries.count() + entries.count() - 1);
+    bucket->entries += entries;
+    endInsertRows();
+}
+
+QList<int> HistoryTreeModel::bucketEntryIds(const QModelIndex &index) const
+{
+    QList<int> list;
+
+    Bucket* bucket = bucketForIndex(index);
+    if (!bucket) {
+        return list;
+    }
+
+    SqlQuery query("history");
+    query.prepare("SELECT id FROM history WHERE date >= ? AND date < ?");
+    query.addBindValue(bucket->start);
+    query.addBindValue(bucket->end);
+    query.exec();
+
+    while (query.next()) {
+        list.append(query.value(0).toInt());
+    }
+
+    return list;
+}
+
+QString HistoryTreeModel::searchString() const
+{
+    return m_searchString;
+}
+
+void HistoryTreeModel::setSearchString(const QString &string)
+{
+    if (m_searchString == string) {
+        return;
+    }
+
+    m_searchString = string;
+    refresh();
+}
+
+void HistoryTreeModel::refresh()
+{
+    beginResetModel();
+    clearBuckets();
+
+    if (!m_searchString.isEmpty()) {
+        m_searchResults = new Bucket;
+        m_searchResults->start = 0;
+        m_searchResults->end = END_OF_TIME;
+
+        const QList<HistoryEntry> &list = FullTextSearch::searchHistory(m_searchString, MAXIMUM_SEARCH_RESULTS);
+        foreach(const HistoryEntry & historyEntry, list) {
+            Entry entry;
+            entry.id = historyEntry.id;
+            entry.title = historyEntry.title;
+            entry.url = historyEntry.url;
+            entry.date = historyEntry.date.toMSecsSinceEpoch();
+            m_searchResults->entries.append(entry);
+        }
+        m_searchResults->count = m_searchResults->entries.count();
+
+        endResetModel();
+        return;
+    }
+
+    const QDate today = QDate::currentDate();
+    const QDate startOfWeek = today.addDays(1 - today.dayOfWeek());
+    const QDate startOfMonth(today.year(), today.month(), 1);
+
+    const qint64 todayStart = msecsForDate(today);
+    const qint64 weekStart = msecsForDate(startOfWeek);
+    const qint64 monthStart = msecsForDate(startOfMonth);
+    const qint64 olderEnd = qMin(weekStart, monthStart);
+
+    Bucket* todayBucket = new Bucket;
+    todayBucket->title = QCoreApplication::translate("HistoryManager", "Today");
+    todayBucket->start = todayStart;
+    todayBucket->end = END_OF_TIME;
+    todayBucket->count = 0;
+
+    Bucket* weekBucket = new Bucket;
+    weekBucket->title = QCoreApplication::translate("HistoryManager", "This Week");
+    weekBucket->start = weekStart;
+    weekBucket->end = todayStart;
+    weekBucket->count = 0;
+
+    Bucket* monthBucket = new Bucket;
+    monthBucket->title = QCoreApplication::translate("HistoryManager", "This Month");
+    monthBucket->start = monthStart;
+    monthBucket->end = weekStart;
+    monthBucket->count = 0;
+
+    QList<Bucket*> buckets;
+    buckets << todayBucket << weekBucket << monthBucket;
+
+    // Only number of entries in every bucket is loaded
+    SqlQuery query("history");
+    query.prepare("SELECT CASE WHEN date >= ? THEN 0 WHEN date >= ? THEN 1 WHEN date >= ? THEN 2 ELSE 3 END AS bucket, "
+                  "CASE WHEN date < ? THEN strftime('%Y-%m', date / 1000, 'unixepoch', 'localtime') END AS month, "
+                  "count(*) FROM history GROUP BY bucket, month ORDER BY bucket ASC, month DESC");
+    query.addBindValue(todayStart);
+    query.addBindValue(weekStart);
+    query.addBindValue(monthStart);
+    query.addBindValue(olderEnd);
+    query.exec();
+
+    while (query.next()) {
+        int bucketType = query.value(0).toInt();
+        int count = query.value(2).toInt();
+
+        if (bucketType < 3) {
+            buckets.at(bucketType)->count += count;
+            continue;
+        }
+
+        const QDate date = QDate::fromString(query.value(1).toString(), "yyyy-MM");
+        if (!date.isValid()) {
+            continue;
+        }
+
+        Bucket* bucket = new Bucket;
+        bucket->title = QString("%1 %2").arg(HistoryModel::titleCaseLocalizedMonth(date.month()), QString::number(date.year()));
+        bucket->start = msecsForDate(date);
+        bucket->end = qMin(msecsForDate(date.addMonths(1)), olderEnd);
+        bucket->count = count;
+        buckets.append(bucket);
+    }
+
+    foreach(Bucket * bucket, buckets) {
+        if (bucket->count > 0) {
+            m_buckets.append(bucket);
+        }
+        else {
+            delete bucket;
+        }
+    }
+
+    endResetModel();
+}
+
+void HistoryTreeModel::historyEntryAdded(const HistoryEntry &historyEntry)
+{
+    // Search results are not updated
+    if (m_searchResults) {
+        return;
+    }
+
+    Entry entry;
+    entry.id = historyEntry.id;
+    entry.title = historyEntry.title;
+    entry.url = historyEntry.url;
+    entry.date = historyEntry.date.toMSecsSinceEpoch();
+
+    Bucket* bucket = bucketForDate(entry.date);
+    if (!bucket) {
+        bucket = new Bucket;
+        bucket->title = QCoreApplication::translate("HistoryManager", "Today");
+        bucket->start = msecsForDate(QDate::currentDate());
+        bucket->end = END_OF_TIME;
+        bucket->count = 0;
+
+        beginInsertRows(QModelIndex(), 0, 0);
+        m_buckets.prepend(bucket);
+        endInsertRows();
+    }
+
+    int position = 0;
+    while (position < bucket->entries.count() && bucket->entries.at(position).date > entry.date) {
+        ++position;
+    }
+
+    // Belongs to part of bucket that was not fetched yet
+    if (position == bucket->entries.count() && bucket->entries.count() < bucket->count) {
+        bucket->count++;
+        return;
+    }
+
+    beginInsertRows(indexForBucket(bucket), position, position);
+    bucket->entries.insert(position, entry);
+    bucket->count++;
+    endInsertRows();
+}
+
+void HistoryTreeModel::historyEntryDeleted(const HistoryEntry &entry)
+{
+    if (removeEntry(entry.id) || m_searchResults) {
+        return;
+    }
+
+    // Entry was not fetched yet
+    Bucket* bucket = bucketForDate(entry.date.toMSecsSinceEpoch());
+    if (!bucket) {
+        return;
+    }
+
+    bucket->count--;
+    if (bucket->count <= 0 && bucket->entries.isEmpty()) {
+        int row = m_buckets.indexOf(bucket);
+        beginRemoveRows(QModelIndex(), row, row);
+        delete m_buckets.takeAt(row);
+        endRemoveRows();
+    }
+}
+
+void HistoryTreeModel::historyEntryEdited(const HistoryEntry &before, const HistoryEntry &after)
+{
+    Q_UNUSED(before)
+
+    // Search results keep their order, matching entry is only updated
+    if (m_searchResults) {
+        for (int i = 0; i < m_searchResults->entries.count(); ++i) {
+            Entry &entry = m_searchResults->entries[i];
+            if (entry.id != after.id) {
+                continue;
+            }
+
+            entry.title = after.title;
+            entry.date = after.date.toMSecsSinceEpoch();
+            emit dataChanged(index(i, 0), index(i, 1));
+            return;
+        }
+        return;
+    }
+
+    // Entry is moved to the top of Today bucket. Before is incomplete, so
+    // when the entry was not fetched yet, count of its old bucket is not
+    // decremented here. The drift is accepted, fetchMore() corrects count
+    // once it gets fewer entries than expected.
+    removeEntry(after.id);
+    historyEntryAdded(after);
+}
+
+void HistoryTreeModel::historyCleared()
+{
+    refresh();
+}
+
+void HistoryTreeModel::iconLoaded(const QUrl &url)
+{
+    const QByteArray key = url.toEncoded();
+
+    QList<Bucket*> buckets = m_buckets;
+    if (m_searchResults) {
+        buckets.append(m_searchResults);
+    }
+
+    foreach(Bucket * bucket, buckets) {
+        for (int i = 0; i < bucket->entries.count(); ++i) {
+            const Entry &entry = bucket->entries.at(i);
+            if (entry.icon.isNull() || entry.url.toEncoded(QUrl::RemoveFragment) != key) {
+                continue;
+            }
+
+            entry.icon = QIcon();
+            const QModelIndex index = createIndex(i, 0, bucket);
+            emit dataChanged(index, index);
+        }
+    }
+}
+
+bool HistoryTreeModel::removeEntry(int id)
+{
+    QList<Bucket*> buckets = m_buckets;
+    if (m_searchResults) {
+        buckets.append(m_searchResults);
+    }
+
+    foreach(Bucket * bucket, buckets) {
+        for (int i = 0; i < bucket->entries.count(); ++i) {
+            if (bucket->entries.at(i).id != id) {
+                continue;
+            }
+
+            beginRemoveRows(indexForBucket(bucket), i, i);
+            bucket->entries.removeAt(i);
+            bucket->count--;
+            endRemoveRows();
+
+            if (bucket != m_searchResults && bucket->count <= 0 && bucket->entries.isEmpty()) {
+                int row = m_buckets.indexOf(bucket);
+                beginRemoveRows(QModelIndex(), row, row);
+                delete m_buckets.takeAt(row);
+                endRemoveRows();
+            }
+            return true;
+        }
+    }
+
+    return false;
+}
+
+HistoryTreeModel::Bucket* HistoryTreeModel::bucketForIndex(const QModelIndex &index) const
+{
+    // Only top level items without search are buckets
+    if (!index.isValid() || index.internalPointer() || index.row() >= m_buckets.count()) {
+        return 0;
+    }
+
+    return m_buckets.at(index.row());
+}
+
+HistoryTreeModel::Bucket* HistoryTreeModel::bucketForDate(qint64 date) const
+{
+    foreach(Bucket * bucket, m_buckets) {
+        if (date >= bucket->start && date < bucket->end) {
+            return bucket;
+        }
+    }
+
+    return 0;
+}
+
+QModelIndex HistoryTreeModel::indexForBucket(Bucket* bucket) const
+{
+    if (bucket == m_searchResults) {
+        return QModelIndex();
+    }
+
+    return createIndex(m_buckets.indexOf(bucket), 0);
+}
+
+void HistoryTreeModel::clearBuckets()
+{
+    qDeleteAll(m_buckets);
+    m_buckets.clear();
+
+    delete m_searchResults;
+    m_searchResults = 0;
+}
@@ -0,0 +1,104 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef HISTORYTREEMODEL_H
+#define HISTORYTREEMODEL_H
+
+#include <QAbstractItemModel>
+#include <QIcon>
+
+#include "qz_namespace.h"
+#include "historymodel.h"
+
+// History grouped into date buckets (Today, This Week, This Month and
+// months). Only number of entries in buckets is loaded at start, entries
+// are fetched from database in pages when bucket is expanded/scrolled.
+// With search string set, matching entries are shown as top level items.
+class QT_QUPZILLA_EXPORT HistoryTreeModel : public QAbstractItemModel
+{
+    Q_OBJECT
+public:
+    enum Roles {
+        IdRole = Qt::UserRole + 1,
+        UrlRole = Qt::UserRole + 2,
+        TitleRole = Qt::UserRole + 3,
+        IsBucketRole = Qt::UserRole + 4
+    };
+
+    explicit HistoryTreeModel(HistoryModel* history, QObject* parent = 0);
+    ~HistoryTreeModel();
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const;
+    QModelIndex parent(const QModelIndex &index) const;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    bool hasChildren(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const;
+
+    bool canFetchMore(const QModelIndex &parent) const;
+    void fetchMore(const QModelIndex &parent);
+
+    // Ids of all entries in bucket, including not yet fetched
+    QList<int> bucketEntryIds(const QModelIndex &index) const;
+
+    QString searchString() const;
+
+public slots:
+    void refresh();
+    void setSearchString(const QString &string);
+
+private slots:
+    void historyEntryAdded(const HistoryEntry &entry);
+    void historyEntryDeleted(const HistoryEntry &entry);
+    void historyEntryEdited(const HistoryEntry &before, const HistoryEntry &after);
+    void historyCleared();
+    void iconLoaded(const QUrl &url);
+
+private:
+    struct Entry {
+        int id;
+        QString title;
+        QUrl url;
+        qint64 date;
+        mutable QIcon icon;
+    };
+
+    struct Bucket {
+        QString title;
+        qint64 start;
+        qint64 end;
+        // Number of entries in database, fetched entries are sorted by date
+        int count;
+        QList<Entry> entries;
+    };
+
+    Bucket* bucketForIndex(const QModelIndex &index) const;
+    Bucket* bucketForDate(qint64 date) const;
+    QModelIndex indexForBucket(Bucket* bucket) const;
+    void clearBuckets();
+    bool removeEntry(int id);
+
+    HistoryModel* m_history;
+    QList<Bucket*> m_buckets;
+    // Root of the tree when searching
+    Bucket* m_searchResults;
+    QString m_searchString;
+    QIcon m_bucketIcon;
+};
+
+#endif // HISTORYTREEMODEL_H
@@ -0,0 +1,462 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "historywriter.h"
+#include "databaseexecutor.h"
+#include "sqlquery.h"
+
+#include <QSqlDatabase>
+#include <QHash>
+#include <QDebug>
+
+#include <climits>
+
+// Pruning deletes at most PRUNE_BATCH_SIZE entries in one transaction and
+// returns at most PRUNE_VACUUM_PAGES free pages to filesystem after each batch
+#define PRUNE_BATCH_SIZE 200
+#define PRUNE_VACUUM_PAGES 100
+
+HistoryWriter::HistoryWriter()
+    : QObject()
+{
+    m_prune.running = false;
+    m_prune.pageUrlsLoaded = false;
+}
+
+void HistoryWriter::writeVisits(const QList<HistoryModel::Visit> &visits)
+{
+    if (visits.isEmpty()) {
+        return;
+    }
+
+    // Visits of the same url are merged into one entry
+    QList<HistoryEntry> entries;
+    QList<QList<HistoryModel::Visit> > entryVisits;
+    QHash<QString, int> entryIndexes;
+
+    foreach(const HistoryModel::Visit & visit, visits) {
+        const QString url = visit.url.toString();
+        int index = entryIndexes.value(url, -1);
+
+        // Icons of new pages must not be taken for orphans by running pruning
+        if (m_prune.pageUrlsLoaded) {
+            m_prune.pageUrls.insert(iconKey(visit.url));
+        }
+
+        if (index == -1) {
+            index = entries.count();
+            entryIndexes.insert(url, index);
+            entries.append(HistoryEntry());
+            entryVisits.append(QList<HistoryModel::Visit>());
+        }
+
+        HistoryEntry &entry = entries[index];
+        entry.url = visit.url;
+        entry.title = visit.title;
+        entry.date = QDateTime::fromMSecsSinceEpoch(visit.date);
+        entry.count++;
+        entry.frecency += HistoryModel::frecencyForVisit(HistoryModel::VisitTransition(visit.transition), visit.date);
+
+        entryVisits[index].append(visit);
+    }
+
+    QSqlDatabase db = DatabaseExecutor::database();
+    db.transaction();
+
+    // Insert or update (historyUrl index is unique)
+    SqlQuery insertQuery("history", db);
+    insertQuery.prepare("INSERT OR IGNORE INTO history (count, date, url, title, frecency) VALUES (0,?,?,?,0)");
+    SqlQuery updateQuery("history", db);
+    updateQuery.prepare("UPDATE history SET count = count + ?, date=?, title=?, frecency = frecency + ? WHERE url=?");
+    SqlQuery selectQuery("history", db);
+    selectQuery.prepare("SELECT id, count, frecency FROM history WHERE url=?");
+    SqlQuery visitQuery("history", db);
+    visitQuery.prepare("INSERT INTO visits (history_id, date, transition) VALUES (?,?,?)");
+
+    QList<HistoryEntry> added;
+    QList<HistoryEntry> edited;
+
+    for (int i = 0; i < entries.count(); ++i) {
+        HistoryEntry entry = entries.at(i);
+        const qint64 date = entry.date.toMSecsSinceEpoch();
+
+        insertQuery.bindValue(0, date);
+        insertQuery.bindValue(1, entry.url);
+        insertQuery.bindValue(2, entry.title);
+        insertQuery.exec();
+        bool inserted = insertQuery.numRowsAffected() > 0;
+
+        updateQuery.bindValue(0, entry.count);
+        updateQuery.bindValue(1, date);
+        updateQuery.bindValue(2, entry.title);
+        updateQuery.bindValue(3, entry.frecency);
+        updateQuery.bindValue(4, entry.url);
+        updateQuery.exec();
+
+        selectQuery.bindValue(0, entry.url);
+        selectQuery.exec();
+        if (!selectQuery.next()) {
+            continue;
+        }
+
+        entry.id = selectQuery.value(0).toInt();
+        entry.count = selectQuery.value(1).toInt();
+        entry.frecency = selectQuery.value(2).toDouble();
+
+        foreach(const HistoryModel::Visit & visit, entryVisits.at(i)) {
+            visitQuery.bindValue(0, entry.id);
+            visitQuery.bindValue(1, visit.date);
+            visitQuery.bindValue(2, visit.transition);
+            visitQuery.exec();
+        }
+
+        if (inserted) {
+            added.append(entry);
+        }
+        else {
+            edited.append(entry);
+        }
+    }
+
+    if (!db.commit()) {
+        qWarning() << "HistoryWriter::writeVisits cannot commit" << visits.count() << "visits";
+        db.rollback();
+        return;
+    }
+
+    emit visitsWritten(added, edited);
+}
+
+void HistoryWriter::deleteEntries(const QList<int> &ids)
+{
+    QSqlDatabase db = DatabaseExecutor::database();
+    db.transaction();
+
+    const QList<HistoryEntry> deleted = removeEntries(db, ids);
+
+    if (!db.commit()) {
+        qWarning() << "HistoryWriter::deleteEntries cannot commit" << ids.count() << "deletions";
+        db.rollback();
+        return;
+    }
+
+    foreach(const HistoryEntry & entry, deleted) {
+        emit entryDeleted(entry);
+    }
+}
+
+void HistoryWriter::deleteEntriesSince(qint64 date)
+{
+    QSqlDatabase db = DatabaseExecutor::database();
+    db.transaction();
+
+    SqlQuery query("history", db);
+    query.prepare("SELECT id FROM history WHERE date > ?");
+    query.addBindValue(date);
+    query.exec();
+
+    QList<int> ids;
+    while (query.next()) {
+        ids.append(query.value(0).toInt());
+    }
+    query.finish();
+
+    const QList<HistoryEntry> deleted = removeEntries(db, ids);
+
+    // Recent visits of entries last visited before date
+    query.prepare("DELETE FROM visits WHERE date > ?");
+    query.addBindValue(date);
+    query.exec();
+
+    if (!db.commit()) {
+        qWarning() << "HistoryWriter::deleteEntriesSince cannot commit" << ids.count() << "deletions";
+        db.rollback();
+        return;
+    }
+
+    foreach(const HistoryEntry & entry, deleted) {
+        emit entryDeleted(entry);
+    }
+}
+
+QList<HistoryEntry> HistoryWriter::removeEntries(QSqlDatabase db, const QList<int> &ids, int* visits)
+{
+    SqlQuery selectQuery("history", db);
+    selectQuery.prepare("SELECT id, count, date, url, title, frecency FROM history WHERE id=?");
+    SqlQuery deleteQuery("history", db);
+    deleteQuery.prepare("DELETE FROM history WHERE id=?");
+    SqlQuery visitsQuery("history", db);
+    visitsQuery.prepare("DELETE FROM visits WHERE history_id=?");
+
+    QList<HistoryEntry> deleted;
+
+    foreach(int id, ids) {
+        selectQuery.bindValue(0, id);
+        selectQuery.exec();
+        if (!selectQuery.next()) {
+            continue;
+        }
+
+        HistoryEntry entry;
+        entry.id = selectQuery.value(0).toInt();
+        entry.count = selectQuery.value(1).toInt();
+        entry.date = QDateTime::fromMSecsSinceEpoch(selectQuery.value(2).toLongLong());
+        entry.url = selectQuery.value(3).toUrl();
+        entry.title = selectQuery.value(4).toString();
+        entry.frecency = selectQuery.value(5).toDouble();
+        selectQuery.finish();
+
+        // Icon is kept, page may still be bookmarked or stored with another
+        // fragment. Icons of removed pages are deleted by pruning.
+        deleteQuery.bindValue(0, id);
+        deleteQuery.exec();
+        visitsQuery.bindValue(0, id);
+        visitsQuery.exec();
+
+        if (visits) {
+            *visits += qMax(0, visitsQuery.numRowsAffected());
+        }
+
+        deleted.append(entry);
+    }
+
+    return deleted;
+}
+
+void HistoryWriter::pruneHistory(int maxAge, int maxEntries, int keepVisitCount)
+{
+    if (m_prune.running || (maxAge <= 0 && maxEntries <= 0)) {
+        return;
+    }
+
+    QSqlDatabase db = DatabaseExecutor::database();
+    SqlQuery query("history", db);
+
+    qint64 cutoffDate = 0;
+    if (maxAge > 0) {
+        cutoffDate = QDateTime::currentMSecsSinceEpoch() - qint64(maxAge) * 24 * 60 * 60 * 1000;
+    }
+
+    if (maxEntries > 0) {
+        // Date of the newest entry over the limit, it and all older entries are pruned
+        query.prepare("SELECT date FROM history ORDER BY date DESC LIMIT 1 OFFSET ?");
+        query.addBindValue(maxEntries);
+        query.exec();
+        if (query.next()) {
+            cutoffDate = qMax(cutoffDate, query.value(0).toLongLong() + 1);
+        }
+    }
+
+    if (cutoffDate == 0) {
+        return;
+    }
+
+    m_prune.running = true;
+    m_prune.cutoffDate = cutoffDate;
+    m_prune.keepVisitCount = keepVisitCount > 0 ? keepVisitCount : INT_MAX;
+    m_prune.sizeBefore = databaseSize(db);
+    m_prune.entries = 0;
+    m_prune.visits = 0;
+    m_prune.icons = 0;
+    m_prune.lastIconRowid = 0;
+
+    QMetaObject::invokeMethod(this, "pruneBatch", Qt::QueuedConnection);
+}
+
+void HistoryWriter::pruneBatch()
+{
+    if (!m_prune.running) {
+        return;
+    }
+
+    QSqlDatabase db = DatabaseExecutor::database();
+    db.transaction();
+
+    SqlQuery query("history", db);
+    query.prepare("SELECT id FROM history WHERE date < ? AND count < ? LIMIT ?");
+    query.addBindValue(m_prune.cutoffDate);
+    query.addBindValue(m_prune.keepVisitCount);
+    query.addBindValue(PRUNE_BATCH_SIZE);
+    query.exec();
+
+    QList<int> ids;
+    while (query.next()) {
+        ids.append(query.value(0).toInt());
+    }
+    query.finish();
+
+    QList<HistoryEntry> deleted = removeEntries(db, ids, &m_prune.visits);
+    int removedRows = deleted.count();
+
+    if (ids.isEmpty()) {
+        // Old visits of kept entries, their frecency is already stored in history
+        query.prepare("DELETE FROM visits WHERE id IN (SELECT id FROM visits WHERE date < ? LIMIT ?)");
+        query.addBindValue(m_prune.cutoffDate);
+        query.addBindValue(PRUNE_BATCH_SIZE);
+        query.exec();
+        removedRows = qMax(0, query.numRowsAffected());
+        m_prune.visits += removedRows;
+    }
+
+    if (removedRows == 0) {
+        // Icons of pages that are neither in history nor in bookmarks, icon
+        // urls are scanned in batches and compared with urls in memory
+        if (!m_prune.pageUrlsLoaded) {
+            loadPageUrls(db);
+        }
+
+        query.prepare("SELECT rowid, url FROM icon_urls WHERE rowid > ? ORDER BY rowid LIMIT ?");
+        query.addBindValue(m_prune.lastIconRowid);
+        query.addBindValue(PRUNE_BATCH_SIZE);
+        query.exec();
+
+        QList<qint64> orphans;
+        while (query.next()) {
+            m_prune.lastIconRowid = query.value(0).toLongLong();
+            if (!m_prune.pageUrls.contains(query.value(1).toString().toUtf8())) {
+                orphans.append(m_prune.lastIconRowid);
+            }
+            ++removedRows;
+        }
+        query.finish();
+
+        query.prepare("DELETE FROM icon_urls WHERE rowid=?");
+        foreach(qint64 rowid, orphans) {
+            query.bindValue(0, rowid);
+            query.exec();
+            m_prune.icons += qMax(0, query.numRowsAffected());
+        }
+    }
+
+    if (removedRows == 0) {
+        // Icon data no longer used by any page or host
+        query.prepare("DELETE FROM icon_data WHERE id IN (SELECT id FROM icon_data WHERE "
+                      "NOT EXISTS (SELECT 1 FROM icon_urls WHERE icon_urls.data_id = icon_data.id) AND "
+                      "NOT EXISTS (SELECT 1 FROM icon_hosts WHERE icon_hosts.data_id = icon_data.id) LIMIT ?)");
+        query.addBindValue(PRUNE_BATCH_SIZE);
+        query.exec();
+        removedRows = qMax(0, query.numRowsAffected());
+    }
+
+    if (!db.commit()) {
+        qWarning() << "HistoryWriter::pruneBatch cannot commit, pruning stopped";
+        db.rollback();
+        deleted.clear();
+        removedRows = 0;
+    }
+
+    m_prune.entries += deleted.count();
+    foreach(const HistoryEntry & entry, deleted) {
+        emit entryDeleted(entry);
+    }
+
+    // Does nothing with databases not in incremental auto_vacuum mode
+    query.exec(QString("PRAGMA incremental_vacuum(%1)").arg(PRUNE_VACUUM_PAGES));
+    while (query.next()) {
+    }
+
+    if (removedRows > 0) {
+        QMetaObject::invokeMethod(this, "pruneBatch", Qt::QueuedConnection);
+        return;
+    }
+
+    // Return rest of free pages
+    query.exec("PRAGMA incremental_vacuum");
+    while (query.next()) {
+    }
+
+    // Profiles created by older versions are not in incremental mode
+    // until the database is optimized, their free pages are kept in file
+    query.exec("PRAGMA auto_vacuum");
+    const bool incrementalVacuum = query.next() && query.value(0).toInt() == 2;
+
+    m_prune.running = false;
+    m_prune.pageUrls.clear();
+    m_prune.pageUrlsLoaded = false;
+    const qint64 bytes = qMax(Q_INT64_C(0), m_prune.sizeBefore - databaseSize(db));
+
+    emit historyPruned(m_prune.entries, m_prune.visits, m_prune.icons, bytes, incrementalVacuum);
+}
+
+bool HistoryWriter::optimizeDatabase()
+{
+    QSqlDatabase db = DatabaseExecutor::database();
+    SqlQuery query("history", db);
+
+    query.exec("PRAGMA auto_vacuum");
+    if (query.next() && query.value(0).toInt() == 2) {
+        query.exec("PRAGMA incremental_vacuum");
+        while (query.next()) {
+        }
+        return true;
+    }
+
+    // Switching to incremental mode requires one full VACUUM, all later
+    // space is then returned in small steps after pruning
+    query.exec("PRAGMA auto_vacuum = INCREMENTAL");
+    return query.exec("VACUUM");
+}
+
+void HistoryWriter::loadPageUrls(QSqlDatabase db)
+{
+    m_prune.pageUrls.clear();
+
+    SqlQuery query("history", db);
+    query.exec("SELECT url FROM history");
+    while (query.next()) {
+        m_prune.pageUrls.insert(iconKey(QUrl(query.value(0).toString())));
+    }
+
+    query.exec("SELECT url FROM bookmarks");
+    while (query.next()) {
+        m_prune.pageUrls.insert(iconKey(QUrl(query.value(0).toString())));
+    }
+
+    m_prune.pageUrlsLoaded = true;
+}
+
+QByteArray HistoryWriter::iconKey(const QUrl &url)
+{
+    return url.toEncoded(QUrl::RemoveFragment);
+}
+
+qint64 HistoryWriter::databaseSize(QSqlDatabase db)
+{
+    SqlQuery query("history", db);
+    query.exec("PRAGMA page_count");
+    const qint64 pageCount = query.next() ? query.value(0).toLongLong() : 0;
+    query.exec("PRAGMA page_size");
+    const qint64 pageSize = query.next() ? query.value(0).toLongLong() : 0;
+
+    return pageCount * pageSize;
+}
+
+bool HistoryWriter::clearHistory()
+{
+    QSqlDatabase db = DatabaseExecutor::database();
+    db.transaction();
+
+    SqlQuery query("history", db);
+    bool ok = query.exec("DELETE FROM history");
+    query.exec("DELETE FROM visits");
+
+    return db.commit() && ok;
+}
+
+void HistoryWriter::sync()
+{
+}
@@ -0,0 +1,88 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef HISTORYWRITER_H
+#define HISTORYWRITER_H
+
+#include <QObject>
+#include <QSet>
+
+#include "qz_namespace.h"
+#include "historymodel.h"
+
+class QSqlDatabase;
+
+// Lives in DatabaseExecutor's thread and does all writes to history
+// tables using its database connection.
+class QT_QUPZILLA_EXPORT HistoryWriter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit HistoryWriter();
+
+public slots:
+    void writeVisits(const QList<HistoryModel::Visit> &visits);
+    void deleteEntries(const QList<int> &ids);
+    // Deletes entries visited after date (in ms since epoch)
+    void deleteEntriesSince(qint64 date);
+    bool clearHistory();
+
+    // Starts pruning of entries according to retention policy. Entries are
+    // deleted in small batches, so visits can be written in between.
+    // maxAge is in days, 0 values disable the limit. Entries visited at
+    // least keepVisitCount times are never pruned.
+    void pruneHistory(int maxAge, int maxEntries, int keepVisitCount);
+    bool optimizeDatabase();
+
+    // Empty slot, blocking invocation waits for all previous requests
+    void sync();
+
+signals:
+    void visitsWritten(const QList<HistoryEntry> &added, const QList<HistoryEntry> &edited);
+    void entryDeleted(const HistoryEntry &entry);
+    void historyPruned(int entries, int visits, int icons, qint64 bytes, bool incrementalVacuum);
+
+private slots:
+    void pruneBatch();
+
+private:
+    QList<HistoryEntry> removeEntries(QSqlDatabase db, const QList<int> &ids, int* visits = 0);
+    qint64 databaseSize(QSqlDatabase db);
+    void loadPageUrls(QSqlDatabase db);
+
+    // Icons are keyed by encoded url without fragment, history and
+    // bookmarks store urls as strings, so they are compared in this form
+    static QByteArray iconKey(const QUrl &url);
+
+    struct PruneJob {
+        bool running;
+        qint64 cutoffDate;
+        int keepVisitCount;
+        qint64 sizeBefore;
+        int entries;
+        int visits;
+        int icons;
+        // Urls of all pages in history and bookmarks as icon keys,
+        // loaded when orphaned icons are looked for
+        QSet<QByteArray> pageUrls;
+        bool pageUrlsLoaded;
+        qint64 lastIconRowid;
+    };
+    PruneJob m_prune;
+};
+
+#endif // HISTORYWRITER_H
@@ -18,18 +18,113 @@
 #include "webhistoryinterface.h"
 #include "mainapplication.h"
 #include "historymodel.h"
+#include "sqlquery.h"
+
+#include <QSqlDatabase>
+#include <QUrl>
+#include <QtConcurrentRun>
+#include <QDebug>
 
 WebHistoryInterface::WebHistoryInterface(QObject* parent)
     : QWebHistoryInterface(parent)
+    , m_watcher(new QFutureWatcher<QSet<quint64> >(this))
+    , m_clearedWhileLoading(false)
 {
+    HistoryModel* historyModel = mApp->history();
+    connect(historyModel, SIGNAL(historyEntryDeleted(HistoryEntry)), this, SLOT(historyEntryDeleted(HistoryEntry)));
+    connect(historyModel, SIGNAL(historyClear()), this, SLOT(historyCleared()));
+
+    connect(m_watcher, SIGNAL(finished()), this, SLOT(loadingFinished()));
+    m_watcher->setFuture(QtConcurrent::run(&WebHistoryInterface::loadFingerprints, mApp->getActiveProfilPath() + "browsedata.db"));
 }
 
 void WebHistoryInterface::addHistoryEntry(const QString &url)
 {
-    m_clickedLinks.append(url);
+    m_visitedLinks.insert(fingerprint(url));
 }
 
 bool WebHistoryInterface::historyContains(const QString &url) const
 {
-    return m_clickedLinks.contains(url);
+    return m_visitedLinks.contains(fingerprint(url));
+}
+
+quint64 WebHistoryInterface::fingerprint(const QString &url)
+{
+    // 64-bit FNV-1a, probability of collision is negligible even
+    // for millions of urls, so no exact check is needed
+    quint64 hash = Q_UINT64_C(14695981039346656037);
+
+    const ushort* data = url.utf16();
+    const int length = url.length();
+    for (int i = 0; i < length; ++i) {
+        hash ^= data[i] & 0xff;
+        hash *= Q_UINT64_C(1099511628211);
+        hash ^= data[i] >> 8;
+        hash *= Q_UINT64_C(1099511628211);
+    }
+
+    return hash;
+}
+
+QSet<quint64> WebHistoryInterface::loadFingerprints(const QString &databaseFile)
+{
+    const QString connectionName = QLatin1String("WebHistoryInterface");
+    QSet<quint64> set;
+
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        db.setDatabaseName(databaseFile);
+
+        if (db.open()) {
+            SqlQuery query("history", db);
+            query.exec("SELECT url FROM history");
+            while (query.next()) {
+                // WebKit asks with urls in encoded form
+                const QUrl url(query.value(0).toString());
+                set.insert(fingerprint(QString::fromLatin1(url.toEncoded())));
+            }
+        }
+        else {
+            qWarning() << "WebHistoryInterface::loadFingerprints cannot open database" << databaseFile;
+        }
+
+        db.close();
+    }
+
+    QSqlDatabase::removeDatabase(connectionName);
+
+    return set;
+}
+
+void WebHistoryInterface::loadingFinished()
+{
+    // Links visited before loading finished are kept, loaded set may
+    // still contain entries deleted by Clear Private Data in the meantime
+    if (!m_clearedWhileLoading) {
+        m_visitedLinks.unite(m_watcher->result().subtract(m_deletedWhileLoading));
+    }
+    m_watcher->setFuture(QFuture<QSet<quint64> >());
+
+    m_deletedWhileLoading.clear();
+    m_clearedWhileLoading = false;
+}
+
+void WebHistoryInterface::historyEntryDeleted(const HistoryEntry &entry)
+{
+    const quint64 hash = fingerprint(QString::fromLatin1(entry.url.toEncoded()));
+    m_visitedLinks.remove(hash);
+
+    if (m_watcher->isRunning()) {
+        m_deletedWhileLoading.insert(hash);
+    }
+}
+
+void WebHistoryInterface::historyCleared()
+{
+    m_visitedLinks.clear();
+
+    if (m_watcher->isRunning()) {
+        m_clearedWhileLoading = true;
+        m_deletedWhileLoading.clear();
+    }
 }
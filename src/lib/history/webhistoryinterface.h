@@ -19,21 +19,41 @@
 #define WEBHISTORYINTERFACE_H
 
 #include <QWebHistoryInterface>
-#include <QStringList>
+#include <QFutureWatcher>
+#include <QSet>
 
 #include "qz_namespace.h"
+#include "historymodel.h"
 
+// Visited links are stored as 64-bit fingerprints of their urls, so
+// the lookup done by WebKit for every link on page is constant time.
+// Set is seeded from history database in background thread.
 class QT_QUPZILLA_EXPORT WebHistoryInterface : public QWebHistoryInterface
 {
+    Q_OBJECT
 public:
     explicit WebHistoryInterface(QObject* parent = 0);
 
     void addHistoryEntry(const QString &url);
     bool historyContains(const QString &url) const;
 
+    static quint64 fingerprint(const QString &url);
+
+private slots:
+    void loadingFinished();
+
+    void historyEntryDeleted(const HistoryEntry &entry);
+    void historyCleared();
+
 private:
-    QStringList m_clickedLinks;
+    static QSet<quint64> loadFingerprints(const QString &databaseFile);
+
+    QSet<quint64> m_visitedLinks;
+    QFutureWatcher<QSet<quint64> >* m_watcher;
 
+    // History changes made while the set is being loaded
+    QSet<quint64> m_deletedWhileLoading;
+    bool m_clearedWhileLoading;
 };
 
 #endif // WEBHISTORYINTERFACE_H
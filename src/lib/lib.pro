@@ -145,7 +145,7 @@ SOURCES += \
     webview/webhistorywrapper.cpp \
     tools/pagethumbnailer.cpp \
     plugins/speeddial.cpp \
-    other/databasewriter.cpp \
+    other/databaseexecutor.cpp \
     bookmarksimport/htmlimporter.cpp \
     tools/enhancedmenu.cpp \
     navigation/siteicon.cpp \
@@ -165,7 +165,20 @@ SOURCES += \
     preferences/pluginlistdelegate.cpp \
     popupwindow/popupstatusbarmessage.cpp \
     other/licenseviewer.cpp \
-    bookmarksimport/bookmarksimporticonfetcher.cpp
+    bookmarksimport/bookmarksimporticonfetcher.cpp \
+    network/cacertificatesloader.cpp \
+    downloads/downloadsegment.cpp \
+    downloads/downloadwriter.cpp \
+    downloads/downloadchecksum.cpp \
+    tools/sha256hash.cpp \
+    navigation/locationcompleterindex.cpp \
+    navigation/locationcompletermodel.cpp \
+    history/historywriter.cpp \
+    tools/fulltextsearch.cpp \
+    history/historytreemodel.cpp \
+    history/historycache.cpp \
+    other/databaseprofiler.cpp \
+    other/sqlquery.cpp
 
 HEADERS  += \
     3rdparty/qtwin.h \
@@ -281,7 +294,7 @@ HEADERS  += \
     webview/webhistorywrapper.h \
     tools/pagethumbnailer.h \
     plugins/speeddial.h \
-    other/databasewriter.h \
+    other/databaseexecutor.h \
     bookmarksimport/htmlimporter.h \
     tools/enhancedmenu.h \
     navigation/siteicon.h \
@@ -302,7 +315,20 @@ HEADERS  += \
     preferences/pluginlistdelegate.h \
     popupwindow/popupstatusbarmessage.h \
     other/licenseviewer.h \
-    bookmarksimport/bookmarksimporticonfetcher.h
+    bookmarksimport/bookmarksimporticonfetcher.h \
+    network/cacertificatesloader.h \
+    downloads/downloadsegment.h \
+    downloads/downloadwriter.h \
+    downloads/downloadchecksum.h \
+    tools/sha256hash.h \
+    navigation/locationcompleterindex.h \
+    navigation/locationcompletermodel.h \
+    history/historywriter.h \
+    tools/fulltextsearch.h \
+    history/historytreemodel.h \
+    history/historycache.h \
+    other/databaseprofiler.h \
+    other/sqlquery.h
 
 FORMS    += \
     preferences/autofillmanager.ui \
@@ -17,21 +17,24 @@
 * ============================================================ */
 #include "locationcompleter.h"
 #include "locationbar.h"
-#include "iconprovider.h"
 #include "mainapplication.h"
+#include "locationcompleterindex.h"
+#include "locationcompletermodel.h"
 
-#include <QStandardItemModel>
 #include <QTreeView>
 #include <QHeaderView>
-#include <QSqlQuery>
 
 LocationCompleter::LocationCompleter(QObject* parent)
     : QCompleter(parent)
+    , m_model(new LocationCompleterModel(this))
+    , m_watcher(new QFutureWatcher<LocationCompleterIndex::SearchResult>(this))
+    , m_generation(new QAtomicInt(0))
+    , m_searchPending(false)
+    , m_mostVisitedPending(false)
 {
     setMaxVisibleItems(6);
-    QStandardItemModel* completeModel = new QStandardItemModel();
 
-    setModel(completeModel);
+    setModel(m_model);
     QTreeView* treeView = new QTreeView;
 
     setPopup(treeView);
@@ -45,70 +48,48 @@ LocationCompleter::LocationCompleter(QObject* parent)
     setCaseSensitivity(Qt::CaseInsensitive);
     setWrapAround(true);
     setCompletionColumn(1);
+
+    connect(m_watcher, SIGNAL(finished()), this, SLOT(searchFinished()));
+    connect(mApp->completerIndex(), SIGNAL(indexReady()), this, SLOT(startSearch()));
 }
 
 QStringList LocationCompleter::splitPath(const QString &path) const
 {
     Q_UNUSED(path);
     return QStringList("");
-#if 0
-    QStringList returned = QCompleter::splitPath(path);
-    QStringList returned2;
-    QSqlQuery query;
-    query.exec("SELECT url FROM history WHERE title LIKE '%" + path + "%' OR url LIKE '%" + path + "%' ORDER BY count DESC LIMIT 1");
-    if (query.next()) {
-        QString url = query.value(0).toString();
-        bool titleSearching = false;
-        if (!url.contains(path)) {
-            titleSearching = true;
-        }
-        QString prefix = url.mid(0, url.indexOf(path));
-        foreach(const QString & string, returned) {
-            if (titleSearching) {
-                returned2.append(url);
-            }
-            else {
-                returned2.append(prefix + string);
-            }
-        }
-        return returned2;
+}
+
+void LocationCompleter::showEntries(const QList<LocationCompleterIndex::Entry> &entries)
+{
+    m_model->setEntries(entries, maxVisibleItems());
+
+    QTreeView* treeView = qobject_cast<QTreeView*>(popup());
+    treeView->header()->setResizeMode(0, QHeaderView::Stretch);
+    treeView->header()->resizeSection(1, 0);
+
+    if (m_model->entriesCount() > maxVisibleItems()) {
+        popup()->setMinimumHeight(190);
     }
     else {
-        foreach(const QString & string, returned)
-        returned2.append("http://www.google.com/search?client=qupzilla&q=" + string);
-        return returned2;
+        popup()->setMinimumHeight(0);
     }
-#endif
+
+    popup()->setUpdatesEnabled(true);
 }
 
 void LocationCompleter::showMostVisited()
 {
-    QSqlQuery query;
-    query.exec("SELECT title, url FROM history ORDER BY count DESC LIMIT 15");
-    int i = 0;
-    QStandardItemModel* cModel = qobject_cast<QStandardItemModel*>(model());
-    QTreeView* treeView = qobject_cast<QTreeView*>(popup());
+    m_generation->ref();
+    m_searchPending = false;
 
-    cModel->clear();
-    while (query.next()) {
-        QStandardItem* iconText = new QStandardItem();
-        QStandardItem* findUrl = new QStandardItem();
-        QString url = query.value(1).toUrl().toEncoded();
-
-        iconText->setIcon(_iconForUrl(query.value(1).toUrl()).pixmap(16, 16));
-        iconText->setText(query.value(0).toString().replace("\n", "").append("\n" + url));
-
-        findUrl->setText(url);
-        QList<QStandardItem*> items;
-        items.append(iconText);
-        items.append(findUrl);
-        cModel->insertRow(i, items);
-        i++;
+    LocationCompleterIndex* index = mApp->completerIndex();
+    if (!index->isReady()) {
+        m_mostVisitedPending = true;
+        return;
     }
 
-    treeView->header()->setResizeMode(0, QHeaderView::Stretch);
-    treeView->header()->resizeSection(1, 0);
-
+    m_mostVisitedPending = false;
+    showEntries(index->topEntries(15));
     popup()->setMinimumHeight(190);
 
     QCompleter::complete();
@@ -116,60 +97,47 @@ void LocationCompleter::showMostVisited()
 
 void LocationCompleter::refreshCompleter(const QString &string)
 {
-    int limit;
-    if (string.size() < 3) {
-        limit = 25;
-    }
-    else {
-        limit = 15;
-    }
+    // Invalidates search that may be still running
+    m_generation->ref();
 
-    QSqlQuery query;
-    query.exec("SELECT title, url FROM history WHERE title LIKE '%" + string + "%' OR url LIKE '%" + string + "%' ORDER BY count DESC LIMIT " + QString::number(limit));
-    int i = 0;
-    QStandardItemModel* cModel = qobject_cast<QStandardItemModel*>(model());
-    QTreeView* treeView = qobject_cast<QTreeView*>(popup());
+    m_searchString = string;
+    m_searchPending = true;
+    m_mostVisitedPending = false;
+
+    startSearch();
+}
 
-    cModel->clear();
-    while (query.next()) {
-        QStandardItem* iconText = new QStandardItem();
-        QStandardItem* findUrl = new QStandardItem();
-        QString url = query.value(1).toUrl().toEncoded();
-
-        iconText->setIcon(_iconForUrl(query.value(1).toUrl()).pixmap(16, 16));
-        iconText->setText(query.value(0).toString().replace("\n", "").append("\n" + url));
-
-        findUrl->setText(url);
-        QList<QStandardItem*> items;
-        items.append(iconText);
-        items.append(findUrl);
-        cModel->insertRow(i, items);
-        i++;
+void LocationCompleter::startSearch()
+{
+    if (m_mostVisitedPending) {
+        showMostVisited();
+        return;
     }
 
-//    if (i == 0) {
-//        QStandardItem* iconText = new QStandardItem();
-//        QStandardItem* findUrl = new QStandardItem();
-//        QString url("http://www.google.com/search?client=qupzilla&q="+string);
+    // Only one search at a time, new one is started when the running
+    // (already cancelled) search finishes
+    if (!m_searchPending || m_watcher->isRunning() || !mApp->completerIndex()->isReady()) {
+        return;
+    }
 
-//        iconText->setIcon(QIcon(":/icons/menu/google.png"));
-//        iconText->setText(tr("Search %1 on Google.com\n..........").arg(string));
-//        findUrl->setText(url);
-//        QList<QStandardItem*> items;
-//        items.append(iconText);
-//        items.append(findUrl);
-//        cModel->insertRow(i, items);
-//    }
+    m_searchPending = false;
 
-    treeView->header()->setResizeMode(0, QHeaderView::Stretch);
-    treeView->header()->resizeSection(1, 0);
+    int limit = m_searchString.size() < 3 ? 25 : 15;
+    m_watcher->setFuture(mApp->completerIndex()->searchAsync(m_searchString, limit, m_generation));
+}
 
-    if (i > 6) {
-        popup()->setMinimumHeight(190);
-    }
-    else {
-        popup()->setMinimumHeight(0);
+void LocationCompleter::searchFinished()
+{
+    const LocationCompleterIndex::SearchResult &result = m_watcher->result();
+
+    if (!result.cancelled && result.generation == int(*m_generation)) {
+        showEntries(result.entries);
+
+        QWidget* w = widget();
+        if (w && w->hasFocus()) {
+            QCompleter::complete();
+        }
     }
 
-    popup()->setUpdatesEnabled(true);
+    startSearch();
 }
@@ -19,8 +19,14 @@
 #define LOCATIONCOMPLETER_H
 
 #include <QCompleter>
+#include <QFutureWatcher>
+#include <QSharedPointer>
+#include <QAtomicInt>
 
 #include "qz_namespace.h"
+#include "locationcompleterindex.h"
+
+class LocationCompleterModel;
 
 class QT_QUPZILLA_EXPORT LocationCompleter : public QCompleter
 {
@@ -35,6 +41,24 @@ signals:
 public slots:
     void refreshCompleter(const QString &string);
     void showMostVisited();
+
+private slots:
+    void startSearch();
+    void searchFinished();
+
+private:
+    void showEntries(const QList<LocationCompleterIndex::Entry> &entries);
+
+    LocationCompleterModel* m_model;
+    QFutureWatcher<LocationCompleterIndex::SearchResult>* m_watcher;
+
+    // Incremented with every request, running search is cancelled
+    // and its results are dropped once it doesn't match
+    QSharedPointer<QAtomicInt> m_generation;
+
+    QString m_searchString;
+    bool m_searchPending;
+    bool m_mostVisitedPending;
 };
 
 #endif // LOCATIONCOMPLETER_H
@@ -0,0 +1,593 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "locationcompleterindex.h"
+#include "mainapplication.h"
+#include "fulltextsearch.h"
+#include "sqlquery.h"
+
+#include <QSqlDatabase>
+#include <QDateTime>
+#include <QSet>
+#include <QtConcurrentRun>
+#include <QDebug>
+
+// When more entries match the search string, they are not collected
+// and entries are instead walked in ranking order
+#define MAXIMUM_CANDIDATES 5000
+
+LocationCompleterIndex::LocationCompleterIndex(QObject* parent)
+    : QObject(parent)
+    , m_watcher(new QFutureWatcher<Data>(this))
+    , m_ready(false)
+    , m_rebuildPending(false)
+{
+    connect(m_watcher, SIGNAL(finished()), this, SLOT(buildFinished()));
+
+    HistoryModel* historyModel = mApp->history();
+    connect(historyModel, SIGNAL(historyEntryAdded(HistoryEntry)), this, SLOT(historyEntryAdded(HistoryEntry)));
+    connect(historyModel, SIGNAL(historyEntryDeleted(HistoryEntry)), this, SLOT(historyEntryDeleted(HistoryEntry)));
+    connect(historyModel, SIGNAL(historyEntryEdited(HistoryEntry, HistoryEntry)), this, SLOT(historyEntryEdited(HistoryEntry, HistoryEntry)));
+    connect(historyModel, SIGNAL(historyClear()), this, SLOT(historyCleared()));
+
+    BookmarksModel* bookmarksModel = mApp->bookmarksModel();
+    connect(bookmarksModel, SIGNAL(bookmarkAdded(BookmarksModel::Bookmark)), this, SLOT(bookmarkAdded(BookmarksModel::Bookmark)));
+    connect(bookmarksModel, SIGNAL(bookmarkDeleted(BookmarksModel::Bookmark)), this, SLOT(bookmarkDeleted(BookmarksModel::Bookmark)));
+    connect(bookmarksModel, SIGNAL(bookmarkEdited(BookmarksModel::Bookmark, BookmarksModel::Bookmark)),
+            this, SLOT(bookmarkEdited(BookmarksModel::Bookmark, BookmarksModel::Bookmark)));
+    // Bulk imports are already committed, index is rebuilt instead of inserting entries one by one
+    connect(bookmarksModel, SIGNAL(bookmarksImported(QList<BookmarksModel::Bookmark>)), this, SLOT(rebuild()));
+
+    rebuild();
+}
+
+void LocationCompleterIndex::rebuild()
+{
+    if (m_watcher->isRunning()) {
+        m_rebuildPending = true;
+        return;
+    }
+
+    // Old index is used until the new one is built
+    m_pendingUpdates.clear();
+    m_watcher->setFuture(QtConcurrent::run(&LocationCompleterIndex::buildIndex, mApp->getActiveProfilPath() + "browsedata.db"));
+}
+
+void LocationCompleterIndex::buildFinished()
+{
+    if (m_rebuildPending) {
+        m_rebuildPending = false;
+        rebuild();
+        return;
+    }
+
+    m_data = m_watcher->result();
+    m_watcher->setFuture(QFuture<Data>());
+
+    // Changes made while the index was being built
+    foreach(const Update & update, m_pendingUpdates) {
+        applyUpdate(update);
+    }
+    m_pendingUpdates.clear();
+
+    m_ready = true;
+    emit indexReady();
+}
+
+LocationCompleterIndex::Data LocationCompleterIndex::buildIndex(const QString &databaseFile)
+{
+    const QString connectionName = QLatin1String("LocationCompleterIndex");
+    Data data;
+
+    {
+        // Connection can be used only in thread where it was created
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+        db.setDatabaseName(databaseFile);
+
+        if (db.open()) {
+            SqlQuery query("completer", db);
+            query.exec("SELECT url, title, count, date, frecency FROM history");
+            while (query.next()) {
+                Entry entry;
+                entry.url = query.value(0).toString();
+                entry.title = query.value(1).toString();
+                entry.count = query.value(2).toInt();
+                entry.date = query.value(3).toLongLong();
+                entry.frecency = query.value(4).toDouble();
+
+                if (entry.url.isEmpty() || data.urls.contains(entry.url)) {
+                    continue;
+                }
+
+                data.entries.append(entry);
+                indexEntry(data, data.entries.count() - 1);
+            }
+
+            query.exec("SELECT url, title FROM bookmarks");
+            while (query.next()) {
+                const QString url = query.value(0).toString();
+                if (url.isEmpty()) {
+                    continue;
+                }
+
+                int id = data.urls.value(url, -1);
+                if (id != -1) {
+                    data.entries[id].bookmarks++;
+                    continue;
+                }
+
+                Entry entry;
+                entry.url = url;
+                entry.title = query.value(1).toString();
+                entry.bookmarks = 1;
+
+                data.entries.append(entry);
+                indexEntry(data, data.entries.count() - 1);
+            }
+        }
+        else {
+            qWarning() << "LocationCompleterIndex::buildIndex cannot open database" << databaseFile;
+        }
+
+        db.close();
+    }
+
+    QSqlDatabase::removeDatabase(connectionName);
+
+    // Sorting all entries at once is much faster than inserting them one by one
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    QVector<QPair<qreal, int> > order;
+    order.reserve(data.entries.count());
+
+    for (int id = 0; id < data.entries.count(); ++id) {
+        Entry &entry = data.entries[id];
+        entry.score = calculateScore(entry, now);
+        order.append(qMakePair(-entry.score, id));
+    }
+
+    qSort(order);
+
+    data.ranking.reserve(order.count());
+    for (int i = 0; i < order.count(); ++i) {
+        data.ranking.append(order.at(i).second);
+    }
+
+    return data;
+}
+
+qreal LocationCompleterIndex::calculateScore(const Entry &entry, qint64 now)
+{
+    qreal score = entry.frecency;
+
+    // Bookmark counts as a visit made at the time it was indexed
+    if (entry.bookmarks > 0) {
+        score += HistoryModel::frecencyForVisit(HistoryModel::BookmarkTransition, now);
+    }
+
+    return score;
+}
+
+static bool containsWordPrefix(const QString &text, const QString &word)
+{
+    int pos = 0;
+    while ((pos = text.indexOf(word, pos, Qt::CaseInsensitive)) != -1) {
+        if (pos == 0 || !text.at(pos - 1).isLetterOrNumber()) {
+            return true;
+        }
+        ++pos;
+    }
+
+    return false;
+}
+
+bool LocationCompleterIndex::matchesWord(const Entry &entry, const QString &word)
+{
+    return containsWordPrefix(entry.title, word) || containsWordPrefix(entry.url, word);
+}
+
+QList<LocationCompleterIndex::Entry> LocationCompleterIndex::search(const QString &string, int limit) const
+{
+    return searchData(m_data, string, limit, QSharedPointer<QAtomicInt>(), 0).entries;
+}
+
+QFuture<LocationCompleterIndex::SearchResult> LocationCompleterIndex::searchAsync(const QString &string, int limit, QSharedPointer<QAtomicInt> generation) const
+{
+    // Copy of index data is cheap (implicitly shared), changes made
+    // while the search is running don't affect it
+    return QtConcurrent::run(&LocationCompleterIndex::searchData, m_data, string, limit, generation, int(*generation));
+}
+
+static inline bool isCancelled(const QSharedPointer<QAtomicInt> &generation, int token)
+{
+    return generation && int(*generation) != token;
+}
+
+LocationCompleterIndex::SearchResult LocationCompleterIndex::searchData(const Data &data, const QString &string, int limit,
+        QSharedPointer<QAtomicInt> generation, int token)
+{
+    SearchResult result;
+    result.generation = token;
+
+    QStringList words = FullTextSearch::splitWords(string);
+    if (words.isEmpty()) {
+        for (int i = 0; i < data.ranking.count() && i < limit; ++i) {
+            result.entries.append(data.entries.at(data.ranking.at(i)));
+        }
+        return result;
+    }
+
+    // Longest word of search string is matched by the least entries
+    QString longest;
+    foreach(const QString & word, words) {
+        if (word.length() > longest.length()) {
+            longest = word;
+        }
+    }
+    words.removeOne(longest);
+
+    QSet<int> candidates;
+    bool tooMany = false;
+
+    QMap<QString, QVector<int> >::const_iterator it = data.words.lowerBound(longest);
+    while (it != data.words.constEnd() && it.key().startsWith(longest)) {
+        foreach(int id, it.value()) {
+            candidates.insert(id);
+        }
+
+        if (candidates.count() > MAXIMUM_CANDIDATES) {
+            tooMany = true;
+            break;
+        }
+        ++it;
+    }
+
+    if (tooMany) {
+        words.append(longest);
+
+        for (int i = 0; i < data.ranking.count(); ++i) {
+            if (i % 1024 == 0 && isCancelled(generation, token)) {
+                result.cancelled = true;
+                return result;
+            }
+
+            const Entry &entry = data.entries.at(data.ranking.at(i));
+
+            bool matches = true;
+            foreach(const QString & word, words) {
+                if (!matchesWord(entry, word)) {
+                    matches = false;
+                    break;
+                }
+            }
+
+            if (matches) {
+                result.entries.append(entry);
+                if (result.entries.count() == limit) {
+                    break;
+                }
+            }
+        }
+
+        return result;
+    }
+
+    if (isCancelled(generation, token)) {
+        result.cancelled = true;
+        return result;
+    }
+
+    QVector<QPair<qreal, int> > matched;
+    foreach(int id, candidates) {
+        const Entry &entry = data.entries.at(id);
+
+        bool matches = true;
+        foreach(const QString & word, words) {
+            if (!matchesWord(entry, word)) {
+                matches = false;
+                break;
+            }
+        }
+
+        if (matches) {
+            matched.append(qMakePair(-entry.score, id));
+        }
+    }
+
+    qSort(matched);
+
+    for (int i = 0; i < matched.count() && i < limit; ++i) {
+        result.entries.append(data.entries.at(matched.at(i).second));
+    }
+
+    return result;
+}
+
+QList<LocationCompleterIndex::Entry> LocationCompleterIndex::topEntries(int limit) const
+{
+    QList<Entry> results;
+
+    for (int i = 0; i < m_data.ranking.count() && i < limit; ++i) {
+        results.append(m_data.entries.at(m_data.ranking.at(i)));
+    }
+
+    return results;
+}
+
+void LocationCompleterIndex::indexEntry(Data &data, int id)
+{
+    const Entry &entry = data.entries.at(id);
+
+    data.urls.insert(entry.url, id);
+
+    foreach(const QString & word, FullTextSearch::splitWords(entry.title + QLatin1Char(' ') + entry.url)) {
+        data.words[word].append(id);
+    }
+}
+
+void LocationCompleterIndex::unindexEntry(Data &data, int id)
+{
+    const Entry &entry = data.entries.at(id);
+
+    data.urls.remove(entry.url);
+
+    foreach(const QString & word, FullTextSearch::splitWords(entry.title + QLatin1Char(' ') + entry.url)) {
+        QMap<QString, QVector<int> >::iterator it = data.words.find(word);
+        if (it == data.words.end()) {
+            continue;
+        }
+
+        int index = it.value().indexOf(id);
+        if (index != -1) {
+            it.value().remove(index);
+        }
+        if (it.value().isEmpty()) {
+            data.words.erase(it);
+        }
+    }
+}
+
+static inline bool rankedBefore(qreal firstScore, int firstId, qreal secondScore, int secondId)
+{
+    return firstScore > secondScore || (firstScore == secondScore && firstId < secondId);
+}
+
+int LocationCompleterIndex::rankingPosition(const Data &data, int id)
+{
+    const qreal score = data.entries.at(id).score;
+
+    int low = 0;
+    int high = data.ranking.count();
+    while (low < high) {
+        int middle = (low + high) / 2;
+        int other = data.ranking.at(middle);
+
+        if (rankedBefore(data.entries.at(other).score, other, score, id)) {
+            low = middle + 1;
+        }
+        else {
+            high = middle;
+        }
+    }
+
+    return low;
+}
+
+int LocationCompleterIndex::insertEntry(Data &data, const Entry &entry)
+{
+    data.entries.append(entry);
+
+    int id = data.entries.count() - 1;
+    indexEntry(data, id);
+    data.ranking.insert(rankingPosition(data, id), id);
+
+    return id;
+}
+
+void LocationCompleterIndex::removeEntry(Data &data, int id)
+{
+    int position = rankingPosition(data, id);
+    if (position < data.ranking.count() && data.ranking.at(position) == id) {
+        data.ranking.remove(position);
+    }
+
+    unindexEntry(data, id);
+    data.entries[id] = Entry();
+}
+
+void LocationCompleterIndex::updateEntry(Data &data, int id, const Entry &entry)
+{
+    int position = rankingPosition(data, id);
+    if (position < data.ranking.count() && data.ranking.at(position) == id) {
+        data.ranking.remove(position);
+    }
+
+    if (data.entries.at(id).title != entry.title) {
+        unindexEntry(data, id);
+        data.entries[id] = entry;
+        indexEntry(data, id);
+    }
+    else {
+        data.entries[id] = entry;
+    }
+
+    data.ranking.insert(rankingPosition(data, id), id);
+}
+
+void LocationCompleterIndex::applyUpdate(const Update &update)
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    int id = m_data.urls.value(update.url, -1);
+
+    switch (update.type) {
+    case Update::VisitAdded: {
+        Entry entry = id == -1 ? Entry() : m_data.entries.at(id);
+        entry.url = update.url;
+        entry.title = update.title;
+        entry.count = update.count;
+        entry.date = update.date;
+        entry.frecency = update.frecency;
+        entry.score = calculateScore(entry, now);
+
+        if (id == -1) {
+            insertEntry(m_data, entry);
+        }
+        else {
+            updateEntry(m_data, id, entry);
+        }
+        break;
+    }
+
+    case Update::EntryDeleted:
+        if (id == -1) {
+            break;
+        }
+
+        if (m_data.entries.at(id).bookmarks > 0) {
+            Entry entry = m_data.entries.at(id);
+            entry.count = 0;
+            entry.date = 0;
+            entry.frecency = 0;
+            entry.score = calculateScore(entry, now);
+            updateEntry(m_data, id, entry);
+        }
+        else {
+            removeEntry(m_data, id);
+        }
+        break;
+
+    case Update::HistoryCleared: {
+        // Only bookmarks are left
+        Data data;
+        foreach(int entryId, m_data.ranking) {
+            Entry entry = m_data.entries.at(entryId);
+            if (entry.bookmarks > 0) {
+                entry.count = 0;
+                entry.date = 0;
+                entry.frecency = 0;
+                entry.score = calculateScore(entry, now);
+                insertEntry(data, entry);
+            }
+        }
+        m_data = data;
+        break;
+    }
+
+    case Update::BookmarkAdded: {
+        Entry entry = id == -1 ? Entry() : m_data.entries.at(id);
+        entry.url = update.url;
+        if (entry.title.isEmpty()) {
+            entry.title = update.title;
+        }
+        entry.bookmarks = update.count;
+        entry.score = calculateScore(entry, now);
+
+        if (id == -1) {
+            insertEntry(m_data, entry);
+        }
+        else {
+            updateEntry(m_data, id, entry);
+        }
+        break;
+    }
+
+    case Update::BookmarkDeleted: {
+        if (id == -1) {
+            break;
+        }
+
+        Entry entry = m_data.entries.at(id);
+        entry.bookmarks = update.count;
+
+        if (entry.bookmarks == 0 && entry.count == 0) {
+            removeEntry(m_data, id);
+        }
+        else {
+            entry.score = calculateScore(entry, now);
+            updateEntry(m_data, id, entry);
+        }
+        break;
+    }
+
+    default:
+        break;
+    }
+}
+
+void LocationCompleterIndex::addUpdate(Update::Type type, const QString &url, const QString &title, qint64 date, qreal frecency, int count)
+{
+    Update update;
+    update.type = type;
+    update.url = url;
+    update.title = title;
+    update.date = date;
+    update.frecency = frecency;
+    update.count = count;
+
+    applyUpdate(update);
+
+    // Update will be applied also to the index being built
+    if (m_watcher->isRunning()) {
+        m_pendingUpdates.append(update);
+    }
+}
+
+void LocationCompleterIndex::historyEntryAdded(const HistoryEntry &entry)
+{
+    addUpdate(Update::VisitAdded, entry.url.toString(), entry.title, entry.date.toMSecsSinceEpoch(), entry.frecency, entry.count);
+}
+
+void LocationCompleterIndex::historyEntryEdited(const HistoryEntry &before, const HistoryEntry &after)
+{
+    Q_UNUSED(before)
+
+    // HistoryModel emits historyEntryEdited when already stored page is visited again,
+    // after contains whole updated entry
+    addUpdate(Update::VisitAdded, after.url.toString(), after.title, after.date.toMSecsSinceEpoch(), after.frecency, after.count);
+}
+
+void LocationCompleterIndex::historyEntryDeleted(const HistoryEntry &entry)
+{
+    addUpdate(Update::EntryDeleted, entry.url.toString());
+}
+
+void LocationCompleterIndex::historyCleared()
+{
+    addUpdate(Update::HistoryCleared, QString());
+}
+
+// Bookmark updates carry number of bookmarks with the url after the change (BookmarksModel
+// updates its tree before views are notified), so replaying them on index built
+// from database that already contains the change doesn't count it twice
+void LocationCompleterIndex::bookmarkAdded(const BookmarksModel::Bookmark &bookmark)
+{
+    addUpdate(Update::BookmarkAdded, bookmark.url.toString(), bookmark.title, 0, 0, mApp->bookmarksModel()->bookmarkCount(bookmark.url));
+}
+
+void LocationCompleterIndex::bookmarkDeleted(const BookmarksModel::Bookmark &bookmark)
+{
+    addUpdate(Update::BookmarkDeleted, bookmark.url.toString(), QString(), 0, 0, mApp->bookmarksModel()->bookmarkCount(bookmark.url));
+}
+
+void LocationCompleterIndex::bookmarkEdited(const BookmarksModel::Bookmark &before, const BookmarksModel::Bookmark &after)
+{
+    if (before.url == after.url) {
+        return;
+    }
+
+    bookmarkDeleted(before);
+    bookmarkAdded(after);
+}
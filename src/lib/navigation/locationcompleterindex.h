@@ -0,0 +1,143 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef LOCATIONCOMPLETERINDEX_H
+#define LOCATIONCOMPLETERINDEX_H
+
+#include <QObject>
+#include <QVector>
+#include <QHash>
+#include <QMap>
+#include <QStringList>
+#include <QFutureWatcher>
+#include <QSharedPointer>
+#include <QAtomicInt>
+
+#include "qz_namespace.h"
+#include "historymodel.h"
+#include "bookmarksmodel.h"
+
+// In-memory index of history and bookmarks used by LocationCompleter.
+// Titles and urls are split into words, every word of the search string
+// has to be prefix of some word of the entry. Entries are ranked by frecency
+// from history (see HistoryModel::frecencyForVisit), bookmarks get bonus.
+// Frecency doesn't need to be recalculated with time, so the ranking is
+// only updated for entries that changed.
+// Index is built in background thread and then updated from HistoryModel
+// and BookmarksModel signals.
+class QT_QUPZILLA_EXPORT LocationCompleterIndex : public QObject
+{
+    Q_OBJECT
+public:
+    struct Entry {
+        QString url;
+        QString title;
+        int count;
+        qint64 date;
+        qreal frecency;
+        int bookmarks;
+        qreal score;
+
+        Entry() : count(0), date(0), frecency(0), bookmarks(0), score(0) { }
+    };
+
+    struct SearchResult {
+        int generation;
+        bool cancelled;
+        QList<Entry> entries;
+
+        SearchResult() : generation(0), cancelled(false) { }
+    };
+
+    explicit LocationCompleterIndex(QObject* parent = 0);
+
+    bool isReady() const { return m_ready; }
+
+    QList<Entry> search(const QString &string, int limit) const;
+    QList<Entry> topEntries(int limit) const;
+
+    // Search runs in worker thread on snapshot of the index. It is cancelled
+    // as soon as generation is changed (by newer search request).
+    QFuture<SearchResult> searchAsync(const QString &string, int limit, QSharedPointer<QAtomicInt> generation) const;
+
+    static qreal calculateScore(const Entry &entry, qint64 now);
+
+public slots:
+    void rebuild();
+
+signals:
+    void indexReady();
+
+private slots:
+    void buildFinished();
+
+    void historyEntryAdded(const HistoryEntry &entry);
+    void historyEntryEdited(const HistoryEntry &before, const HistoryEntry &after);
+    void historyEntryDeleted(const HistoryEntry &entry);
+    void historyCleared();
+
+    void bookmarkAdded(const BookmarksModel::Bookmark &bookmark);
+    void bookmarkDeleted(const BookmarksModel::Bookmark &bookmark);
+    void bookmarkEdited(const BookmarksModel::Bookmark &before, const BookmarksModel::Bookmark &after);
+
+private:
+    struct Data {
+        // Removed entries stay in vector with empty url until next rebuild
+        QVector<Entry> entries;
+        QHash<QString, int> urls;
+        QMap<QString, QVector<int> > words;
+        // Entry ids ordered by score
+        QVector<int> ranking;
+    };
+
+    struct Update {
+        enum Type { VisitAdded, EntryDeleted, HistoryCleared, BookmarkAdded, BookmarkDeleted };
+
+        Type type;
+        QString url;
+        QString title;
+        qint64 date;
+        qreal frecency;
+        // Visit count, or number of bookmarks for Bookmark* updates
+        int count;
+    };
+
+    static Data buildIndex(const QString &databaseFile);
+    static SearchResult searchData(const Data &data, const QString &string, int limit,
+                                   QSharedPointer<QAtomicInt> generation, int token);
+    static bool matchesWord(const Entry &entry, const QString &word);
+
+    static void indexEntry(Data &data, int id);
+    static void unindexEntry(Data &data, int id);
+    static int rankingPosition(const Data &data, int id);
+
+    static int insertEntry(Data &data, const Entry &entry);
+    static void removeEntry(Data &data, int id);
+    static void updateEntry(Data &data, int id, const Entry &entry);
+
+    void applyUpdate(const Update &update);
+    void addUpdate(Update::Type type, const QString &url, const QString &title = QString(), qint64 date = 0, qreal frecency = 0, int count = 0);
+
+    Data m_data;
+    QFutureWatcher<Data>* m_watcher;
+    QList<Update> m_pendingUpdates;
+
+    bool m_ready;
+    bool m_rebuildPending;
+};
+
+#endif // LOCATIONCOMPLETERINDEX_H
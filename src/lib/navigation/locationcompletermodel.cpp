@@ -0,0 +1,159 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "locationcompletermodel.h"
+#include "iconprovider.h"
+#include "mainapplication.h"
+
+#include <QTimer>
+#include <QWebSettings>
+
+#define MAXIMUM_CACHED_ICONS 300
+
+LocationCompleterModel::LocationCompleterModel(QObject* parent)
+    : QAbstractTableModel(parent)
+    , m_iconsScheduled(false)
+    , m_defaultIcon(QWebSettings::webGraphic(QWebSettings::DefaultFrameIconGraphic))
+{
+    connect(mApp->iconProvider(), SIGNAL(iconLoaded(QUrl)), this, SLOT(iconLoaded(QUrl)));
+}
+
+int LocationCompleterModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_items.count();
+}
+
+int LocationCompleterModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : 2;
+}
+
+QVariant LocationCompleterModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= m_items.count()) {
+        return QVariant();
+    }
+
+    const Item &item = m_items.at(index.row());
+
+    if (index.column() == 1) {
+        return (role == Qt::DisplayRole || role == Qt::EditRole) ? item.url : QVariant();
+    }
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::EditRole:
+        return item.text;
+
+    case Qt::DecorationRole:
+        if (m_iconCache.contains(item.url)) {
+            return m_iconCache.value(item.url);
+        }
+
+        m_pendingIcons.insert(index.row());
+        if (!m_iconsScheduled) {
+            m_iconsScheduled = true;
+            QTimer::singleShot(0, const_cast<LocationCompleterModel*>(this), SLOT(loadIcons()));
+        }
+        return m_defaultIcon;
+
+    default:
+        return QVariant();
+    }
+}
+
+void LocationCompleterModel::setEntries(const QList<LocationCompleterIndex::Entry> &entries, int visibleRows)
+{
+    QVector<Item> items;
+    items.reserve(entries.count());
+
+    foreach(const LocationCompleterIndex::Entry & entry, entries) {
+        Item item;
+        item.url = QUrl(entry.url).toEncoded();
+        item.text = QString(entry.title).replace("\n", "").append("\n" + item.url);
+        items.append(item);
+    }
+
+    beginResetModel();
+    m_items = items.mid(0, visibleRows);
+    m_remainingItems = items.mid(visibleRows);
+    m_pendingIcons.clear();
+    endResetModel();
+
+    if (!m_remainingItems.isEmpty()) {
+        QTimer::singleShot(0, this, SLOT(appendRemainingEntries()));
+    }
+}
+
+int LocationCompleterModel::entriesCount() const
+{
+    return m_items.count() + m_remainingItems.count();
+}
+
+void LocationCompleterModel::appendRemainingEntries()
+{
+    if (m_remainingItems.isEmpty()) {
+        return;
+    }
+
+    beginInsertRows(QModelIndex(), m_items.count(), m_items.count() + m_remainingItems.count() - 1);
+    m_items += m_remainingItems;
+    m_remainingItems.clear();
+    endInsertRows();
+}
+
+void LocationCompleterModel::loadIcons()
+{
+    m_iconsScheduled = false;
+
+    if (m_iconCache.count() > MAXIMUM_CACHED_ICONS) {
+        m_iconCache.clear();
+    }
+
+    foreach(int row, m_pendingIcons) {
+        if (row >= m_items.count()) {
+            continue;
+        }
+
+        const QString &url = m_items.at(row).url;
+        if (!m_iconCache.contains(url)) {
+            // Default icon is returned until the icon is loaded, it is then replaced in iconLoaded()
+            const QImage image = mApp->iconProvider()->cachedIconForUrl(QUrl::fromEncoded(url.toUtf8()));
+            m_iconCache.insert(url, IconProvider::iconFromImage(image).pixmap(16, 16));
+        }
+
+        const QModelIndex idx = index(row, 0);
+        emit dataChanged(idx, idx);
+    }
+
+    m_pendingIcons.clear();
+}
+
+void LocationCompleterModel::iconLoaded(const QUrl &url)
+{
+    const QString encodedUrl = url.toEncoded();
+    if (!m_iconCache.remove(encodedUrl)) {
+        return;
+    }
+
+    for (int row = 0; row < m_items.count(); ++row) {
+        if (m_items.at(row).url == encodedUrl) {
+            const QModelIndex idx = index(row, 0);
+            emit dataChanged(idx, idx);
+        }
+    }
+}
@@ -0,0 +1,66 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef LOCATIONCOMPLETERMODEL_H
+#define LOCATIONCOMPLETERMODEL_H
+
+#include <QAbstractTableModel>
+#include <QIcon>
+#include <QHash>
+#include <QSet>
+#include <QUrl>
+
+#include "qz_namespace.h"
+#include "locationcompleterindex.h"
+
+class QT_QUPZILLA_EXPORT LocationCompleterModel : public QAbstractTableModel
+{
+    Q_OBJECT
+public:
+    explicit LocationCompleterModel(QObject* parent = 0);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+    // Only rows visible in popup are shown immediately, the rest
+    // is appended in next event loop iteration
+    void setEntries(const QList<LocationCompleterIndex::Entry> &entries, int visibleRows);
+    int entriesCount() const;
+
+private slots:
+    void appendRemainingEntries();
+    void loadIcons();
+    void iconLoaded(const QUrl &url);
+
+private:
+    struct Item {
+        QString url;
+        QString text;
+    };
+
+    QVector<Item> m_items;
+    QVector<Item> m_remainingItems;
+
+    // Icons are loaded only for rows that are actually painted
+    mutable QHash<QString, QIcon> m_iconCache;
+    mutable QSet<int> m_pendingIcons;
+    mutable bool m_iconsScheduled;
+    QIcon m_defaultIcon;
+};
+
+#endif // LOCATIONCOMPLETERMODEL_H
@@ -0,0 +1,181 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "cacertificatesloader.h"
+#include "globalfunctions.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDataStream>
+#include <QDirIterator>
+#include <QElapsedTimer>
+#include <QDebug>
+
+static const quint32 cacheMagic = 0x51434142; // "QCAB"
+static const qint32 cacheVersion = 1;
+
+CaCertificatesLoader::Certificates CaCertificatesLoader::load(const QString &certDir, const QStringList &paths, const QString &localCertDir)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    Certificates result;
+    result.usedCache = false;
+
+    installBundle(certDir);
+
+    result.caCerts = loadBundle(certDir, &result.usedCache);
+    foreach(const QString & path, paths) {
+        result.caCerts += loadFromDirectory(path);
+    }
+    result.localCerts = loadFromDirectory(localCertDir);
+
+    result.elapsed = timer.elapsed();
+    return result;
+}
+
+void CaCertificatesLoader::installBundle(const QString &certDir)
+{
+    QString bundlePath = certDir + "ca-bundle.crt";
+    QString bundleVersionPath = certDir + "bundle_version";
+
+    if (!QDir(certDir).exists()) {
+        QDir().mkpath(certDir);
+    }
+
+    if (!QFile::exists(bundlePath)) {
+        QFile(":data/ca-bundle.crt").copy(bundlePath);
+        QFile(bundlePath).setPermissions(QFile::ReadUser | QFile::WriteUser);
+
+        QFile(":data/bundle_version").copy(bundleVersionPath);
+        QFile(bundleVersionPath).setPermissions(QFile::ReadUser | QFile::WriteUser);
+    }
+}
+
+QList<QSslCertificate> CaCertificatesLoader::loadBundle(const QString &certDir, bool* usedCache)
+{
+    QString bundlePath = certDir + "ca-bundle.crt";
+    QString cachePath = certDir + "ca-bundle.cache";
+    QByteArray bundleVersion = qz_readAllFileContents(certDir + "bundle_version").trimmed();
+    qint64 bundleSize = QFileInfo(bundlePath).size();
+
+    QList<QSslCertificate> certs;
+    if (readCache(cachePath, bundleVersion, bundleSize, &certs)) {
+        *usedCache = true;
+        return certs;
+    }
+
+    QFile file(bundlePath);
+    if (!file.open(QFile::ReadOnly)) {
+        qWarning() << "CaCertificatesLoader::loadBundle cannot open file for reading" << bundlePath;
+        return certs;
+    }
+
+    certs = QSslCertificate::fromData(file.readAll(), QSsl::Pem);
+    writeCache(cachePath, bundleVersion, bundleSize, certs);
+
+    return certs;
+}
+
+QList<QSslCertificate> CaCertificatesLoader::loadFromDirectory(const QString &path)
+{
+    QList<QSslCertificate> certs;
+
+#ifdef Q_WS_WIN
+    // Used from Qt 4.7.4 qsslcertificate.cpp and modified because QSslCertificate::fromPath
+    // is kind of a bugged on Windows, it does work only with full path to cert file
+    int startIndex = 0;
+    QDirIterator it(path, QDir::Files, QDirIterator::FollowSymlinks | QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        QString filePath = startIndex == 0 ? it.next() : it.next().mid(startIndex);
+        if (!filePath.endsWith(".crt")) {
+            continue;
+        }
+
+        QFile file(filePath);
+        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            certs += QSslCertificate::fromData(file.readAll(), QSsl::Pem);
+        }
+    }
+#else
+    certs += QSslCertificate::fromPath(path + "/*.crt", QSsl::Pem, QRegExp::Wildcard);
+#endif
+
+    return certs;
+}
+
+bool CaCertificatesLoader::readCache(const QString &cachePath, const QByteArray &bundleVersion, qint64 bundleSize, QList<QSslCertificate>* certs)
+{
+    QFile file(cachePath);
+    if (!file.open(QFile::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_6);
+
+    quint32 magic;
+    qint32 version;
+    QByteArray cachedBundleVersion;
+    qint64 cachedBundleSize;
+    qint32 count;
+
+    stream >> magic >> version;
+    if (magic != cacheMagic || version != cacheVersion) {
+        return false;
+    }
+
+    stream >> cachedBundleVersion >> cachedBundleSize >> count;
+    if (cachedBundleVersion != bundleVersion || cachedBundleSize != bundleSize || count < 0) {
+        return false;
+    }
+
+    QList<QSslCertificate> list;
+    for (int i = 0; i < count; ++i) {
+        QByteArray der;
+        stream >> der;
+
+        if (stream.status() != QDataStream::Ok) {
+            return false;
+        }
+
+        list.append(QSslCertificate(der, QSsl::Der));
+    }
+
+    *certs = list;
+    return true;
+}
+
+void CaCertificatesLoader::writeCache(const QString &cachePath, const QByteArray &bundleVersion, qint64 bundleSize, const QList<QSslCertificate> &certs)
+{
+    QFile file(cachePath);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        qWarning() << "CaCertificatesLoader::writeCache cannot open file for writing" << cachePath;
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream.setVersion(QDataStream::Qt_4_6);
+
+    stream << cacheMagic << cacheVersion;
+    stream << bundleVersion << bundleSize << qint32(certs.count());
+
+    foreach(const QSslCertificate & cert, certs) {
+        stream << cert.toDer();
+    }
+}
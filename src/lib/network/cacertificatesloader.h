@@ -0,0 +1,53 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef CACERTIFICATESLOADER_H
+#define CACERTIFICATESLOADER_H
+
+#include <QList>
+#include <QStringList>
+#include <QSslCertificate>
+
+#include "qz_namespace.h"
+
+// Loads CA bundle and local certificates, meant to be run in worker thread.
+// Parsed bundle is cached in DER form keyed by bundle_version, so PEM parsing
+// of the whole ca-bundle.crt is only done once after every bundle update.
+class QT_QUPZILLA_EXPORT CaCertificatesLoader
+{
+public:
+    struct Certificates {
+        QList<QSslCertificate> caCerts;
+        QList<QSslCertificate> localCerts;
+
+        // Time spent loading [ms]
+        qint64 elapsed;
+        bool usedCache;
+    };
+
+    static Certificates load(const QString &certDir, const QStringList &paths, const QString &localCertDir);
+
+private:
+    static void installBundle(const QString &certDir);
+    static QList<QSslCertificate> loadBundle(const QString &certDir, bool* usedCache);
+    static QList<QSslCertificate> loadFromDirectory(const QString &path);
+
+    static bool readCache(const QString &cachePath, const QByteArray &bundleVersion, qint64 bundleSize, QList<QSslCertificate>* certs);
+    static void writeCache(const QString &cachePath, const QByteArray &bundleVersion, qint64 bundleSize, const QList<QSslCertificate> &certs);
+};
+
+#endif // CACERTIFICATESLOADER_H
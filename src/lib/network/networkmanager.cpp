@@ -46,6 +46,8 @@
 #include <QMessageBox>
 #include <QAuthenticator>
 #include <QDirIterator>
+#include <QtConcurrentRun>
+#include <QElapsedTimer>
 #include <QDebug>
 
 QString fileNameForCert(const QSslCertificate &cert)
@@ -62,8 +64,15 @@ NetworkManager::NetworkManager(QupZilla* mainClass, QObject* parent)
     , m_adblockNetwork(0)
     , p_QupZilla(mainClass)
     , m_qupzillaSchemeHandler(new QupZillaSchemeHandler)
+    , m_certificatesWatcher(0)
+    , m_certificatesLoaded(false)
     , m_ignoreAllWarnings(false)
 {
+    m_certificatesStatistics.loaded = false;
+    m_certificatesStatistics.loadTime = 0;
+    m_certificatesStatistics.waitTime = 0;
+    m_certificatesStatistics.usedCache = false;
+
     connect(this, SIGNAL(authenticationRequired(QNetworkReply*, QAuthenticator*)), this, SLOT(authentication(QNetworkReply*, QAuthenticator*)));
     connect(this, SIGNAL(proxyAuthenticationRequired(QNetworkProxy, QAuthenticator*)), this, SLOT(proxyAuthentication(QNetworkProxy, QAuthenticator*)));
     connect(this, SIGNAL(sslErrors(QNetworkReply*, QList<QSslError>)), this, SLOT(sslError(QNetworkReply*, QList<QSslError>)));
@@ -72,6 +81,10 @@ NetworkManager::NetworkManager(QupZilla* mainClass, QObject* parent)
     m_proxyFactory = new NetworkProxyFactory();
     setProxyFactory(m_proxyFactory);
     loadSettings();
+
+    // Started as soon as possible, so the first request (eg. from restored session)
+    // already waits for user's certificates in ensureCertificatesLoaded()
+    loadCertificates();
 }
 
 void NetworkManager::loadSettings()
@@ -100,25 +113,6 @@ void NetworkManager::loadSettings()
     QSslConfiguration::setDefaultConfiguration(config);
 #endif
 
-    QString certDir = mApp->PROFILEDIR + "certificates";
-    QString bundlePath = certDir + "/ca-bundle.crt";
-    QString bundleVersionPath = certDir + "/bundle_version";
-
-    if (!QDir(certDir).exists()) {
-        QDir dir(mApp->PROFILEDIR);
-        dir.mkdir("certificates");
-    }
-
-    if (!QFile::exists(bundlePath)) {
-        QFile(":data/ca-bundle.crt").copy(bundlePath);
-        QFile(bundlePath).setPermissions(QFile::ReadUser | QFile::WriteUser);
-
-        QFile(":data/bundle_version").copy(bundleVersionPath);
-        QFile(bundleVersionPath).setPermissions(QFile::ReadUser | QFile::WriteUser);
-    }
-
-    QSslSocket::setDefaultCaCertificates(QSslCertificate::fromPath(bundlePath));
-
     m_proxyFactory->loadSettings();
 }
 
@@ -340,6 +334,10 @@ QNetworkReply* NetworkManager::createRequest(QNetworkAccessManager::Operation op
         }
     }
 
+    if (req.url().scheme() == QLatin1String("https")) {
+        ensureCertificatesLoaded();
+    }
+
     req.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
     if (req.attribute(QNetworkRequest::CacheLoadControlAttribute).toInt() == QNetworkRequest::PreferNetwork) {
         req.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::PreferCache);
@@ -362,6 +360,8 @@ QNetworkReply* NetworkManager::createRequest(QNetworkAccessManager::Operation op
 
 void NetworkManager::removeLocalCertificate(const QSslCertificate &cert)
 {
+    ensureCertificatesLoaded();
+
     m_localCerts.removeOne(cert);
     QList<QSslCertificate> certs = QSslSocket::defaultCaCertificates();
     certs.removeOne(cert);
@@ -397,6 +397,8 @@ void NetworkManager::addLocalCertificate(const QSslCertificate &cert)
 //        return;
 //    }
 
+    ensureCertificatesLoaded();
+
     m_localCerts.append(cert);
     QSslSocket::addDefaultCaCertificate(cert);
 
@@ -435,51 +437,63 @@ void NetworkManager::loadCertificates()
     m_ignoreAllWarnings = settings.value("IgnoreAllSSLWarnings", false).toBool();
     settings.endGroup();
 
-    //CA Certificates
-    m_caCerts = QSslSocket::defaultCaCertificates();
-    foreach(const QString & path, m_certPaths) {
-#ifdef Q_WS_WIN
-        // Used from Qt 4.7.4 qsslcertificate.cpp and modified because QSslCertificate::fromPath
-        // is kind of a bugged on Windows, it does work only with full path to cert file
-        int startIndex = 0;
-        QDirIterator it(path, QDir::Files, QDirIterator::FollowSymlinks | QDirIterator::Subdirectories);
-        while (it.hasNext()) {
-            QString filePath = startIndex == 0 ? it.next() : it.next().mid(startIndex);
-            if (!filePath.endsWith(".crt")) {
-                continue;
-            }
+    // Parsing certificates is slow, so it is done in worker thread.
+    // Loading is completed before first https request in ensureCertificatesLoaded()
+    m_certificatesWatcher = new QFutureWatcher<CaCertificatesLoader::Certificates>(this);
+    connect(m_certificatesWatcher, SIGNAL(finished()), this, SLOT(certificatesLoaded()));
 
-            QFile file(filePath);
-            if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-                m_caCerts += QSslCertificate::fromData(file.readAll(), QSsl::Pem);
-            }
-        }
-#else
-        m_caCerts += QSslCertificate::fromPath(path + "/*.crt", QSsl::Pem, QRegExp::Wildcard);
-#endif
-    }
-    //Local Certificates
-#ifdef Q_WS_WIN
-    int startIndex = 0;
-    QDirIterator it_(mApp->getActiveProfilPath() + "certificates", QDir::Files, QDirIterator::FollowSymlinks | QDirIterator::Subdirectories);
-    while (it_.hasNext()) {
-        QString filePath = startIndex == 0 ? it_.next() : it_.next().mid(startIndex);
-        if (!filePath.endsWith(".crt")) {
-            continue;
-        }
+    m_certificatesWatcher->setFuture(QtConcurrent::run(CaCertificatesLoader::load, mApp->PROFILEDIR + "certificates/",
+                                     m_certPaths, mApp->getActiveProfilPath() + "certificates"));
 
-        QFile file(filePath);
-        if (file.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            m_localCerts += QSslCertificate::fromData(file.readAll(), QSsl::Pem);
-        }
+    new CaBundleUpdater(this, this);
+}
+
+QList<QSslCertificate> NetworkManager::getCaCertificates()
+{
+    ensureCertificatesLoaded();
+
+    return m_caCerts;
+}
+
+QList<QSslCertificate> NetworkManager::getLocalCertificates()
+{
+    ensureCertificatesLoaded();
+
+    return m_localCerts;
+}
+
+NetworkManager::CertificatesStatistics NetworkManager::certificatesStatistics() const
+{
+    return m_certificatesStatistics;
+}
+
+void NetworkManager::certificatesLoaded()
+{
+    ensureCertificatesLoaded();
+}
+
+void NetworkManager::ensureCertificatesLoaded()
+{
+    if (m_certificatesLoaded || !m_certificatesWatcher) {
+        return;
     }
-#else
-    m_localCerts += QSslCertificate::fromPath(mApp->getActiveProfilPath() + "certificates/*.crt", QSsl::Pem, QRegExp::Wildcard);
-#endif
 
-    QSslSocket::setDefaultCaCertificates(m_caCerts + m_localCerts);
+    // Blocks only when worker thread is still running
+    QElapsedTimer timer;
+    timer.start();
+    m_certificatesWatcher->waitForFinished();
 
-    new CaBundleUpdater(this, this);
+    const CaCertificatesLoader::Certificates &certs = m_certificatesWatcher->result();
+    m_caCerts = certs.caCerts;
+    m_localCerts = certs.localCerts;
+    m_certificatesLoaded = true;
+
+    m_certificatesStatistics.loaded = true;
+    m_certificatesStatistics.loadTime = certs.elapsed;
+    m_certificatesStatistics.waitTime = timer.elapsed();
+    m_certificatesStatistics.usedCache = certs.usedCache;
+
+    QSslSocket::setDefaultCaCertificates(m_caCerts + m_localCerts);
 }
 
 void NetworkManager::disconnectObjects()
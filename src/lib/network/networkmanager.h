@@ -20,9 +20,11 @@
 
 #include <QSslError>
 #include <QStringList>
+#include <QFutureWatcher>
 
 #include "qz_namespace.h"
 #include "networkmanagerproxy.h"
+#include "cacertificatesloader.h"
 
 class QNetworkDiskCache;
 
@@ -42,8 +44,19 @@ public:
     void saveCertificates();
     void loadCertificates();
 
-    QList<QSslCertificate> getCaCertificates() { return m_caCerts; }
-    QList<QSslCertificate> getLocalCertificates() { return m_localCerts; }
+    QList<QSslCertificate> getCaCertificates();
+    QList<QSslCertificate> getLocalCertificates();
+
+    struct CertificatesStatistics {
+        bool loaded;
+        // Time spent loading in worker thread [ms]
+        qint64 loadTime;
+        // Time GUI thread was blocked waiting for loading [ms]
+        qint64 waitTime;
+        bool usedCache;
+    };
+
+    CertificatesStatistics certificatesStatistics() const;
 
     void removeLocalCertificate(const QSslCertificate &cert);
     void addLocalCertificate(const QSslCertificate &cert);
@@ -65,8 +78,11 @@ private slots:
     void proxyAuthentication(const QNetworkProxy &proxy, QAuthenticator* auth);
     void sslError(QNetworkReply* reply, QList<QSslError> errors);
     void setSSLConfiguration(QNetworkReply* reply);
+    void certificatesLoaded();
 
 private:
+    void ensureCertificatesLoaded();
+
     AdBlockNetwork* m_adblockNetwork;
     QupZilla* p_QupZilla;
     QNetworkDiskCache* m_diskCache;
@@ -79,6 +95,10 @@ private:
 
     QList<QSslCertificate> m_ignoredCerts;
 
+    QFutureWatcher<CaCertificatesLoader::Certificates>* m_certificatesWatcher;
+    bool m_certificatesLoaded;
+    CertificatesStatistics m_certificatesStatistics;
+
     QByteArray m_acceptLanguage;
 
     bool m_ignoreAllWarnings;
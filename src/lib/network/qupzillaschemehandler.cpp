@@ -25,11 +25,19 @@
 #include "pluginproxy.h"
 #include "plugininterface.h"
 #include "settings.h"
+#include "databaseprofiler.h"
+#include "downloaditem.h"
+#include "iconprovider.h"
+#include "sqlquery.h"
+#include "networkmanager.h"
 
 #include <QTextDocument>
 #include <QTextStream>
 #include <QTimer>
 #include <QSettings>
+#include <QFileInfo>
+#include <QRegExp>
+#include <QSet>
 
 QString authorString(const char* name, const QString &mail)
 {
@@ -60,7 +68,8 @@ QupZillaSchemeReply::QupZillaSchemeReply(const QNetworkRequest &req, QObject* pa
     setUrl(req.url());
 
     m_pageName = req.url().path();
-    if (m_pageName == "about" || m_pageName == "reportbug" || m_pageName == "start" || m_pageName == "speeddial" || m_pageName == "config") {
+    if (m_pageName == "about" || m_pageName == "reportbug" || m_pageName == "start" || m_pageName == "speeddial" || m_pageName == "config" ||
+            m_pageName == "database") {
         m_buffer.open(QIODevice::ReadWrite);
         setError(QNetworkReply::NoError, tr("No Error"));
 
@@ -93,6 +102,9 @@ void QupZillaSchemeReply::loadPage()
     else if (m_pageName == "config") {
         stream << configPage();
     }
+    else if (m_pageName == "database") {
+        stream << databasePage();
+    }
 
     stream.flush();
     m_buffer.reset();
@@ -395,3 +407,140 @@ QString QupZillaSchemeReply::configPage()
 
     return page;
 }
+
+QString QupZillaSchemeReply::databasePage()
+{
+    static QString dPage;
+
+    if (dPage.isEmpty()) {
+        dPage.append(qz_readAllFileContents(":html/database.html"));
+        dPage.replace("%FAVICON%", "qrc:icons/qupzilla.png");
+        dPage.replace("%BOX-BORDER%", "qrc:html/box-border.png");
+        dPage.replace("%ABOUT-IMG%", "qrc:icons/other/about.png");
+
+        dPage.replace("%TITLE%", tr("Database Information"));
+        dPage.replace("%DATABASE%", tr("Database Information"));
+        dPage.replace("%FILES%", tr("Database Files"));
+        dPage.replace("%STATEMENTS%", tr("Statements by Total Time"));
+        dPage.replace("%ST-STATEMENT%", tr("Statement"));
+        dPage.replace("%ST-SUBSYSTEM%", tr("Caller"));
+        dPage.replace("%ST-CALLS%", tr("Calls"));
+        dPage.replace("%ST-TOTAL%", tr("Total [ms]"));
+        dPage.replace("%ST-AVERAGE%", tr("Average [ms]"));
+        dPage.replace("%ST-MAXIMUM%", tr("Maximum [ms]"));
+        dPage.replace("%ST-ROWS%", tr("Rows"));
+        dPage.replace("%ST-SLOW%", tr("Slow"));
+        dPage.replace("%TABLES%", tr("Tables"));
+        dPage.replace("%TB-NAME%", tr("Name"));
+        dPage.replace("%TB-ROWS%", tr("Rows"));
+        dPage.replace("%INDEXES%", tr("Index Usage"));
+        dPage.replace("%IX-NAME%", tr("Name"));
+        dPage.replace("%IX-TABLE%", tr("Table"));
+        dPage.replace("%IX-STATEMENTS%", tr("Statements"));
+        dPage.replace("%IX-CALLS%", tr("Calls"));
+        dPage.replace("%DATABASE-ABOUT%", tr("This page contains statistics of all database statements executed since QupZilla was started. "
+                                             "Query plan is shown for statements that were slow at least once."));
+    }
+
+    QString page = dPage;
+    const QString dbFile = mApp->getActiveProfilPath() + "browsedata.db";
+
+    SqlQuery query("profiler");
+    QString pragmasString;
+    const QStringList pragmas = QStringList() << "journal_mode" << "auto_vacuum" << "page_size" << "page_count" << "freelist_count";
+    foreach(const QString & pragma, pragmas) {
+        query.exec("PRAGMA " + pragma);
+        pragmasString.append(QString("<dt>%1</dt><dd>%2<dd>").arg(pragma, query.next() ? query.value(0).toString() : QString()));
+    }
+
+    const IconProvider::CacheStatistics iconStats = mApp->iconProvider()->cacheStatistics();
+    const int iconLookups = iconStats.hits + iconStats.misses;
+    const QString iconCacheString = QString("<dt>%1</dt><dd>%2<dd>").arg(tr("Icon cache"),
+                                    tr("%1 icons, %2, hit rate %3 %").arg(QString::number(iconStats.icons),
+                                            DownloadItem::fileSizeToString(iconStats.memory),
+                                            QString::number(iconLookups > 0 ? iconStats.hits * 100 / iconLookups : 0)));
+
+    // Certificates are loaded in background, GUI thread waits only if first request comes sooner
+    const NetworkManager::CertificatesStatistics certStats = mApp->networkManager()->certificatesStatistics();
+    const QString certificatesString = QString("<dt>%1</dt><dd>%2<dd>").arg(tr("Certificates loading"),
+                                       !certStats.loaded ? tr("Not finished yet") :
+                                       tr("%1 ms in background, %2 ms blocking, %3").arg(QString::number(certStats.loadTime),
+                                               QString::number(certStats.waitTime),
+                                               certStats.usedCache ? tr("bundle cache used") : tr("bundle parsed")));
+
+    page.replace("%FILES-INFO%",
+                 QString("<dt>%1</dt><dd>%2<dd>").arg(tr("Database"), dbFile) +
+                 QString("<dt>%1</dt><dd>%2<dd>").arg(tr("Database size"), DownloadItem::fileSizeToString(QFileInfo(dbFile).size())) +
+                 QString("<dt>%1</dt><dd>%2<dd>").arg(tr("WAL size"), DownloadItem::fileSizeToString(QFileInfo(dbFile + "-wal").size())) +
+                 pragmasString + iconCacheString + certificatesString);
+
+    const QList<DatabaseProfiler::Statistics> statistics = DatabaseProfiler::instance()->statistics();
+
+    QString statementsString;
+    foreach(const DatabaseProfiler::Statistics & stats, statistics) {
+        QString statement = Qt::escape(stats.statement);
+        if (!stats.queryPlan.isEmpty()) {
+            statement.append(QString("<pre>%1</pre>").arg(Qt::escape(stats.queryPlan)));
+        }
+
+        statementsString.append(QString("<tr><td>%1</td><td>%2</td><td>%3</td><td>%4</td><td>%5</td><td>%6</td><td>%7</td><td>%8</td></tr>").arg(
+                                    statement, stats.subsystems.join(", "), QString::number(stats.calls),
+                                    QString::number(stats.totalTime / 1000.0, 'f', 1),
+                                    QString::number(stats.totalTime / 1000.0 / stats.calls, 'f', 2),
+                                    QString::number(stats.maximumTime / 1000.0, 'f', 1),
+                                    QString::number(stats.rows), QString::number(stats.slowCalls)));
+    }
+
+    if (statementsString.isEmpty()) {
+        statementsString = QString("<tr><td colspan=8 class=\"no-statements\">%1</td></tr>").arg(tr("No statements were executed yet."));
+    }
+
+    page.replace("%STATEMENTS-INFO%", statementsString);
+
+    QString tablesString;
+    QStringList tables;
+    query.exec("SELECT name FROM sqlite_master WHERE type='table' ORDER BY name");
+    while (query.next()) {
+        tables.append(query.value(0).toString());
+    }
+
+    foreach(const QString & table, tables) {
+        query.exec(QString("SELECT count(*) FROM \"%1\"").arg(table));
+        tablesString.append(QString("<tr><td>%1</td><td>%2</td></tr>").arg(table, query.next() ? query.value(0).toString() : QString()));
+    }
+
+    page.replace("%TABLES-INFO%", tablesString);
+
+    // Index usage is taken from plans of recorded statements in current database state,
+    // not from the plans captured when the statement was slow
+    QHash<QString, int> indexStatements;
+    QHash<QString, int> indexCalls;
+    foreach(const DatabaseProfiler::Statistics & stats, statistics) {
+        const QString plan = DatabaseProfiler::queryPlan(QSqlDatabase::database(), stats.statement, QList<QVariant>());
+        QRegExp rx("INDEX (\\w+)");
+        int pos = 0;
+        QSet<QString> used;
+        while ((pos = rx.indexIn(plan, pos)) != -1) {
+            used.insert(rx.cap(1));
+            pos += rx.matchedLength();
+        }
+
+        foreach(const QString & index, used) {
+            indexStatements[index]++;
+            indexCalls[index] += stats.calls;
+        }
+    }
+
+    QString indexesString;
+    query.exec("SELECT name, tbl_name FROM sqlite_master WHERE type='index' ORDER BY tbl_name, name");
+    while (query.next()) {
+        const QString index = query.value(0).toString();
+        indexesString.append(QString("<tr><td>%1</td><td>%2</td><td>%3</td><td>%4</td></tr>").arg(
+                                 index, query.value(1).toString(),
+                                 QString::number(indexStatements.value(index)), QString::number(indexCalls.value(index))));
+    }
+
+    page.replace("%INDEXES-INFO%", indexesString);
+
+    return page;
+}
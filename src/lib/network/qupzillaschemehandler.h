@@ -54,6 +54,7 @@ private:
     QString startPage();
     QString speeddialPage();
     QString configPage();
+    QString databasePage();
 
     QBuffer m_buffer;
     QString m_pageName;
@@ -21,8 +21,9 @@
 #include "networkmanager.h"
 #include "opensearchreader.h"
 #include "opensearchengine.h"
-#include "databasewriter.h"
+#include "databaseexecutor.h"
 #include "settings.h"
+#include "sqlquery.h"
 
 #include <QNetworkReply>
 #include <QMessageBox>
@@ -56,7 +57,7 @@ void SearchEnginesManager::loadSettings()
 {
     m_settingsLoaded = true;
 
-    QSqlQuery query;
+    SqlQuery query("searchengines");
     query.exec("SELECT name, icon, url, shortcut, suggestionsUrl FROM search_engines");
     while (query.next()) {
         Engine en;
@@ -289,7 +290,7 @@ void SearchEnginesManager::removeEngine(const Engine &engine)
         return;
     }
 
-    QSqlQuery query;
+    SqlQuery query("searchengines");
     query.prepare("DELETE FROM search_engines WHERE name=? AND url=?");
     query.bindValue(0, engine.name);
     query.bindValue(1, engine.url);
@@ -332,7 +333,7 @@ void SearchEnginesManager::saveSettings()
     //
     // But as long as user is not playing with search engines every run it is acceptable.
 
-    QSqlQuery query;
+    SqlQuery query("searchengines");
     query.exec("DELETE FROM search_engines");
 
     foreach(const Engine & en, m_allEngines) {
@@ -18,6 +18,7 @@
 #include "browsinglibrary.h"
 #include "ui_browsinglibrary.h"
 #include "historymanager.h"
+#include "historymodel.h"
 #include "bookmarksmanager.h"
 #include "rssmanager.h"
 #include "mainapplication.h"
@@ -153,7 +154,21 @@ void BrowsingLibrary::optimizeDatabase()
     mApp->history()->optimizeHistory();
     QString sizeAfter = DownloadItem::fileSizeToString(QFileInfo(profilePath + "browsedata.db").size());
     mApp->restoreOverrideCursor();
-    QMessageBox::information(this, tr("Database Optimized"), tr("Database successfully optimized.<br/><br/><b>Database Size Before: </b>%1<br/><b>Database Size After: </b>%2").arg(sizeBefore, sizeAfter));
+
+    QString text = tr("Database successfully optimized.<br/><br/><b>Database Size Before: </b>%1<br/><b>Database Size After: </b>%2").arg(sizeBefore, sizeAfter);
+
+    const HistoryModel::PruneReport report = mApp->history()->lastPruneReport();
+    if (report.entries > 0 || report.visits > 0 || report.icons > 0) {
+        text.append(tr("<br/><br/><b>Last History Cleanup: </b>%1 pages, %2 visits and %3 icons removed, %4 reclaimed")
+                    .arg(QString::number(report.entries), QString::number(report.visits), QString::number(report.icons),
+                         DownloadItem::fileSizeToString(report.bytes)));
+
+        if (!report.incrementalVacuum) {
+            text.append(tr("<br/>Database was not optimized yet, so the space was not reclaimed until now."));
+        }
+    }
+
+    QMessageBox::information(this, tr("Database Optimized"), text);
 }
 
 void BrowsingLibrary::closeEvent(QCloseEvent* e)
@@ -28,7 +28,6 @@
 #include <QWebSettings>
 #include <QNetworkDiskCache>
 #include <QDateTime>
-#include <QSqlQuery>
 
 ClearPrivateData::ClearPrivateData(QupZilla* mainClass, QWidget* parent)
     : QDialog(parent)
@@ -79,9 +78,14 @@ void ClearPrivateData::dialogAccepted()
             break;
         }
 
-        QSqlQuery query;
-        query.exec("DELETE FROM history WHERE date > " + QString::number(date));
-        query.exec("VACUUM");
+        // Views, menus and completer are updated from HistoryModel signals
+        if (date == 0) {
+            mApp->history()->clearHistory();
+        }
+        else {
+            mApp->history()->clearHistory(QDateTime::fromMSecsSinceEpoch(date));
+        }
+        mApp->history()->optimizeHistory();
     }
     if (ui->cookies->isChecked()) {
         QList<QNetworkCookie> cookies;
@@ -0,0 +1,353 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "databaseexecutor.h"
+#include "databaseprofiler.h"
+
+#include <QThread>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QSqlRecord>
+#include <QDebug>
+
+#define CONNECTION_NAME "DatabaseExecutor"
+#define READ_CONNECTIONS 2
+
+// At most MAXIMUM_BATCH_SIZE statements are executed in one transaction
+#define MAXIMUM_BATCH_SIZE 500
+#define MAXIMUM_CACHED_STATEMENTS 100
+
+DatabaseExecutor::DatabaseExecutor(const QString &databaseFile, QObject* parent)
+    : QObject(parent)
+    , m_lastCallbackId(0)
+{
+    qRegisterMetaType<DatabaseResult>("DatabaseResult");
+
+    m_worker = startWorker(databaseFile, CONNECTION_NAME, false);
+
+    for (int i = 0; i < READ_CONNECTIONS; ++i) {
+        m_readers.append(startWorker(databaseFile, QString("DatabaseReader%1").arg(i), true));
+    }
+}
+
+DatabaseWorker* DatabaseExecutor::startWorker(const QString &databaseFile, const QString &connectionName, bool readOnly)
+{
+    QThread* thread = new QThread(this);
+    DatabaseWorker* worker = new DatabaseWorker(databaseFile, connectionName, readOnly);
+
+    worker->moveToThread(thread);
+    thread->start();
+
+    connect(worker, SIGNAL(jobFinished(int, DatabaseResult)), this, SLOT(jobFinished(int, DatabaseResult)));
+
+    // Connection has to be created in the thread where it is used,
+    // this is the first event processed by worker thread
+    QMetaObject::invokeMethod(worker, "openDatabase", Qt::QueuedConnection);
+
+    return worker;
+}
+
+void DatabaseExecutor::stopWorker(DatabaseWorker* worker)
+{
+    QThread* thread = worker->thread();
+
+    QMetaObject::invokeMethod(worker, "flush", Qt::BlockingQueuedConnection);
+    QMetaObject::invokeMethod(worker, "closeDatabase", Qt::BlockingQueuedConnection);
+    thread->quit();
+    thread->wait();
+
+    delete worker;
+}
+
+QFuture<DatabaseResult> DatabaseExecutor::exec(const QString &statement, const QVariantList &values)
+{
+    return enqueue(m_worker, statement, values, 0, 0);
+}
+
+QFuture<DatabaseResult> DatabaseExecutor::exec(const QString &statement, const QVariantList &values,
+        QObject* receiver, const char* member)
+{
+    return enqueue(m_worker, statement, values, receiver, member);
+}
+
+QFuture<DatabaseResult> DatabaseExecutor::query(const QString &statement, const QVariantList &values)
+{
+    return query(statement, values, 0, 0);
+}
+
+QFuture<DatabaseResult> DatabaseExecutor::query(const QString &statement, const QVariantList &values,
+        QObject* receiver, const char* member)
+{
+    // Least busy reader
+    DatabaseWorker* reader = m_readers.first();
+    int pendingJobs = reader->pendingJobs();
+
+    for (int i = 1; i < m_readers.count() && pendingJobs > 0; ++i) {
+        int jobs = m_readers.at(i)->pendingJobs();
+        if (jobs < pendingJobs) {
+            reader = m_readers.at(i);
+            pendingJobs = jobs;
+        }
+    }
+
+    return enqueue(reader, statement, values, receiver, member);
+}
+
+QFuture<DatabaseResult> DatabaseExecutor::enqueue(DatabaseWorker* worker, const QString &statement, const QVariantList &values,
+        QObject* receiver, const char* member)
+{
+    DatabaseWorker::Job job;
+    job.id = 0;
+    job.statement = statement;
+    job.values = values;
+    job.future.reportStarted();
+
+    if (receiver && member) {
+        // member comes from SLOT() macro, only method name is used
+        QByteArray name(member + 1);
+        name = name.left(name.indexOf('('));
+
+        Callback callback;
+        callback.receiver = receiver;
+        callback.member = name;
+
+        job.id = ++m_lastCallbackId;
+        m_callbacks.insert(job.id, callback);
+    }
+
+    worker->enqueue(job);
+
+    return job.future.future();
+}
+
+void DatabaseExecutor::flush()
+{
+    QMetaObject::invokeMethod(m_worker, "flush", Qt::BlockingQueuedConnection);
+}
+
+QThread* DatabaseExecutor::workerThread() const
+{
+    return m_worker->thread();
+}
+
+QSqlDatabase DatabaseExecutor::database()
+{
+    return QSqlDatabase::database(CONNECTION_NAME);
+}
+
+void DatabaseExecutor::jobFinished(int id, const DatabaseResult &result)
+{
+    const Callback callback = m_callbacks.take(id);
+    QObject* receiver = callback.receiver;
+
+    if (!receiver) {
+        return;
+    }
+
+    const QByteArray signature = callback.member + "(DatabaseResult)";
+    if (receiver->metaObject()->indexOfMethod(signature.constData()) != -1) {
+        QMetaObject::invokeMethod(receiver, callback.member.constData(), Q_ARG(DatabaseResult, result));
+    }
+    else {
+        QMetaObject::invokeMethod(receiver, callback.member.constData());
+    }
+}
+
+DatabaseExecutor::~DatabaseExecutor()
+{
+    foreach(DatabaseWorker * reader, m_readers) {
+        stopWorker(reader);
+    }
+
+    stopWorker(m_worker);
+}
+
+DatabaseWorker::DatabaseWorker(const QString &databaseFile, const QString &connectionName, bool readOnly)
+    : QObject()
+    , m_databaseFile(databaseFile)
+    , m_connectionName(connectionName)
+    , m_readOnly(readOnly)
+    , m_scheduled(false)
+{
+}
+
+void DatabaseWorker::enqueue(const Job &job)
+{
+    QMutexLocker locker(&m_mutex);
+    m_jobs.append(job);
+
+    if (!m_scheduled) {
+        m_scheduled = true;
+        QMetaObject::invokeMethod(this, "processJobs", Qt::QueuedConnection);
+    }
+}
+
+int DatabaseWorker::pendingJobs()
+{
+    QMutexLocker locker(&m_mutex);
+    return m_jobs.count();
+}
+
+void DatabaseWorker::openDatabase()
+{
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", m_connectionName);
+    db.setDatabaseName(m_databaseFile);
+    if (m_readOnly) {
+        db.setConnectOptions("QSQLITE_OPEN_READONLY");
+    }
+
+    if (!db.open()) {
+        qWarning() << "DatabaseWorker: cannot open database" << m_databaseFile;
+    }
+}
+
+void DatabaseWorker::processJobs()
+{
+    QList<Job> jobs;
+    {
+        QMutexLocker locker(&m_mutex);
+        jobs = m_jobs.mid(0, MAXIMUM_BATCH_SIZE);
+        m_jobs = m_jobs.mid(jobs.count());
+
+        if (m_jobs.isEmpty()) {
+            m_scheduled = false;
+        }
+        else {
+            // Rest of jobs is executed after other queued events
+            QMetaObject::invokeMethod(this, "processJobs", Qt::QueuedConnection);
+        }
+    }
+
+    if (jobs.isEmpty()) {
+        return;
+    }
+
+    QSqlDatabase db = QSqlDatabase::database(m_connectionName);
+    bool transaction = !m_readOnly && jobs.count() > 1 && db.transaction();
+
+    QList<DatabaseResult> results;
+    foreach(const Job & job, jobs) {
+        results.append(execute(job));
+    }
+
+    if (transaction && !db.commit()) {
+        const QString error = db.lastError().text();
+        qWarning() << "DatabaseWorker::processJobs cannot commit" << jobs.count() << "statements:" << error;
+        db.rollback();
+
+        for (int i = 0; i < results.count(); ++i) {
+            results[i].success = false;
+            results[i].error = error;
+        }
+    }
+
+    for (int i = 0; i < jobs.count(); ++i) {
+        Job job = jobs.at(i);
+        job.future.reportResult(results.at(i));
+        job.future.reportFinished();
+
+        if (job.id > 0) {
+            emit jobFinished(job.id, results.at(i));
+        }
+    }
+}
+
+DatabaseResult DatabaseWorker::execute(const Job &job)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    if (!m_statements.contains(job.statement)) {
+        if (m_statements.count() >= MAXIMUM_CACHED_STATEMENTS) {
+            m_statements.clear();
+        }
+
+        QSqlQuery query(QSqlDatabase::database(m_connectionName));
+        query.prepare(job.statement);
+        m_statements.insert(job.statement, query);
+    }
+
+    QSqlQuery query = m_statements.value(job.statement);
+
+    for (int i = 0; i < job.values.count(); ++i) {
+        query.bindValue(i, job.values.at(i));
+    }
+
+    DatabaseResult result;
+    result.success = query.exec();
+
+    if (!result.success) {
+        result.error = query.lastError().text();
+        result.elapsed = timer.elapsed();
+        qWarning() << "DatabaseWorker: statement failed" << job.statement << result.error;
+        return result;
+    }
+
+    if (query.isSelect()) {
+        const int columns = query.record().count();
+        while (query.next()) {
+            QVariantList row;
+            for (int i = 0; i < columns; ++i) {
+                row.append(query.value(i));
+            }
+            result.rows.append(row);
+        }
+    }
+
+    result.lastInsertId = query.lastInsertId();
+    result.numRowsAffected = query.numRowsAffected();
+    result.elapsed = timer.elapsed();
+    query.finish();
+
+#if QT_VERSION >= 0x040800
+    const qint64 time = timer.nsecsElapsed() / 1000;
+#else
+    const qint64 time = result.elapsed * 1000;
+#endif
+    const qint64 rows = result.rows.isEmpty() ? qMax(0, result.numRowsAffected) : result.rows.count();
+
+    DatabaseProfiler* profiler = DatabaseProfiler::instance();
+    if (profiler->record(job.statement, m_readOnly ? "reader" : "executor", time, rows)) {
+        profiler->setQueryPlan(job.statement, DatabaseProfiler::queryPlan(QSqlDatabase::database(m_connectionName), job.statement, job.values));
+    }
+
+    return result;
+}
+
+void DatabaseWorker::flush()
+{
+    forever {
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_jobs.isEmpty()) {
+                return;
+            }
+        }
+
+        processJobs();
+    }
+}
+
+void DatabaseWorker::closeDatabase()
+{
+    m_statements.clear();
+
+    QSqlDatabase::database(m_connectionName).close();
+    QSqlDatabase::removeDatabase(m_connectionName);
+}
@@ -0,0 +1,145 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef DATABASEEXECUTOR_H
+#define DATABASEEXECUTOR_H
+
+#include <QObject>
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QPointer>
+#include <QVariant>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QSqlQuery>
+
+#include "qz_namespace.h"
+
+class QThread;
+class QSqlDatabase;
+
+struct DatabaseResult {
+    bool success;
+    QString error;
+    QList<QVariantList> rows;
+    QVariant lastInsertId;
+    int numRowsAffected;
+    // Time spent executing the statement in ms
+    qint64 elapsed;
+
+    DatabaseResult() : success(false), numRowsAffected(-1), elapsed(0) { }
+};
+
+class DatabaseWorker;
+
+// Executes statements in its own thread with its own connection to the
+// profile database. Statements are executed in the order they were queued,
+// all statements waiting in queue are executed in one transaction.
+// Read-only queries are executed in parallel by a small pool of read-only
+// connections (database is in WAL mode, so reads are not blocked by writes).
+// Results are available with returned future or delivered to the callback
+// slot, which takes either const DatabaseResult & or no argument.
+class QT_QUPZILLA_EXPORT DatabaseExecutor : public QObject
+{
+    Q_OBJECT
+public:
+    explicit DatabaseExecutor(const QString &databaseFile, QObject* parent = 0);
+    ~DatabaseExecutor();
+
+    QFuture<DatabaseResult> exec(const QString &statement, const QVariantList &values = QVariantList());
+    QFuture<DatabaseResult> exec(const QString &statement, const QVariantList &values,
+                                 QObject* receiver, const char* member);
+
+    // SELECT statements only, order of queries is not guaranteed
+    QFuture<DatabaseResult> query(const QString &statement, const QVariantList &values = QVariantList());
+    QFuture<DatabaseResult> query(const QString &statement, const QVariantList &values,
+                                  QObject* receiver, const char* member);
+
+    // Returns after all queued statements are executed
+    void flush();
+
+    // Objects moved to worker thread may use its database connection
+    // directly, their queued calls are processed in order with statements
+    QThread* workerThread() const;
+    static QSqlDatabase database();
+
+private slots:
+    void jobFinished(int id, const DatabaseResult &result);
+
+private:
+    struct Callback {
+        QPointer<QObject> receiver;
+        QByteArray member;
+    };
+
+    QFuture<DatabaseResult> enqueue(DatabaseWorker* worker, const QString &statement, const QVariantList &values,
+                                    QObject* receiver, const char* member);
+    DatabaseWorker* startWorker(const QString &databaseFile, const QString &connectionName, bool readOnly);
+    void stopWorker(DatabaseWorker* worker);
+
+    DatabaseWorker* m_worker;
+    QList<DatabaseWorker*> m_readers;
+
+    int m_lastCallbackId;
+    QHash<int, Callback> m_callbacks;
+};
+
+// Lives in DatabaseExecutor's thread
+class QT_QUPZILLA_EXPORT DatabaseWorker : public QObject
+{
+    Q_OBJECT
+public:
+    struct Job {
+        int id;
+        QString statement;
+        QVariantList values;
+        QFutureInterface<DatabaseResult> future;
+    };
+
+    DatabaseWorker(const QString &databaseFile, const QString &connectionName, bool readOnly);
+
+    // Thread-safe
+    void enqueue(const Job &job);
+    int pendingJobs();
+
+public slots:
+    void openDatabase();
+    void processJobs();
+    void flush();
+    void closeDatabase();
+
+signals:
+    void jobFinished(int id, const DatabaseResult &result);
+
+private:
+    DatabaseResult execute(const Job &job);
+
+    QString m_databaseFile;
+    QString m_connectionName;
+    bool m_readOnly;
+
+    QMutex m_mutex;
+    QList<Job> m_jobs;
+    bool m_scheduled;
+
+    QHash<QString, QSqlQuery> m_statements;
+};
+
+Q_DECLARE_METATYPE(DatabaseResult)
+
+#endif // DATABASEEXECUTOR_H
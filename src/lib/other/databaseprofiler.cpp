@@ -0,0 +1,145 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "databaseprofiler.h"
+
+#include <QMutexLocker>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QVariant>
+#include <QtAlgorithms>
+
+// Statements executed longer than SLOW_STATEMENT_TIME (in microseconds) are slow
+#define SLOW_STATEMENT_TIME 50000
+// Statements built by concatenation could fill the table without limit
+#define MAXIMUM_STATEMENTS 1000
+
+static bool statisticsLessThan(const DatabaseProfiler::Statistics &a, const DatabaseProfiler::Statistics &b)
+{
+    return a.totalTime > b.totalTime;
+}
+
+DatabaseProfiler::DatabaseProfiler()
+{
+}
+
+DatabaseProfiler* DatabaseProfiler::instance()
+{
+    static DatabaseProfiler profiler;
+    return &profiler;
+}
+
+bool DatabaseProfiler::record(const QString &statement, const char* subsystem, qint64 time, qint64 rows)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QHash<QString, Statistics>::iterator it = m_statistics.find(statement);
+    if (it == m_statistics.end()) {
+        if (m_statistics.count() >= MAXIMUM_STATEMENTS) {
+            return false;
+        }
+
+        it = m_statistics.insert(statement, Statistics());
+        it.value().statement = statement;
+    }
+
+    Statistics &stats = it.value();
+    const QString subsystemName = QString::fromLatin1(subsystem);
+    if (!stats.subsystems.contains(subsystemName)) {
+        stats.subsystems.append(subsystemName);
+    }
+
+    stats.calls++;
+    stats.totalTime += time;
+    stats.maximumTime = qMax(stats.maximumTime, time);
+    stats.rows += rows;
+
+    if (time < SLOW_STATEMENT_TIME) {
+        return false;
+    }
+
+    stats.slowCalls++;
+    return stats.queryPlan.isEmpty();
+}
+
+void DatabaseProfiler::addRows(const QString &statement, qint64 rows)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QHash<QString, Statistics>::iterator it = m_statistics.find(statement);
+    if (it != m_statistics.end()) {
+        it.value().rows += rows;
+    }
+}
+
+void DatabaseProfiler::setQueryPlan(const QString &statement, const QString &plan)
+{
+    QMutexLocker locker(&m_mutex);
+
+    QHash<QString, Statistics>::iterator it = m_statistics.find(statement);
+    if (it != m_statistics.end()) {
+        it.value().queryPlan = plan;
+    }
+}
+
+QList<DatabaseProfiler::Statistics> DatabaseProfiler::statistics() const
+{
+    QList<Statistics> list;
+    {
+        QMutexLocker locker(&m_mutex);
+        list = m_statistics.values();
+    }
+
+    qSort(list.begin(), list.end(), statisticsLessThan);
+    return list;
+}
+
+void DatabaseProfiler::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_statistics.clear();
+}
+
+QString DatabaseProfiler::queryPlan(QSqlDatabase db, const QString &statement, const QList<QVariant> &values)
+{
+    const QString trimmed = statement.trimmed();
+    if (!trimmed.startsWith(QLatin1String("SELECT"), Qt::CaseInsensitive) &&
+            !trimmed.startsWith(QLatin1String("UPDATE"), Qt::CaseInsensitive) &&
+            !trimmed.startsWith(QLatin1String("DELETE"), Qt::CaseInsensitive) &&
+            !trimmed.startsWith(QLatin1String("INSERT"), Qt::CaseInsensitive)) {
+        return QString();
+    }
+
+    QSqlQuery query(db);
+    query.prepare("EXPLAIN QUERY PLAN " + trimmed);
+    for (int i = 0; i < values.count(); ++i) {
+        query.bindValue(i, values.at(i));
+    }
+
+    if (!query.exec()) {
+        return QString();
+    }
+
+    // Last column is the detail in all SQLite versions
+    QStringList lines;
+    while (query.next()) {
+        lines.append(query.value(query.record().count() - 1).toString());
+    }
+
+    return lines.join("\n");
+}
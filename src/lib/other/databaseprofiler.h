@@ -0,0 +1,73 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef DATABASEPROFILER_H
+#define DATABASEPROFILER_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+
+#include "qz_namespace.h"
+
+class QSqlDatabase;
+
+// Collects execution statistics of all statements executed with SqlQuery
+// and DatabaseExecutor. Recording is one hash lookup under mutex, so it is
+// always enabled. Query plan is captured once for statements that were slow.
+class QT_QUPZILLA_EXPORT DatabaseProfiler
+{
+public:
+    struct Statistics {
+        QString statement;
+        QStringList subsystems;
+        int calls;
+        int slowCalls;
+        qint64 totalTime;
+        qint64 maximumTime;
+        qint64 rows;
+        QString queryPlan;
+
+        Statistics() : calls(0), slowCalls(0), totalTime(0), maximumTime(0), rows(0) { }
+    };
+
+    static DatabaseProfiler* instance();
+
+    // Time is in microseconds. Returns true when the statement was slow
+    // and has no query plan yet, plan should be then set with setQueryPlan()
+    bool record(const QString &statement, const char* subsystem, qint64 time, qint64 rows = 0);
+    void addRows(const QString &statement, qint64 rows);
+    void setQueryPlan(const QString &statement, const QString &plan);
+
+    // Sorted by total time
+    QList<Statistics> statistics() const;
+    void clear();
+
+    // EXPLAIN QUERY PLAN of statement executed in given connection
+    static QString queryPlan(QSqlDatabase db, const QString &statement, const QList<QVariant> &values);
+
+private:
+    DatabaseProfiler();
+
+    mutable QMutex m_mutex;
+    QHash<QString, Statistics> m_statistics;
+};
+
+#endif // DATABASEPROFILER_H
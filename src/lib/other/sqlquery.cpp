@@ -0,0 +1,104 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "sqlquery.h"
+#include "databaseprofiler.h"
+
+#include <QElapsedTimer>
+#include <QVariant>
+
+static qint64 elapsedMicroseconds(const QElapsedTimer &timer)
+{
+#if QT_VERSION >= 0x040800
+    return timer.nsecsElapsed() / 1000;
+#else
+    return timer.elapsed() * 1000;
+#endif
+}
+
+SqlQuery::SqlQuery(const char* subsystem, QSqlDatabase db)
+    : QSqlQuery(QString(), db)
+    , m_database(db.isValid() ? db : QSqlDatabase::database())
+    , m_subsystem(subsystem)
+    , m_rows(0)
+{
+}
+
+bool SqlQuery::exec()
+{
+    recordRows();
+
+    QElapsedTimer timer;
+    timer.start();
+    bool success = QSqlQuery::exec();
+    recordExecution(success, elapsedMicroseconds(timer));
+
+    return success;
+}
+
+bool SqlQuery::exec(const QString &query)
+{
+    recordRows();
+
+    QElapsedTimer timer;
+    timer.start();
+    bool success = QSqlQuery::exec(query);
+    recordExecution(success, elapsedMicroseconds(timer));
+
+    return success;
+}
+
+bool SqlQuery::next()
+{
+    bool hasNext = QSqlQuery::next();
+    if (hasNext) {
+        m_rows++;
+    }
+    return hasNext;
+}
+
+void SqlQuery::recordExecution(bool success, qint64 time)
+{
+    if (!success) {
+        return;
+    }
+
+    m_statement = lastQuery();
+    m_rows = 0;
+
+    // Rows of SELECT are counted while iterating
+    const qint64 rows = isSelect() ? 0 : qMax(0, numRowsAffected());
+    DatabaseProfiler* profiler = DatabaseProfiler::instance();
+
+    if (profiler->record(m_statement, m_subsystem, time, rows)) {
+        profiler->setQueryPlan(m_statement, DatabaseProfiler::queryPlan(m_database, m_statement, boundValues().values()));
+    }
+}
+
+void SqlQuery::recordRows()
+{
+    if (m_rows > 0) {
+        DatabaseProfiler::instance()->addRows(m_statement, m_rows);
+    }
+
+    m_rows = 0;
+}
+
+SqlQuery::~SqlQuery()
+{
+    recordRows();
+}
@@ -15,32 +15,35 @@
 * You should have received a copy of the GNU General Public License
 * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 * ============================================================ */
-#include "databasewriter.h"
+#ifndef SQLQUERY_H
+#define SQLQUERY_H
 
-#include <QThread>
-#include <QTimer>
+#include <QSqlQuery>
+#include <QSqlDatabase>
 
-DatabaseWriter::DatabaseWriter()
-    : QObject()
-{
-    QThread* t = new QThread(this);
-    t->start();
-    moveToThread(t);
-}
+#include "qz_namespace.h"
 
-void DatabaseWriter::executeQuery(const QSqlQuery &query)
+// QSqlQuery that records execution time and number of rows of its
+// statements in DatabaseProfiler. Subsystem should be a string literal
+// naming the caller, eg. "bookmarks".
+class QT_QUPZILLA_EXPORT SqlQuery : public QSqlQuery
 {
-    m_queries.append(query);
+public:
+    explicit SqlQuery(const char* subsystem, QSqlDatabase db = QSqlDatabase());
+    ~SqlQuery();
 
-    QTimer::singleShot(0, this, SLOT(execute()));
-}
+    bool exec();
+    bool exec(const QString &query);
+    bool next();
 
-void DatabaseWriter::execute()
-{
-    if (m_queries.count() == 0) {
-        return;
-    }
+private:
+    void recordExecution(bool success, qint64 time);
+    void recordRows();
+
+    QSqlDatabase m_database;
+    const char* m_subsystem;
+    QString m_statement;
+    qint64 m_rows;
+};
 
-    QSqlQuery query = m_queries.takeLast();
-    query.exec();
-}
+#endif // SQLQUERY_H
@@ -19,6 +19,7 @@
 #include "mainapplication.h"
 #include "pagethumbnailer.h"
 #include "settings.h"
+#include "globalfunctions.h"
 
 #include <QDir>
 #include <QCryptographicHash>
@@ -90,15 +91,7 @@ SpeedDial::Page SpeedDial::pageForUrl(const QUrl &url)
 {
     ENSURE_LOADED;
 
-    const QString &urlString = url.toString();
-
-    foreach(const Page & page, m_webPages) {
-        if (page.url == urlString) {
-            return page;
-        }
-    }
-
-    return Page();
+    return m_urlIndex.value(qz_normalizedUrl(url));
 }
 
 QUrl SpeedDial::urlForShortcut(int key)
@@ -133,6 +126,7 @@ void SpeedDial::addPage(const QUrl &url, const QString &title)
 
     m_webPages.append(page);
     m_regenerateScript = true;
+    updateUrlIndex();
 
     foreach(QWebFrame * frame, cleanFrames()) {
         frame->page()->triggerAction(QWebPage::Reload);
@@ -152,6 +146,7 @@ void SpeedDial::removePage(const Page &page)
     removeImageForUrl(page.url);
     m_webPages.removeAll(page);
     m_regenerateScript = true;
+    updateUrlIndex();
 
     foreach(QWebFrame * frame, cleanFrames()) {
         frame->page()->triggerAction(QWebPage::Reload);
@@ -247,6 +242,7 @@ void SpeedDial::changed(const QString &allPages)
     }
 
     m_regenerateScript = true;
+    updateUrlIndex();
     emit pagesChanged();
 }
 
@@ -369,3 +365,15 @@ QString SpeedDial::generateAllPages()
 
     return allPages;
 }
+
+void SpeedDial::updateUrlIndex()
+{
+    m_urlIndex.clear();
+
+    foreach(const Page & page, m_webPages) {
+        const QString key = qz_normalizedUrl(QUrl(page.url));
+        if (!m_urlIndex.contains(key)) {
+            m_urlIndex.insert(key, page);
+        }
+    }
+}
@@ -20,6 +20,7 @@
 
 #include <QObject>
 #include <QWeakPointer>
+#include <QHash>
 
 #include "qz_namespace.h"
 
@@ -82,6 +83,7 @@ private slots:
 private:
     QList<QWebFrame*> cleanFrames();
     QString generateAllPages();
+    void updateUrlIndex();
 
     QString m_initialScript;
     QString m_thumbnailsDir;
@@ -92,6 +94,8 @@ private:
 
     QList<QWeakPointer<QWebFrame> > m_webFrames;
     QList<Page> m_webPages;
+    // Normalized url (qz_normalizedUrl) -> first page with this url, rebuilt whenever pages change
+    QHash<QString, Page> m_urlIndex;
 
     bool m_loaded;
     bool m_regenerateScript;
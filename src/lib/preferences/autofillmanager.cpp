@@ -18,10 +18,10 @@
 #include "autofillmanager.h"
 #include "autofillmodel.h"
 #include "ui_autofillmanager.h"
+#include "sqlquery.h"
 
 #include <QMenu>
 #include <QTimer>
-#include <QSqlQuery>
 #include <QMessageBox>
 #include <QInputDialog>
 #include <QUrl>
@@ -53,7 +53,7 @@ AutoFillManager::AutoFillManager(QWidget* parent)
 
 void AutoFillManager::loadPasswords()
 {
-    QSqlQuery query;
+    SqlQuery query("autofill");
     query.exec("SELECT server, username, password, id FROM autofill");
     ui->treePass->clear();
     while (query.next()) {
@@ -119,8 +119,10 @@ void AutoFillManager::removePass()
         return;
     }
     QString id = curItem->whatsThis(0);
-    QSqlQuery query;
-    query.exec("DELETE FROM autofill WHERE id=" + id);
+    SqlQuery query("autofill");
+    query.prepare("DELETE FROM autofill WHERE id=?");
+    query.addBindValue(id);
+    query.exec();
 
     delete curItem;
 }
@@ -133,7 +135,7 @@ void AutoFillManager::removeAllPass()
         return;
     }
 
-    QSqlQuery query;
+    SqlQuery query("autofill");
     query.exec("DELETE FROM autofill");
 
     ui->treePass->clear();
@@ -149,7 +151,7 @@ void AutoFillManager::editPass()
     QString text = QInputDialog::getText(this, tr("Edit password"), tr("Change password:"), QLineEdit::Normal, curItem->whatsThis(1), &ok);
 
     if (ok && !text.isEmpty()) {
-        QSqlQuery query;
+        SqlQuery query("autofill");
         query.prepare("SELECT data, password FROM autofill WHERE id=?");
         query.addBindValue(curItem->whatsThis(0));
         query.exec();
@@ -179,15 +181,17 @@ void AutoFillManager::removeExcept()
         return;
     }
     QString id = curItem->whatsThis(0);
-    QSqlQuery query;
-    query.exec("DELETE FROM autofill_exceptions WHERE id=" + id);
+    SqlQuery query("autofill");
+    query.prepare("DELETE FROM autofill_exceptions WHERE id=?");
+    query.addBindValue(id);
+    query.exec();
 
     delete curItem;
 }
 
 void AutoFillManager::removeAllExcept()
 {
-    QSqlQuery query;
+    SqlQuery query("autofill");
     query.exec("DELETE FROM autofill_exceptions");
 
     ui->treeExcept->clear();
@@ -76,7 +76,7 @@ void SSLManager::refreshCAList()
 {
     ui->caList->setUpdatesEnabled(false);
     ui->caList->clear();
-    m_caCerts = QSslSocket::defaultCaCertificates();
+    m_caCerts = mApp->networkManager()->getCaCertificates();
 
     foreach(const QSslCertificate & cert, m_caCerts) {
         if (m_localCerts.contains(cert)) {
@@ -25,8 +25,9 @@
 #include "browsinglibrary.h"
 #include "globalfunctions.h"
 #include "followredirectreply.h"
-#include "databasewriter.h"
+#include "databaseexecutor.h"
 #include "networkmanager.h"
+#include "sqlquery.h"
 
 #include <QMenu>
 #include <QXmlStreamReader>
@@ -78,7 +79,7 @@ void RSSManager::setMainWindow(QupZilla* window)
 
 void RSSManager::refreshTable()
 {
-    QSqlQuery query;
+    SqlQuery query("rss");
     ui->tabWidget->clear();
     query.exec("SELECT address, title, icon FROM rss");
     int i = 0;
@@ -152,6 +153,9 @@ void RSSManager::addFeed()
     }
 
     addRssFeed(url.toString(), tr("New feed"), _iconForUrl(url));
+
+    // New feed is inserted by database executor
+    mApp->dbExecutor()->flush();
     refreshTable();
 }
 
@@ -161,8 +165,7 @@ void RSSManager::deleteFeed()
     if (url.isEmpty()) {
         return;
     }
-    QSqlQuery query;
-    query.exec("DELETE FROM rss WHERE address='" + url + "'");
+    mApp->dbExecutor()->exec("DELETE FROM rss WHERE address=?", QVariantList() << url);
 
     ui->tabWidget->removeTab(ui->tabWidget->currentIndex());
     if (ui->tabWidget->count() == 0) {
@@ -211,15 +214,8 @@ void RSSManager::editFeed()
         return;
     }
 
-    QSqlQuery query;
-    query.prepare("UPDATE rss SET address=?, title=? WHERE address=?");
-    query.bindValue(0, address);
-    query.bindValue(1, title);
-    query.bindValue(2, url);
-    query.exec();
-
-    refreshTable();
-
+    mApp->dbExecutor()->exec("UPDATE rss SET address=?, title=? WHERE address=?",
+                             QVariantList() << address << title << url, this, SLOT(refreshTable()));
 }
 
 void RSSManager::customContextMenuRequested(const QPoint &position)
@@ -378,8 +374,10 @@ bool RSSManager::addRssFeed(const QString &address, const QString &title, const
     if (address.isEmpty()) {
         return false;
     }
-    QSqlQuery query;
-    query.exec("SELECT id FROM rss WHERE address='" + address + "'");
+    SqlQuery query("rss");
+    query.prepare("SELECT id FROM rss WHERE address=?");
+    query.addBindValue(address);
+    query.exec();
     if (!query.next()) {
         QImage image = icon.pixmap(16, 16).toImage();
         QByteArray iconData;
@@ -387,15 +385,13 @@ bool RSSManager::addRssFeed(const QString &address, const QString &title, const
             image.load(":icons/other/feed.png");
         }
 
-        query.prepare("INSERT INTO rss (address, title, icon) VALUES(?,?,?)");
-        query.bindValue(0, address);
-        query.bindValue(1, title);
         QByteArray ba;
         QBuffer buffer(&ba);
         buffer.open(QIODevice::WriteOnly);
         image.save(&buffer, "PNG");
-        query.bindValue(2, buffer.data());
-        mApp->dbWriter()->executeQuery(query);
+
+        mApp->dbExecutor()->exec("INSERT INTO rss (address, title, icon) VALUES(?,?,?)",
+                                 QVariantList() << address << title << buffer.data());
         return true;
     }
 
@@ -24,11 +24,13 @@
 #include "bookmarkstoolbar.h"
 #include "tabwidget.h"
 #include "bookmarksmodel.h"
+#include "fulltextsearch.h"
 
 #include <QMenu>
 #include <QTimer>
 #include <QClipboard>
-#include <QSqlQuery>
+
+#define MAXIMUM_SEARCH_RESULTS 500
 
 BookmarksSideBar::BookmarksSideBar(QupZilla* mainClass, QWidget* parent)
     : QWidget(parent)
@@ -44,7 +46,7 @@ BookmarksSideBar::BookmarksSideBar(QupZilla* mainClass, QWidget* parent)
     connect(ui->bookmarksTree, SIGNAL(itemControlClicked(QTreeWidgetItem*)), this, SLOT(itemControlClicked(QTreeWidgetItem*)));
     connect(ui->bookmarksTree, SIGNAL(itemMiddleButtonClicked(QTreeWidgetItem*)), this, SLOT(itemControlClicked(QTreeWidgetItem*)));
     connect(ui->bookmarksTree, SIGNAL(itemDoubleClicked(QTreeWidgetItem*, int)), this, SLOT(itemDoubleClicked(QTreeWidgetItem*)));
-    connect(ui->search, SIGNAL(textChanged(QString)), ui->bookmarksTree, SLOT(filterString(QString)));
+    connect(ui->search, SIGNAL(textChanged(QString)), this, SLOT(search(QString)));
 
     connect(m_bookmarksModel, SIGNAL(bookmarkAdded(BookmarksModel::Bookmark)), this, SLOT(addBookmark(BookmarksModel::Bookmark)));
     connect(m_bookmarksModel, SIGNAL(bookmarkDeleted(BookmarksModel::Bookmark)), this, SLOT(removeBookmark(BookmarksModel::Bookmark)));
@@ -52,6 +54,7 @@ BookmarksSideBar::BookmarksSideBar(QupZilla* mainClass, QWidget* parent)
     connect(m_bookmarksModel, SIGNAL(folderAdded(QString)), this, SLOT(addFolder(QString)));
     connect(m_bookmarksModel, SIGNAL(folderDeleted(QString)), this, SLOT(removeFolder(QString)));
     connect(m_bookmarksModel, SIGNAL(folderRenamed(QString, QString)), this, SLOT(renameFolder(QString, QString)));
+    connect(m_bookmarksModel, SIGNAL(bookmarksImported(QList<BookmarksModel::Bookmark>)), this, SLOT(refreshTable()));
 
     QTimer::singleShot(0, this, SLOT(refreshTable()));
 }
@@ -126,6 +129,11 @@ void BookmarksSideBar::contextMenuRequested(const QPoint &position)
 
 void BookmarksSideBar::addBookmark(const BookmarksModel::Bookmark &bookmark)
 {
+    if (!ui->search->text().isEmpty()) {
+        search(ui->search->text());
+        return;
+    }
+
     QString translatedFolder = BookmarksModel::toTranslatedFolder(bookmark.folder);
     QTreeWidgetItem* item = new QTreeWidgetItem();
     item->setText(0, bookmark.title);
@@ -140,13 +148,15 @@ void BookmarksSideBar::addBookmark(const BookmarksModel::Bookmark &bookmark)
     else {
         ui->bookmarksTree->addTopLevelItem(item);
     }
-
-//    if (!ui->search->text().isEmpty())
-    item->setHidden(!bookmark.title.contains(ui->search->text(), Qt::CaseInsensitive));
 }
 
 void BookmarksSideBar::removeBookmark(const BookmarksModel::Bookmark &bookmark)
 {
+    if (!ui->search->text().isEmpty()) {
+        search(ui->search->text());
+        return;
+    }
+
     if (bookmark.folder == "unsorted") {
         QList<QTreeWidgetItem*> list = ui->bookmarksTree->findItems(bookmark.title, Qt::MatchExactly);
         if (list.count() == 0) {
@@ -224,27 +234,28 @@ void BookmarksSideBar::refreshTable()
     ui->bookmarksTree->setUpdatesEnabled(false);
     ui->bookmarksTree->clear();
 
-    QSqlQuery query;
     QTreeWidgetItem* newItem = new QTreeWidgetItem(ui->bookmarksTree);
     newItem->setText(0, _bookmarksMenu);
     newItem->setIcon(0, style()->standardIcon(QStyle::SP_DirIcon));
     ui->bookmarksTree->addTopLevelItem(newItem);
 
-    query.exec("SELECT name FROM folders WHERE subfolder!='yes'");
-    while (query.next()) {
+    foreach(const BookmarksModel::Folder & folder, m_bookmarksModel->folders()) {
+        if (folder.subfolder) {
+            continue;
+        }
+
         newItem = new QTreeWidgetItem(ui->bookmarksTree);
-        newItem->setText(0, query.value(0).toString());
+        newItem->setText(0, folder.name);
         newItem->setIcon(0, style()->standardIcon(QStyle::SP_DirIcon));
         ui->bookmarksTree->addTopLevelItem(newItem);
     }
 
-    query.exec("SELECT title, url, id, folder, icon FROM bookmarks");
-    while (query.next()) {
-        QString title = query.value(0).toString();
-        QUrl url = query.value(1).toUrl();
-        int id = query.value(2).toInt();
-        QString folder = query.value(3).toString();
-        QIcon icon = IconProvider::iconFromImage(QImage::fromData(query.value(4).toByteArray()));
+    foreach(const Bookmark & bookmark, m_bookmarksModel->allBookmarks()) {
+        const QString &title = bookmark.title;
+        const QUrl &url = bookmark.url;
+        int id = bookmark.id;
+        QString folder = bookmark.folder;
+        QIcon icon = IconProvider::iconFromImage(bookmark.image);
         QTreeWidgetItem* item;
         if (folder == "bookmarksMenu") {
             folder = _bookmarksMenu;
@@ -280,6 +291,35 @@ void BookmarksSideBar::refreshTable()
     m_isRefreshing = false;
 }
 
+void BookmarksSideBar::search(const QString &string)
+{
+    if (string.isEmpty()) {
+        refreshTable();
+        return;
+    }
+
+    ui->bookmarksTree->setUpdatesEnabled(false);
+    ui->bookmarksTree->clear();
+
+    const QList<BookmarksModel::Bookmark> &list = FullTextSearch::searchBookmarks(string, MAXIMUM_SEARCH_RESULTS);
+    foreach(const BookmarksModel::Bookmark & bookmark, list) {
+        if (bookmark.folder == "bookmarksToolbar") {
+            continue;
+        }
+
+        QTreeWidgetItem* item = new QTreeWidgetItem();
+        item->setText(0, bookmark.title);
+        item->setText(1, bookmark.url.toEncoded());
+        item->setToolTip(0, bookmark.url.toEncoded());
+
+        item->setWhatsThis(0, QString::number(bookmark.id));
+        item->setIcon(0, IconProvider::iconFromImage(bookmark.image));
+        ui->bookmarksTree->addTopLevelItem(item);
+    }
+
+    ui->bookmarksTree->setUpdatesEnabled(true);
+}
+
 BookmarksSideBar::~BookmarksSideBar()
 {
     delete ui;
@@ -44,6 +44,7 @@ public:
 
 public slots:
     void refreshTable();
+    void search(const QString &string);
 
 private slots:
     void deleteItem();
@@ -22,11 +22,11 @@
 #include "mainapplication.h"
 #include "historymodel.h"
 #include "iconprovider.h"
+#include "sqlquery.h"
 
 #include <QMenu>
 #include <QClipboard>
 #include <QTimer>
-#include <QSqlQuery>
 
 HistorySideBar::HistorySideBar(QupZilla* mainClass, QWidget* parent)
     : QWidget(parent)
@@ -45,7 +45,8 @@ HistorySideBar::HistorySideBar(QupZilla* mainClass, QWidget* parent)
     connect(m_historyModel, SIGNAL(historyEntryAdded(HistoryEntry)), this, SLOT(historyEntryAdded(HistoryEntry)));
     connect(m_historyModel, SIGNAL(historyEntryDeleted(HistoryEntry)), this, SLOT(historyEntryDeleted(HistoryEntry)));
     connect(m_historyModel, SIGNAL(historyEntryEdited(HistoryEntry, HistoryEntry)), this, SLOT(historyEntryEdited(HistoryEntry, HistoryEntry)));
-    connect(m_historyModel, SIGNAL(historyClear()), ui->historyTree, SLOT(clear()));
+    connect(m_historyModel, SIGNAL(historyClear()), this, SLOT(historyCleared()));
+    connect(mApp->iconProvider(), SIGNAL(iconLoaded(QUrl)), this, SLOT(iconLoaded(QUrl)));
 
     QTimer::singleShot(0, this, SLOT(slotRefreshTable()));
 }
@@ -146,7 +147,7 @@ void HistorySideBar::historyEntryAdded(const HistoryEntry &entry)
     item->setToolTip(0, entry.url.toEncoded());
 
     item->setWhatsThis(1, QString::number(entry.id));
-    item->setIcon(0, _iconForUrl(entry.url));
+    setItemIcon(item, entry.url);
     ui->historyTree->prependToParentItem(parentItem, item);
 }
 
@@ -160,6 +161,7 @@ void HistorySideBar::historyEntryDeleted(const HistoryEntry &entry)
         if (item->whatsThis(1).toInt() != entry.id) {
             continue;
         }
+        m_itemsByUrl.remove(entry.url.toEncoded(QUrl::RemoveFragment), item);
         ui->historyTree->deleteItem(item);
         return;
     }
@@ -171,14 +173,41 @@ void HistorySideBar::historyEntryEdited(const HistoryEntry &before, const Histor
     historyEntryAdded(after);
 }
 
+void HistorySideBar::historyCleared()
+{
+    m_itemsByUrl.clear();
+    ui->historyTree->clear();
+}
+
+void HistorySideBar::setItemIcon(QTreeWidgetItem* item, const QUrl &url)
+{
+    // Default icon is returned until the icon is loaded
+    item->setIcon(0, IconProvider::iconFromImage(mApp->iconProvider()->cachedIconForUrl(url)));
+    m_itemsByUrl.insert(url.toEncoded(QUrl::RemoveFragment), item);
+}
+
+void HistorySideBar::iconLoaded(const QUrl &url)
+{
+    const QList<QTreeWidgetItem*> items = m_itemsByUrl.values(url.toEncoded());
+    if (items.isEmpty()) {
+        return;
+    }
+
+    const QIcon icon = IconProvider::iconFromImage(mApp->iconProvider()->cachedIconForUrl(url));
+    foreach(QTreeWidgetItem * item, items) {
+        item->setIcon(0, icon);
+    }
+}
+
 void HistorySideBar::slotRefreshTable()
 {
     QApplication::setOverrideCursor(Qt::WaitCursor);
+    m_itemsByUrl.clear();
     ui->historyTree->clear();
 
     QDate todayDate = QDate::currentDate();
     QDate startOfWeekDate = todayDate.addDays(1 - todayDate.dayOfWeek());
-    QSqlQuery query;
+    SqlQuery query("history");
     query.exec("SELECT title, url, id, date FROM history ORDER BY date DESC");
 
     int counter = 0;
@@ -223,7 +252,7 @@ void HistorySideBar::slotRefreshTable()
         item->setToolTip(0, url.toEncoded());
 
         item->setWhatsThis(1, QString::number(id));
-        item->setIcon(0, _iconForUrl(url));
+        setItemIcon(item, url);
         ui->historyTree->addTopLevelItem(item);
 
         ++counter;
@@ -19,6 +19,7 @@
 #define HISTORYSIDEBAR_H
 
 #include <QWidget>
+#include <QMultiHash>
 
 #include "qz_namespace.h"
 #include "historymodel.h"
@@ -52,11 +53,20 @@ private slots:
     void historyEntryAdded(const HistoryEntry &entry);
     void historyEntryDeleted(const HistoryEntry &entry);
     void historyEntryEdited(const HistoryEntry &before, const HistoryEntry &after);
+    void historyCleared();
+
+    void iconLoaded(const QUrl &url);
 
 private:
+    void setItemIcon(QTreeWidgetItem* item, const QUrl &url);
+
     Ui::HistorySideBar* ui;
     QupZilla* p_QupZilla;
     HistoryModel* m_historyModel;
+
+    // Items keyed by encoded url without fragment, so their
+    // icons can be replaced once they are loaded
+    QMultiHash<QByteArray, QTreeWidgetItem*> m_itemsByUrl;
 };
 
 #endif // HISTORYSIDEBAR_H
@@ -27,9 +27,19 @@ FollowRedirectReply::FollowRedirectReply(const QUrl &url, QNetworkAccessManager*
     , m_redirectCount(0)
 {
     m_reply = m_manager->get(QNetworkRequest(url));
+    connect(m_reply, SIGNAL(readyRead()), this, SLOT(replyReadyRead()));
     connect(m_reply, SIGNAL(finished()), this, SLOT(replyFinished()));
 }
 
+void FollowRedirectReply::replyReadyRead()
+{
+    int replyStatus = m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+    if ((replyStatus != 301 && replyStatus != 302) || m_redirectCount == 5) {
+        emit readyRead();
+    }
+}
+
 void FollowRedirectReply::replyFinished()
 {
     int replyStatus = m_reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
@@ -45,6 +55,7 @@ void FollowRedirectReply::replyFinished()
     m_reply->deleteLater();
 
     m_reply = m_manager->get(QNetworkRequest(redirectUrl));
+    connect(m_reply, SIGNAL(readyRead()), this, SLOT(replyReadyRead()));
     connect(m_reply, SIGNAL(finished()), this, SLOT(replyFinished()));
 }
 
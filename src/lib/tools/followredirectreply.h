@@ -37,9 +37,12 @@ public:
     QNetworkReply* reply() { return m_reply; }
 
 signals:
+    // Data of final reply (not of redirects) is available
+    void readyRead();
     void finished();
 
 private slots:
+    void replyReadyRead();
     void replyFinished();
 
 private:
@@ -0,0 +1,232 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "fulltextsearch.h"
+#include "sqlquery.h"
+
+#include <QSqlDatabase>
+#include <QSqlError>
+#include <QStringList>
+#include <QDebug>
+
+static int s_available = -1;
+
+QStringList FullTextSearch::splitWords(const QString &string)
+{
+    QStringList words;
+    QString word;
+
+    const QString lower = string.toLower();
+    for (int i = 0; i < lower.length(); ++i) {
+        const QChar c = lower.at(i);
+        if (c.isLetterOrNumber()) {
+            word.append(c);
+        }
+        else if (!word.isEmpty()) {
+            words.append(word);
+            word.clear();
+        }
+    }
+
+    if (!word.isEmpty()) {
+        words.append(word);
+    }
+
+    words.removeDuplicates();
+    return words;
+}
+
+QString FullTextSearch::matchExpression(const QStringList &words)
+{
+    // Words contains only letters and numbers, so they don't
+    // need to be escaped. All words have to match (implicit AND).
+    QStringList terms;
+    foreach(const QString & word, words) {
+        terms.append(word + QLatin1Char('*'));
+    }
+
+    return terms.join(QLatin1String(" "));
+}
+
+bool FullTextSearch::isAvailable()
+{
+    if (s_available == -1) {
+        SqlQuery query("search");
+        query.exec("SELECT count(*) FROM sqlite_master WHERE name='history_fts' OR name='bookmarks_fts'");
+        s_available = (query.next() && query.value(0).toInt() == 2) ? 1 : 0;
+    }
+
+    return s_available == 1;
+}
+
+void FullTextSearch::createTables(QSqlDatabase db)
+{
+    SqlQuery query("search", db);
+    query.exec("SELECT count(*) FROM sqlite_master WHERE name='history_fts' OR name='bookmarks_fts'");
+    if (query.next() && query.value(0).toInt() == 2) {
+        return;
+    }
+
+    // Leftovers of interrupted creation would make CREATE fail forever
+    query.exec("DROP TRIGGER IF EXISTS history_fts_insert");
+    query.exec("DROP TRIGGER IF EXISTS history_fts_update");
+    query.exec("DROP TRIGGER IF EXISTS history_fts_delete");
+    query.exec("DROP TRIGGER IF EXISTS bookmarks_fts_insert");
+    query.exec("DROP TRIGGER IF EXISTS bookmarks_fts_update");
+    query.exec("DROP TRIGGER IF EXISTS bookmarks_fts_delete");
+    query.exec("DROP TABLE IF EXISTS history_fts");
+    query.exec("DROP TABLE IF EXISTS bookmarks_fts");
+
+    // FTS4 is available since SQLite 3.7.4, older versions may have FTS3.
+    // Module is probed on temporary table, so nothing is left in database when it fails.
+    QString module = QLatin1String("fts4");
+    if (!query.exec("CREATE VIRTUAL TABLE temp.fts_probe USING fts4(x)")) {
+        module = QLatin1String("fts3");
+        if (!query.exec("CREATE VIRTUAL TABLE temp.fts_probe USING fts3(x)")) {
+            qWarning() << "FullTextSearch: SQLite doesn't support full-text search," << query.lastError().text();
+            return;
+        }
+    }
+    query.exec("DROP TABLE temp.fts_probe");
+
+    QStringList statements;
+    statements << QString("CREATE VIRTUAL TABLE history_fts USING %1(title, url)").arg(module)
+               << QString("CREATE VIRTUAL TABLE bookmarks_fts USING %1(title, url)").arg(module)
+               << "INSERT INTO history_fts (docid, title, url) SELECT id, title, url FROM history"
+               << "INSERT INTO bookmarks_fts (docid, title, url) SELECT id, title, url FROM bookmarks"
+               // Triggers keep FTS tables in sync, no matter which code changes content tables
+               << "CREATE TRIGGER history_fts_insert AFTER INSERT ON history BEGIN "
+               "INSERT INTO history_fts (docid, title, url) VALUES (new.id, new.title, new.url); END"
+               << "CREATE TRIGGER history_fts_update AFTER UPDATE OF title, url ON history "
+               "WHEN old.title IS NOT new.title OR old.url IS NOT new.url BEGIN "
+               "UPDATE history_fts SET title=new.title, url=new.url WHERE docid=old.id; END"
+               << "CREATE TRIGGER history_fts_delete AFTER DELETE ON history BEGIN "
+               "DELETE FROM history_fts WHERE docid=old.id; END"
+               << "CREATE TRIGGER bookmarks_fts_insert AFTER INSERT ON bookmarks BEGIN "
+               "INSERT INTO bookmarks_fts (docid, title, url) VALUES (new.id, new.title, new.url); END"
+               << "CREATE TRIGGER bookmarks_fts_update AFTER UPDATE OF title, url ON bookmarks "
+               "WHEN old.title IS NOT new.title OR old.url IS NOT new.url BEGIN "
+               "UPDATE bookmarks_fts SET title=new.title, url=new.url WHERE docid=old.id; END"
+               << "CREATE TRIGGER bookmarks_fts_delete AFTER DELETE ON bookmarks BEGIN "
+               "DELETE FROM bookmarks_fts WHERE docid=old.id; END";
+
+    // Both tables with their triggers are created, or nothing at all
+    db.transaction();
+
+    foreach(const QString & statement, statements) {
+        if (!query.exec(statement)) {
+            qWarning() << "FullTextSearch: cannot create tables," << query.lastError().text();
+            db.rollback();
+            return;
+        }
+    }
+
+    db.commit();
+
+    s_available = -1;
+}
+
+QList<HistoryEntry> FullTextSearch::searchHistory(const QString &string, int limit)
+{
+    QList<HistoryEntry> list;
+
+    const QStringList words = splitWords(string);
+    if (words.isEmpty()) {
+        return list;
+    }
+
+    SqlQuery query("search");
+    if (isAvailable()) {
+        query.prepare("SELECT history.id, history.count, history.date, history.url, history.title, history.frecency "
+                      "FROM history_fts JOIN history ON history.id = history_fts.docid "
+                      "WHERE history_fts MATCH ? ORDER BY history.frecency DESC LIMIT ?");
+        query.addBindValue(matchExpression(words));
+    }
+    else {
+        QStringList conditions;
+        for (int i = 0; i < words.count(); ++i) {
+            conditions.append(QLatin1String("(title LIKE ? OR url LIKE ?)"));
+        }
+
+        query.prepare(QString("SELECT id, count, date, url, title, frecency FROM history WHERE %1 "
+                              "ORDER BY frecency DESC LIMIT ?").arg(conditions.join(QLatin1String(" AND "))));
+        foreach(const QString & word, words) {
+            query.addBindValue(QString("%%1%").arg(word));
+            query.addBindValue(QString("%%1%").arg(word));
+        }
+    }
+    query.addBindValue(limit);
+    query.exec();
+
+    while (query.next()) {
+        HistoryEntry entry;
+        entry.id = query.value(0).toInt();
+        entry.count = query.value(1).toInt();
+        entry.date = QDateTime::fromMSecsSinceEpoch(query.value(2).toLongLong());
+        entry.url = query.value(3).toUrl();
+        entry.title = query.value(4).toString();
+        entry.frecency = query.value(5).toDouble();
+        list.append(entry);
+    }
+
+    return list;
+}
+
+QList<BookmarksModel::Bookmark> FullTextSearch::searchBookmarks(const QString &string, int limit)
+{
+    QList<BookmarksModel::Bookmark> list;
+
+    const QStringList words = splitWords(string);
+    if (words.isEmpty()) {
+        return list;
+    }
+
+    SqlQuery query("search");
+    if (isAvailable()) {
+        query.prepare("SELECT bookmarks.id, bookmarks.title, bookmarks.folder, bookmarks.url, bookmarks.icon "
+                      "FROM bookmarks_fts JOIN bookmarks ON bookmarks.id = bookmarks_fts.docid "
+                      "WHERE bookmarks_fts MATCH ? ORDER BY bookmarks.title COLLATE NOCASE LIMIT ?");
+        query.addBindValue(matchExpression(words));
+    }
+    else {
+        QStringList conditions;
+        for (int i = 0; i < words.count(); ++i) {
+            conditions.append(QLatin1String("(title LIKE ? OR url LIKE ?)"));
+        }
+
+        query.prepare(QString("SELECT id, title, folder, url, icon FROM bookmarks WHERE %1 "
+                              "ORDER BY title COLLATE NOCASE LIMIT ?").arg(conditions.join(QLatin1String(" AND "))));
+        foreach(const QString & word, words) {
+            query.addBindValue(QString("%%1%").arg(word));
+            query.addBindValue(QString("%%1%").arg(word));
+        }
+    }
+    query.addBindValue(limit);
+    query.exec();
+
+    while (query.next()) {
+        BookmarksModel::Bookmark bookmark;
+        bookmark.id = query.value(0).toInt();
+        bookmark.title = query.value(1).toString();
+        bookmark.folder = query.value(2).toString();
+        bookmark.url = query.value(3).toUrl();
+        bookmark.image = QImage::fromData(query.value(4).toByteArray());
+        list.append(bookmark);
+    }
+
+    return list;
+}
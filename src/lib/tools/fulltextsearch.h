@@ -0,0 +1,50 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#ifndef FULLTEXTSEARCH_H
+#define FULLTEXTSEARCH_H
+
+#include <QStringList>
+
+#include "qz_namespace.h"
+#include "historymodel.h"
+#include "bookmarksmodel.h"
+
+class QSqlDatabase;
+
+// Search in titles and urls of history and bookmarks. Search string is
+// split into words and every word has to be prefix of some word of title
+// or url. SQLite FTS tables (kept in sync with content tables by triggers)
+// are used when available, otherwise it falls back to LIKE queries.
+class QT_QUPZILLA_EXPORT FullTextSearch
+{
+public:
+    static QStringList splitWords(const QString &string);
+
+    // History entries are ordered by frecency
+    static QList<HistoryEntry> searchHistory(const QString &string, int limit);
+    // Bookmarks are ordered by title
+    static QList<BookmarksModel::Bookmark> searchBookmarks(const QString &string, int limit);
+
+    static bool isAvailable();
+    static void createTables(QSqlDatabase db);
+
+private:
+    static QString matchExpression(const QStringList &words);
+};
+
+#endif // FULLTEXTSEARCH_H
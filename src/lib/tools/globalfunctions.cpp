@@ -176,6 +176,11 @@ QString qz_urlEncodeQueryString(const QUrl &url)
     return returnString;
 }
 
+QString qz_normalizedUrl(const QUrl &url)
+{
+    return QString::fromUtf8(url.toEncoded(QUrl::RemoveFragment | QUrl::StripTrailingSlash));
+}
+
 QString qz_ensureUniqueFilename(const QString &pathToFile)
 {
     if (!QFile::exists(pathToFile)) {
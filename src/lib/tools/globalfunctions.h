@@ -38,6 +38,8 @@ void QT_QUPZILLA_EXPORT qz_removeDir(const QString &d);
 QString QT_QUPZILLA_EXPORT qz_samePartOfStrings(const QString &one, const QString &other);
 QUrl QT_QUPZILLA_EXPORT qz_makeRelativeUrl(const QUrl &baseUrl, const QUrl &rUrl);
 QString QT_QUPZILLA_EXPORT qz_urlEncodeQueryString(const QUrl &url);
+// Key for url lookups, urls differing only in fragment or trailing slash are equal
+QString QT_QUPZILLA_EXPORT qz_normalizedUrl(const QUrl &url);
 
 QString QT_QUPZILLA_EXPORT qz_ensureUniqueFilename(const QString &name);
 QString QT_QUPZILLA_EXPORT qz_getFileNameFromUrl(const QUrl &url);
@@ -15,13 +15,56 @@
 * You should have received a copy of the GNU General Public License
 * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 * ============================================================ */
-#include <QNetworkReply>
 #include "iconfetcher.h"
 #include "followredirectreply.h"
 
+#include <QNetworkReply>
+#include <QImage>
+
+// Pages without </head> are not downloaded further than this
+#define MAX_HEAD_SIZE 64 * 1024
+
+static QByteArray tagAttribute(const QByteArray &tag, const QByteArray &lowerTag, const QByteArray &name)
+{
+    const QByteArray search = name + '=';
+
+    int pos = lowerTag.indexOf(search);
+    while (pos > 0 && !QChar(lowerTag.at(pos - 1)).isSpace()) {
+        pos = lowerTag.indexOf(search, pos + 1);
+    }
+
+    if (pos == -1 || pos + search.size() >= tag.size()) {
+        return QByteArray();
+    }
+
+    int start = pos + search.size();
+    const char quote = tag.at(start);
+    int end;
+
+    if (quote == '"' || quote == '\'') {
+        ++start;
+        end = tag.indexOf(quote, start);
+        if (end == -1) {
+            end = tag.size();
+        }
+    }
+    else {
+        end = start;
+        while (end < tag.size() && !QChar(tag.at(end)).isSpace() && tag.at(end) != '/') {
+            ++end;
+        }
+    }
+
+    return tag.mid(start, end - start);
+}
+
 IconFetcher::IconFetcher(QObject* parent)
     : QObject(parent)
     , m_manager(0)
+    , m_pageReply(0)
+    , m_iconReply(0)
+    , m_linkScanPos(0)
+    , m_endScanPos(0)
 {
 }
 
@@ -31,68 +74,136 @@ void IconFetcher::fetchIcon(const QUrl &url)
         return;
     }
 
-    FollowRedirectReply* reply = new FollowRedirectReply(url, m_manager);
-    connect(reply, SIGNAL(finished()), this, SLOT(pageDownloaded()));
-
     m_url = url;
+    m_head.clear();
+    m_lowerHead.clear();
+    m_linkScanPos = 0;
+    m_endScanPos = 0;
+    m_iconHref.clear();
+
+    m_pageReply = new FollowRedirectReply(url, m_manager);
+    connect(m_pageReply, SIGNAL(readyRead()), this, SLOT(pageDataReceived()));
+    connect(m_pageReply, SIGNAL(finished()), this, SLOT(pageDownloaded()));
 }
 
-void IconFetcher::pageDownloaded()
+void IconFetcher::abort()
 {
-    FollowRedirectReply* reply = qobject_cast<FollowRedirectReply*> (sender());
-    if (!reply) {
-        return;
+    if (m_pageReply) {
+        m_pageReply->disconnect(this);
+        delete m_pageReply;
+        m_pageReply = 0;
     }
 
-    QString html = reply->reply()->readAll();
-    QUrl replyUrl = reply->reply()->url();
-    reply->deleteLater();
-
-    QRegExp rx("<link(.*)>", Qt::CaseInsensitive);
-    rx.setMinimal(true);
+    if (m_iconReply) {
+        m_iconReply->disconnect(this);
+        delete m_iconReply;
+        m_iconReply = 0;
+    }
+}
 
-    QString shortcutIconTag;
-    int pos = 0;
-    while ((pos = rx.indexIn(html, pos)) != -1) {
-        QString linkTag = rx.cap(0);
-        pos += rx.matchedLength();
+bool IconFetcher::scanHead()
+{
+    // Returns true when icon was found or when the head was scanned completely
+    forever {
+        int linkStart = m_lowerHead.indexOf("<link", m_linkScanPos);
+        if (linkStart == -1) {
+            m_linkScanPos = qMax(m_linkScanPos, m_lowerHead.size() - 4);
+            break;
+        }
 
-        if (linkTag.contains("rel=\"shortcut icon\"", Qt::CaseInsensitive)) {
-            shortcutIconTag = linkTag;
+        int linkEnd = m_lowerHead.indexOf('>', linkStart);
+        if (linkEnd == -1) {
+            // Wait for rest of the tag
+            m_linkScanPos = linkStart;
             break;
         }
+
+        const QByteArray tag = m_head.mid(linkStart + 5, linkEnd - linkStart - 5);
+        const QByteArray lowerTag = m_lowerHead.mid(linkStart + 5, linkEnd - linkStart - 5);
+        m_linkScanPos = linkEnd + 1;
+
+        // rel="icon" and rel="shortcut icon", but not rel="apple-touch-icon"
+        const QList<QByteArray> rel = tagAttribute(lowerTag, lowerTag, "rel").simplified().split(' ');
+        if (rel.contains("icon")) {
+            m_iconHref = tagAttribute(tag, lowerTag, "href").replace("&amp;", "&");
+            if (!m_iconHref.isEmpty()) {
+                return true;
+            }
+        }
     }
 
-    FollowRedirectReply* newReply;
-    if (shortcutIconTag.isEmpty()) {
-//        QUrl faviconUrl = replyUrl.resolved(QUrl("favicon.ico"));
-//
-//        Rather getting favicon.ico from base directory than from subfolders
-        QUrl faviconUrl = QUrl(replyUrl.toString(QUrl::RemovePath | QUrl::RemoveQuery) + "/favicon.ico");
-        newReply = new FollowRedirectReply(faviconUrl, m_manager);
+    int headEnd = m_lowerHead.indexOf("</head", m_endScanPos);
+    if (headEnd == -1) {
+        headEnd = m_lowerHead.indexOf("<body", m_endScanPos);
     }
-    else {
-        QRegExp rx("href=\"(.*)\"", Qt::CaseInsensitive);
-        rx.setMinimal(true);
-        rx.indexIn(shortcutIconTag);
-        QUrl url = QUrl(rx.cap(1));
+    m_endScanPos = qMax(0, m_lowerHead.size() - 6);
+
+    return headEnd != -1 || m_head.size() > MAX_HEAD_SIZE;
+}
 
-        QUrl iconUrl = QUrl(replyUrl).resolved(url);
-        newReply = new FollowRedirectReply(iconUrl, m_manager);
+void IconFetcher::pageDataReceived()
+{
+    if (!m_pageReply) {
+        return;
     }
 
-    connect(newReply, SIGNAL(finished()), this, SLOT(iconDownloaded()));
+    const QByteArray data = m_pageReply->reply()->readAll();
+    m_head.append(data);
+    m_lowerHead.append(data.toLower());
+
+    if (scanHead()) {
+        requestIcon();
+    }
+}
+
+void IconFetcher::pageDownloaded()
+{
+    if (!m_pageReply) {
+        return;
+    }
+
+    const QByteArray data = m_pageReply->reply()->readAll();
+    m_head.append(data);
+    m_lowerHead.append(data.toLower());
+
+    scanHead();
+    requestIcon();
+}
+
+void IconFetcher::requestIcon()
+{
+    QUrl replyUrl = m_pageReply->reply()->url();
+
+    // Rest of the page is not needed
+    m_pageReply->disconnect(this);
+    m_pageReply->deleteLater();
+    m_pageReply = 0;
+
+    m_head.clear();
+    m_lowerHead.clear();
+
+    QUrl iconUrl;
+    if (m_iconHref.isEmpty()) {
+        // Rather getting favicon.ico from base directory than from subfolders
+        iconUrl = QUrl(replyUrl.toString(QUrl::RemovePath | QUrl::RemoveQuery) + "/favicon.ico");
+    }
+    else {
+        iconUrl = replyUrl.resolved(QUrl(QString::fromUtf8(m_iconHref)));
+    }
+
+    m_iconReply = new FollowRedirectReply(iconUrl, m_manager);
+    connect(m_iconReply, SIGNAL(finished()), this, SLOT(iconDownloaded()));
 }
 
 void IconFetcher::iconDownloaded()
 {
-    FollowRedirectReply* reply = qobject_cast<FollowRedirectReply*> (sender());
-    if (!reply) {
+    if (!m_iconReply) {
         return;
     }
 
-    QByteArray response = reply->reply()->readAll();
-    reply->deleteLater();
+    QByteArray response = m_iconReply->reply()->readAll();
+    m_iconReply->deleteLater();
+    m_iconReply = 0;
 
     if (!response.isEmpty()) {
         QImage image;
@@ -104,3 +215,8 @@ void IconFetcher::iconDownloaded()
 
     emit finished();
 }
+
+IconFetcher::~IconFetcher()
+{
+    abort();
+}
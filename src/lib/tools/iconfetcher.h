@@ -35,6 +35,8 @@ class QT_QUPZILLA_EXPORT IconFetcher : public QObject
     Q_OBJECT
 public:
     explicit IconFetcher(QObject* parent = 0);
+    ~IconFetcher();
+
     void setNetworkAccessManager(QNetworkAccessManager* manager) { m_manager = manager; }
     void fetchIcon(const QUrl &url);
 
@@ -48,13 +50,28 @@ signals:
     void finished();
 
 public slots:
+    // Stops downloading, finished() is not emitted
+    void abort();
 
 private slots:
+    void pageDataReceived();
     void pageDownloaded();
     void iconDownloaded();
 
 private:
+    bool scanHead();
+    void requestIcon();
+
     QNetworkAccessManager* m_manager;
+    FollowRedirectReply* m_pageReply;
+    FollowRedirectReply* m_iconReply;
+
+    // Only head of the page is downloaded, <link> tags are parsed as data arrive
+    QByteArray m_head;
+    QByteArray m_lowerHead;
+    int m_linkScanPos;
+    int m_endScanPos;
+    QByteArray m_iconHref;
 
     QVariant m_data;
     QUrl m_url;
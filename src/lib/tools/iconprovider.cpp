@@ -18,14 +18,31 @@
 #include "iconprovider.h"
 #include "webview.h"
 #include "mainapplication.h"
-#include "databasewriter.h"
+#include "databaseexecutor.h"
+#include "sqlquery.h"
 
 #include <QTimer>
 #include <QBuffer>
+#include <QFutureWatcher>
+#include <QtConcurrentRun>
+#include <QDebug>
+#include <QCryptographicHash>
+
+// Decoded 16x16 icon takes 1 KiB, so this is enough for about 2000 icons
+#define ICON_CACHE_SIZE 2 * 1024 * 1024
+#define MAXIMUM_ICONS_PER_QUERY 20
 
 IconProvider::IconProvider(QObject* parent)
     : QObject(parent)
+    , m_saveWatcher(0)
+    , m_savingBatches(0)
+    , m_loadScheduled(false)
+    , m_cacheHits(0)
+    , m_cacheMisses(0)
 {
+    m_urlCache.setMaxCost(ICON_CACHE_SIZE);
+    m_hostCache.setMaxCost(ICON_CACHE_SIZE / 4);
+
     m_timer = new QTimer(this);
     m_timer->setInterval(10 * 1000);
     m_timer->start();
@@ -40,37 +57,48 @@ void IconProvider::saveIcon(WebView* view)
         return;
     }
 
-    Icon item;
-    item.image = view->icon().pixmap(16, 16).toImage();
-    item.url = view->url();
+    const QImage image = view->icon().pixmap(16, 16).toImage();
+    const QUrl url = view->url();
+    const QByteArray key = url.toEncoded(QUrl::RemoveFragment);
 
-    if (item.image == QWebSettings::webGraphic(QWebSettings::DefaultFrameIconGraphic).toImage()) {
+    if (image == QWebSettings::webGraphic(QWebSettings::DefaultFrameIconGraphic).toImage()) {
         return;
     }
 
-    foreach(const Icon & ic, m_iconBuffer) {
-        if (ic.url == item.url && ic.image == item.image) {
-            return;
-        }
+    const QImage* cached = m_urlCache.object(key);
+    if (cached && *cached == image) {
+        return;
     }
 
-    m_iconBuffer.append(item);
+    m_iconBuffer.insert(key, image);
+    m_pendingIcons.remove(key);
+
+    insertToCache(m_urlCache, key, image);
+    insertToCache(m_hostCache, url.host().toUtf8(), image);
 }
 
 QImage IconProvider::iconForUrl(const QUrl &url)
 {
-    foreach(const Icon & ic, m_iconBuffer) {
-        if (ic.url == url) {
-            return ic.image;
-        }
+    const QByteArray key = url.toEncoded(QUrl::RemoveFragment);
+
+    QImage unsaved;
+    if (unsavedIcon(key, &unsaved)) {
+        return unsaved;
     }
 
-    QSqlQuery query;
-    query.prepare("SELECT icon FROM icons WHERE url=?");
-    query.bindValue(0, url.toEncoded(QUrl::RemoveFragment));
-    query.exec();
-    if (query.next()) {
-        return QImage::fromData(query.value(0).toByteArray());
+    const QImage* cached = cachedImage(m_urlCache, key);
+    if (!cached) {
+        SqlQuery query("icons");
+        query.prepare("SELECT d.icon FROM icon_urls u JOIN icon_data d ON d.id=u.data_id WHERE u.url=?");
+        query.addBindValue(QString::fromUtf8(key));
+        query.exec();
+
+        insertToCache(m_urlCache, key, query.next() ? QImage::fromData(query.value(0).toByteArray()) : QImage());
+        cached = m_urlCache.object(key);
+    }
+
+    if (cached && !cached->isNull()) {
+        return *cached;
     }
 
     return QWebSettings::webGraphic(QWebSettings::DefaultFrameIconGraphic).toImage();
@@ -78,55 +106,321 @@ QImage IconProvider::iconForUrl(const QUrl &url)
 
 QImage IconProvider::iconForDomain(const QUrl &url)
 {
-    foreach(const Icon & ic, m_iconBuffer) {
-        if (ic.url.host() == url.host()) {
-            return ic.image;
+    const QByteArray key = url.host().toUtf8();
+
+    QImage unsaved;
+    if (unsavedHostIcon(url.host(), &unsaved)) {
+        return unsaved;
+    }
+
+    const QImage* cached = cachedImage(m_hostCache, key);
+    if (!cached) {
+        SqlQuery query("icons");
+        query.prepare("SELECT d.icon FROM icon_hosts h JOIN icon_data d ON d.id=h.data_id WHERE h.host=?");
+        query.addBindValue(url.host());
+        query.exec();
+
+        insertToCache(m_hostCache, key, query.next() ? QImage::fromData(query.value(0).toByteArray()) : QImage());
+        cached = m_hostCache.object(key);
+    }
+
+    return cached ? *cached : QImage();
+}
+
+QImage IconProvider::cachedIconForUrl(const QUrl &url)
+{
+    const QByteArray key = url.toEncoded(QUrl::RemoveFragment);
+
+    QImage unsaved;
+    if (unsavedIcon(key, &unsaved)) {
+        return unsaved;
+    }
+
+    const QImage* cached = cachedImage(m_urlCache, key);
+    if (cached && !cached->isNull()) {
+        return *cached;
+    }
+
+    if (!cached && !m_pendingIcons.contains(key)) {
+        m_pendingIcons.insert(key);
+        m_queuedIcons.append(key);
+
+        if (!m_loadScheduled) {
+            m_loadScheduled = true;
+            QTimer::singleShot(0, this, SLOT(loadPendingIcons()));
+        }
+    }
+
+    return QWebSettings::webGraphic(QWebSettings::DefaultFrameIconGraphic).toImage();
+}
+
+IconProvider::CacheStatistics IconProvider::cacheStatistics() const
+{
+    CacheStatistics stats;
+    stats.icons = m_urlCache.count() + m_hostCache.count();
+    stats.memory = m_urlCache.totalCost() + m_hostCache.totalCost();
+    stats.hits = m_cacheHits;
+    stats.misses = m_cacheMisses;
+
+    return stats;
+}
+
+void IconProvider::loadPendingIcons()
+{
+    m_loadScheduled = false;
+
+    // Every url gets a row, so urls without icon are known too
+    while (!m_queuedIcons.isEmpty()) {
+        QStringList selects;
+        QVariantList values;
+
+        while (!m_queuedIcons.isEmpty() && values.count() < MAXIMUM_ICONS_PER_QUERY) {
+            selects.append(QLatin1String("SELECT ? AS url"));
+            values.append(QString::fromUtf8(m_queuedIcons.takeFirst()));
+        }
+
+        mApp->dbExecutor()->query(QString("SELECT k.url, u.data_id, d.icon FROM (%1) k LEFT JOIN icon_urls u ON u.url=k.url "
+                                          "LEFT JOIN icon_data d ON d.id=u.data_id")
+                                  .arg(selects.join(QLatin1String(" UNION ALL "))),
+                                  values, this, SLOT(iconsQueried(DatabaseResult)));
+    }
+}
+
+void IconProvider::iconsQueried(const DatabaseResult &result)
+{
+    if (!result.success) {
+        qWarning() << "IconProvider::iconsQueried Cannot load icons" << result.error;
+        return;
+    }
+
+    QFutureWatcher<DecodedIcons>* watcher = new QFutureWatcher<DecodedIcons>(this);
+    connect(watcher, SIGNAL(finished()), this, SLOT(iconsDecoded()));
+    watcher->setFuture(QtConcurrent::run(&IconProvider::decodeIcons, result.rows));
+}
+
+void IconProvider::iconsDecoded()
+{
+    QFutureWatcher<DecodedIcons>* watcher = static_cast<QFutureWatcher<DecodedIcons>*>(sender());
+    if (!watcher) {
+        return;
+    }
+
+    const DecodedIcons icons = watcher->result();
+    watcher->deleteLater();
+
+    for (int i = 0; i < icons.count(); ++i) {
+        const QByteArray &key = icons.at(i).first;
+        const QImage &image = icons.at(i).second;
+
+        // Icon may have been cleared or saved while it was loading
+        if (!m_pendingIcons.remove(key)) {
+            continue;
+        }
+
+        insertToCache(m_urlCache, key, image);
+
+        if (!image.isNull()) {
+            emit iconLoaded(QUrl::fromEncoded(key));
+        }
+    }
+}
+
+IconProvider::DecodedIcons IconProvider::decodeIcons(const QList<QVariantList> &rows)
+{
+    DecodedIcons icons;
+    // Pages of one site mostly share the same icon, it is decoded only once
+    QHash<int, QImage> decoded;
+
+    foreach(const QVariantList & row, rows) {
+        const QByteArray url = row.value(0).toString().toUtf8();
+        const int dataId = row.value(1).toInt();
+
+        if (dataId > 0 && !decoded.contains(dataId)) {
+            decoded.insert(dataId, QImage::fromData(row.value(2).toByteArray()));
+        }
+
+        icons.append(qMakePair(url, decoded.value(dataId)));
+    }
+
+    return icons;
+}
+
+// Icons not yet in database may have been evicted from cache, they
+// must not be looked up in database
+bool IconProvider::unsavedIcon(const QByteArray &key, QImage* image) const
+{
+    QHash<QByteArray, QImage>::const_iterator it = m_iconBuffer.constFind(key);
+    if (it == m_iconBuffer.constEnd()) {
+        it = m_savingIcons.constFind(key);
+        if (it == m_savingIcons.constEnd()) {
+            return false;
         }
     }
 
-    QSqlQuery query;
-    query.exec("SELECT icon FROM icons WHERE url LIKE '%" + url.host() + "%'");
-    if (query.next()) {
-        return QImage::fromData(query.value(0).toByteArray());
+    *image = it.value();
+    return true;
+}
+
+bool IconProvider::unsavedHostIcon(const QString &host, QImage* image) const
+{
+    // Both buffers hold only icons of last few seconds
+    const QHash<QByteArray, QImage>* buffers[] = { &m_iconBuffer, &m_savingIcons };
+
+    for (int i = 0; i < 2; ++i) {
+        QHash<QByteArray, QImage>::const_iterator it = buffers[i]->constBegin();
+        while (it != buffers[i]->constEnd()) {
+            if (QUrl::fromEncoded(it.key()).host() == host) {
+                *image = it.value();
+                return true;
+            }
+            ++it;
+        }
+    }
+
+    return false;
+}
+
+const QImage* IconProvider::cachedImage(QCache<QByteArray, QImage> &cache, const QByteArray &key)
+{
+    const QImage* image = cache.object(key);
+    if (image) {
+        ++m_cacheHits;
+    }
+    else {
+        ++m_cacheMisses;
     }
 
-    return QImage();
+    return image;
+}
+
+void IconProvider::insertToCache(QCache<QByteArray, QImage> &cache, const QByteArray &key, const QImage &image)
+{
+    cache.insert(key, new QImage(image), qMax(1, image.byteCount()));
 }
 
 void IconProvider::saveIconsToDatabase()
 {
-    foreach(const Icon & ic, m_iconBuffer) {
-        QSqlQuery query;
-        query.prepare("SELECT id FROM icons WHERE url = ?");
-        query.bindValue(0, ic.url.toEncoded(QUrl::RemoveFragment));
-        query.exec();
+    // Previous icons are still being encoded, remaining icons will be saved next time
+    if (m_saveWatcher || m_iconBuffer.isEmpty()) {
+        return;
+    }
 
-        if (query.next()) {
-            query.prepare("UPDATE icons SET icon = ? WHERE url = ?");
+    m_saveWatcher = new QFutureWatcher<EncodedIcons>(this);
+    connect(m_saveWatcher, SIGNAL(finished()), this, SLOT(iconsEncoded()));
+    m_saveWatcher->setFuture(QtConcurrent::run(&IconProvider::encodeIcons, m_iconBuffer));
+
+    m_savingIcons.unite(m_iconBuffer);
+    m_iconBuffer.clear();
+}
+
+void IconProvider::flushIcons()
+{
+    if (m_saveWatcher) {
+        m_saveWatcher->waitForFinished();
+        queueIcons(m_saveWatcher->result());
+
+        delete m_saveWatcher;
+        m_saveWatcher = 0;
+    }
+
+    queueIcons(encodeIcons(m_iconBuffer));
+    m_savingIcons.unite(m_iconBuffer);
+    m_iconBuffer.clear();
+}
+
+void IconProvider::iconsEncoded()
+{
+    if (!m_saveWatcher || sender() != m_saveWatcher) {
+        return;
+    }
+
+    queueIcons(m_saveWatcher->result());
+
+    m_saveWatcher->deleteLater();
+    m_saveWatcher = 0;
+}
+
+IconProvider::EncodedIcons IconProvider::encodeIcons(const QHash<QByteArray, QImage> &icons)
+{
+    EncodedIcons encoded;
+
+    QHash<QByteArray, QImage>::const_iterator it = icons.constBegin();
+    while (it != icons.constEnd()) {
+        QBuffer buffer;
+        buffer.open(QIODevice::WriteOnly);
+        it.value().save(&buffer, "PNG");
+
+        EncodedIcon icon;
+        icon.url = QString::fromUtf8(it.key());
+        icon.host = QUrl::fromEncoded(it.key()).host();
+        icon.data = buffer.data();
+        icon.hash = iconHash(icon.data);
+        encoded.append(icon);
+
+        ++it;
+    }
+
+    return encoded;
+}
+
+void IconProvider::queueIcons(const EncodedIcons &icons)
+{
+    if (icons.isEmpty()) {
+        return;
+    }
+
+    // All icons are written in one transaction, icon data is stored only once
+    for (int i = 0; i < icons.count(); ++i) {
+        const EncodedIcon &icon = icons.at(i);
+        mApp->dbExecutor()->exec("INSERT OR IGNORE INTO icon_data (hash, icon) VALUES (?, ?)",
+                                 QVariantList() << icon.hash << icon.data);
+        mApp->dbExecutor()->exec("INSERT OR REPLACE INTO icon_urls (url, data_id) SELECT ?, id FROM icon_data WHERE hash=?",
+                                 QVariantList() << icon.url << icon.hash);
+
+        const QString statement = "INSERT OR REPLACE INTO icon_hosts (host, data_id) SELECT ?, id FROM icon_data WHERE hash=?";
+        if (i == icons.count() - 1) {
+            // Statements are executed in order, so all icons are stored once the last one is
+            mApp->dbExecutor()->exec(statement, QVariantList() << icon.host << icon.hash, this, SLOT(iconsWritten()));
         }
         else {
-            query.prepare("INSERT INTO icons (icon, url) VALUES (?,?)");
+            mApp->dbExecutor()->exec(statement, QVariantList() << icon.host << icon.hash);
         }
+    }
 
-        QByteArray ba;
-        QBuffer buffer(&ba);
-        buffer.open(QIODevice::WriteOnly);
-        ic.image.save(&buffer, "PNG");
-        query.bindValue(0, buffer.data());
-        query.bindValue(1, ic.url.toEncoded(QUrl::RemoveFragment));
-        mApp->dbWriter()->executeQuery(query);
+    ++m_savingBatches;
+}
+
+void IconProvider::iconsWritten()
+{
+    if (--m_savingBatches > 0) {
+        return;
     }
 
-    m_iconBuffer.clear();
+    m_savingBatches = 0;
+    m_savingIcons.clear();
+}
+
+QString IconProvider::iconHash(const QByteArray &data)
+{
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
 }
 
 void IconProvider::clearIconDatabase()
 {
-    QSqlQuery query;
-    query.exec("DELETE FROM icons");
+    flushIcons();
+    mApp->dbExecutor()->flush();
+
+    SqlQuery query("icons");
+    query.exec("DELETE FROM icon_urls");
+    query.exec("DELETE FROM icon_hosts");
+    query.exec("DELETE FROM icon_data");
     query.exec("VACUUM");
 
-    m_iconBuffer.clear();
+    m_urlCache.clear();
+    m_hostCache.clear();
+    m_savingIcons.clear();
+    m_pendingIcons.clear();
+    m_queuedIcons.clear();
 }
 
 QIcon IconProvider::standardIcon(QStyle::StandardPixmap icon)
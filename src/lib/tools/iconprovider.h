@@ -24,6 +24,11 @@
 #include <QImage>
 #include <QUrl>
 #include <QStyle>
+#include <QCache>
+#include <QHash>
+#include <QSet>
+#include <QPair>
+#include <QFutureWatcher>
 
 #include "qz_namespace.h"
 
@@ -31,6 +36,7 @@ class QTimer;
 class QIcon;
 
 class WebView;
+struct DatabaseResult;
 
 class QT_QUPZILLA_EXPORT IconProvider : public QObject
 {
@@ -41,10 +47,32 @@ public:
 
     void clearIconDatabase();
 
+    struct CacheStatistics {
+        int icons;
+        int memory;
+        int hits;
+        int misses;
+    };
+
     void saveIcon(WebView* view);
+    // Both query database when icon is not cached, prefer cachedIconForUrl
+    // in views that can update their icons later
     QImage iconForUrl(const QUrl &url);
     QImage iconForDomain(const QUrl &url);
 
+    // Returns icon from cache, or default icon when it is not cached yet.
+    // Icon is then loaded and decoded in background and iconLoaded(url)
+    // is emitted once it is available.
+    QImage cachedIconForUrl(const QUrl &url);
+
+    CacheStatistics cacheStatistics() const;
+
+    // Encodes all waiting icons and queues them to database executor
+    void flushIcons();
+
+    // Icons are stored in database by hash of their PNG data
+    static QString iconHash(const QByteArray &data);
+
     static QIcon iconFromImage(const QImage &image);
 
     static QIcon iconFromBase64(const QByteArray &data);
@@ -55,20 +83,59 @@ public:
     static QIcon fromTheme(const QString &icon);
 
 signals:
+    void iconLoaded(const QUrl &url);
 
 public slots:
     void saveIconsToDatabase();
 
+private slots:
+    void loadPendingIcons();
+    void iconsQueried(const DatabaseResult &result);
+    void iconsDecoded();
+    void iconsEncoded();
+    void iconsWritten();
+
 private:
+    typedef QList<QPair<QByteArray, QImage> > DecodedIcons;
+    static DecodedIcons decodeIcons(const QList<QVariantList> &rows);
+
+    struct EncodedIcon {
+        QString url;
+        QString host;
+        QString hash;
+        QByteArray data;
+    };
+
+    typedef QList<EncodedIcon> EncodedIcons;
+    static EncodedIcons encodeIcons(const QHash<QByteArray, QImage> &icons);
+    void queueIcons(const EncodedIcons &icons);
+
+    bool unsavedIcon(const QByteArray &key, QImage* image) const;
+    bool unsavedHostIcon(const QString &host, QImage* image) const;
+
+    const QImage* cachedImage(QCache<QByteArray, QImage> &cache, const QByteArray &key);
+    void insertToCache(QCache<QByteArray, QImage> &cache, const QByteArray &key, const QImage &image);
+
     QTimer* m_timer;
 
-    struct Icon {
-        QUrl url;
-        QImage image;
-    };
+    // Icons waiting to be saved, keyed by encoded url
+    QHash<QByteArray, QImage> m_iconBuffer;
+    QFutureWatcher<EncodedIcons>* m_saveWatcher;
+    // Icons being encoded or written, kept until the write is committed
+    QHash<QByteArray, QImage> m_savingIcons;
+    int m_savingBatches;
+
+    // Decoded icons keyed by encoded url and by host,
+    // null image means there is no icon in database
+    QCache<QByteArray, QImage> m_urlCache;
+    QCache<QByteArray, QImage> m_hostCache;
 
-    QList<Icon> m_iconBuffer;
+    QSet<QByteArray> m_pendingIcons;
+    QList<QByteArray> m_queuedIcons;
+    bool m_loadScheduled;
 
+    int m_cacheHits;
+    int m_cacheMisses;
 };
 
 #endif // ICONPROVIDER_H
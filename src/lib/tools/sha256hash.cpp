@@ -0,0 +1,182 @@
+/* ============================================================
+* QupZilla - WebKit based browser
+* Copyright (C) 2010-2012  David Rosca <nowrep@gmail.com>
+*
+* This program is free software: you can redistribute it and/or modify
+* it under the terms of the GNU General Public License as published by
+* the Free Software Foundation, either version 3 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+* GNU General Public License for more details.
+*
+* You should have received a copy of the GNU General Public License
+* along with this program.  If not, see <http://www.gnu.org/licenses/>.
+* ============================================================ */
+#include "sha256hash.h"
+
+#include <string.h>
+
+static const quint32 roundConstants[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+static inline quint32 rotateRight(quint32 value, int bits)
+{
+    return (value >> bits) | (value << (32 - bits));
+}
+
+Sha256Hash::Sha256Hash()
+{
+    reset();
+}
+
+void Sha256Hash::reset()
+{
+    m_state[0] = 0x6a09e667;
+    m_state[1] = 0xbb67ae85;
+    m_state[2] = 0x3c6ef372;
+    m_state[3] = 0xa54ff53a;
+    m_state[4] = 0x510e527f;
+    m_state[5] = 0x9b05688c;
+    m_state[6] = 0x1f83d9ab;
+    m_state[7] = 0x5be0cd19;
+
+    m_bufferLength = 0;
+    m_length = 0;
+}
+
+void Sha256Hash::addData(const QByteArray &data)
+{
+    addData(data.constData(), data.size());
+}
+
+void Sha256Hash::addData(const char* data, int length)
+{
+    const uchar* input = reinterpret_cast<const uchar*>(data);
+    m_length += length;
+
+    if (m_bufferLength > 0) {
+        int count = qMin(64 - m_bufferLength, length);
+        memcpy(m_buffer + m_bufferLength, input, count);
+        m_bufferLength += count;
+        input += count;
+        length -= count;
+
+        if (m_bufferLength < 64) {
+            return;
+        }
+
+        processBlock(m_buffer);
+        m_bufferLength = 0;
+    }
+
+    while (length >= 64) {
+        processBlock(input);
+        input += 64;
+        length -= 64;
+    }
+
+    if (length > 0) {
+        memcpy(m_buffer, input, length);
+        m_bufferLength = length;
+    }
+}
+
+QByteArray Sha256Hash::result() const
+{
+    // Padding is added to copy, so more data can be added after reading result
+    Sha256Hash copy(*this);
+
+    quint64 bitLength = m_length * 8;
+    uchar padding[72];
+    int paddingLength = (m_bufferLength < 56 ? 56 : 120) - m_bufferLength;
+
+    memset(padding, 0, sizeof(padding));
+    padding[0] = 0x80;
+    copy.addData(reinterpret_cast<const char*>(padding), paddingLength);
+
+    uchar lengthBytes[8];
+    for (int i = 0; i < 8; ++i) {
+        lengthBytes[i] = uchar(bitLength >> (56 - i * 8));
+    }
+    copy.addData(reinterpret_cast<const char*>(lengthBytes), 8);
+
+    QByteArray digest(32, 0);
+    for (int i = 0; i < 8; ++i) {
+        digest[i * 4] = char(copy.m_state[i] >> 24);
+        digest[i * 4 + 1] = char(copy.m_state[i] >> 16);
+        digest[i * 4 + 2] = char(copy.m_state[i] >> 8);
+        digest[i * 4 + 3] = char(copy.m_state[i]);
+    }
+
+    return digest;
+}
+
+QByteArray Sha256Hash::hash(const QByteArray &data)
+{
+    Sha256Hash sha;
+    sha.addData(data);
+    return sha.result();
+}
+
+void Sha256Hash::processBlock(const uchar* block)
+{
+    quint32 w[64];
+
+    for (int i = 0; i < 16; ++i) {
+        w[i] = (quint32(block[i * 4]) << 24) | (quint32(block[i * 4 + 1]) << 16) |
+               (quint32(block[i * 4 + 2]) << 8) | quint32(block[i * 4 + 3]);
+    }
+
+    for (int i = 16; i < 64; ++i) {
+        quint32 s0 = rotateRight(w[i - 15], 7) ^ rotateRight(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        quint32 s1 = rotateRight(w[i - 2], 17) ^ rotateRight(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    quint32 a = m_state[0];
+    quint32 b = m_state[1];
+    quint32 c = m_state[2];
+    quint32 d = m_state[3];
+    quint32 e = m_state[4];
+    quint32 f = m_state[5];
+    quint32 g = m_state[6];
+    quint32 h = m_state[7];
+
+    for (int i = 0; i < 64; ++i) {
+        quint32 s1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+        quint32 ch = (e & f) ^ (~e & g);
+        quint32 temp1 = h + s1 + ch + roundConstants[i] + w[i];
+        quint32 s0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+        quint32 maj = (a & b) ^ (a & c) ^ (b & c);
+        quint32 temp2 = s0 + maj;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+
+    m_state[0] += a;
+    m_state[1] += b;
+    m_state[2] += c;
+    m_state[3] += d;
+    m_state[4] += e;
+    m_state[5] += f;
+    m_state[6] += g;
+    m_state[7] += h;
+}
@@ -15,30 +15,34 @@
 * You should have received a copy of the GNU General Public License
 * along with this program.  If not, see <http://www.gnu.org/licenses/>.
 * ============================================================ */
-#ifndef DATABASEWRITER_H
-#define DATABASEWRITER_H
+#ifndef SHA256HASH_H
+#define SHA256HASH_H
 
-#include <QObject>
-#include <QSqlQuery>
-#include <QList>
+#include <QByteArray>
 
 #include "qz_namespace.h"
 
-class QT_QUPZILLA_EXPORT DatabaseWriter : public QObject
+// Incremental SHA-256 (FIPS 180-4), QCryptographicHash in Qt 4 supports only MD4, MD5 and SHA-1
+class QT_QUPZILLA_EXPORT Sha256Hash
 {
-    Q_OBJECT
 public:
-    explicit DatabaseWriter();
+    explicit Sha256Hash();
 
-    void executeQuery(const QSqlQuery &query);
+    void addData(const char* data, int length);
+    void addData(const QByteArray &data);
+    void reset();
 
-signals:
+    QByteArray result() const;
 
-private slots:
-    void execute();
+    static QByteArray hash(const QByteArray &data);
 
 private:
-    QList<QSqlQuery> m_queries;
+    void processBlock(const uchar* block);
+
+    quint32 m_state[8];
+    uchar m_buffer[64];
+    int m_bufferLength;
+    quint64 m_length;
 };
 
-#endif // DATABASEWRITER_H
+#endif // SHA256HASH_H
@@ -20,9 +20,9 @@
 #include "qupzilla.h"
 #include "webpage.h"
 #include "tabbedwebview.h"
+#include "sqlquery.h"
 
 #include <QToolTip>
-#include <QSqlQuery>
 
 SiteInfoWidget::SiteInfoWidget(QupZilla* mainClass, QWidget* parent)
     : QMenu(parent)
@@ -46,10 +46,12 @@ SiteInfoWidget::SiteInfoWidget(QupZilla* mainClass, QWidget* parent)
     }
 
     QString scheme = url.scheme();
-    QSqlQuery query;
+    SqlQuery query("history");
     QString host = url.host();
 
-    query.exec("SELECT sum(count) FROM history WHERE url LIKE '" + scheme + "://" + host + "%' ");
+    query.prepare("SELECT sum(count) FROM history WHERE url LIKE ?");
+    query.addBindValue(scheme + "://" + host + "%");
+    query.exec();
     if (query.next()) {
         int count = query.value(0).toInt();
         if (count > 3) {
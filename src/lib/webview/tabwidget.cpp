@@ -100,6 +100,7 @@ TabWidget::TabWidget(QupZilla* mainClass, QWidget* parent)
     connect(m_tabBar, SIGNAL(closeTab(int)), this, SLOT(closeTab(int)));
     connect(m_tabBar, SIGNAL(closeAllButCurrent(int)), this, SLOT(closeAllButCurrent(int)));
     connect(m_tabBar, SIGNAL(duplicateTab(int)), this, SLOT(duplicateTab(int)));
+    connect(mApp->iconProvider(), SIGNAL(iconLoaded(QUrl)), this, SLOT(iconLoaded(QUrl)));
     connect(m_tabBar, SIGNAL(tabMoved(int, int)), this, SLOT(tabMoved(int, int)));
 
     connect(m_tabBar, SIGNAL(moveAddTabButton(int)), this, SLOT(moveAddTabButton(int)));
@@ -282,7 +283,7 @@ int TabWidget::addView(QUrl url, const QString &title, const Qz::NewTabPositionF
 
     setTabText(index, title);
     webView->animationLoading(index, true)->movie()->stop();
-    webView->animationLoading(index, false)->setPixmap(_iconForUrl(url).pixmap(16, 16));
+    webView->animationLoading(index, false)->setPixmap(IconProvider::iconFromImage(mApp->iconProvider()->cachedIconForUrl(url)).pixmap(16, 16));
 
     if (openFlags & Qz::NT_SelectedTab) {
         setCurrentIndex(index);
@@ -399,6 +400,18 @@ void TabWidget::tabMoved(int before, int after)
     m_lastBackgroundTabIndex = -1;
 }
 
+void TabWidget::iconLoaded(const QUrl &url)
+{
+    const QByteArray key = url.toEncoded();
+
+    for (int i = 0; i < count(); ++i) {
+        TabbedWebView* view = weView(i);
+        if (view && view->url().toEncoded(QUrl::RemoveFragment) == key) {
+            view->showIcon();
+        }
+    }
+}
+
 void TabWidget::setTabText(int index, const QString &text)
 {
     QString newtext = text;
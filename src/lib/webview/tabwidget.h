@@ -105,6 +105,7 @@ private slots:
     void actionChangeIndex();
     void currentTabChanged(int index);
     void tabMoved(int before, int after);
+    void iconLoaded(const QUrl &url);
 
 private:
     void resizeEvent(QResizeEvent* e);
@@ -47,6 +47,7 @@ WebView::WebView(QWidget* parent)
     , m_currentZoom(100)
     , m_isLoading(false)
     , m_progress(0)
+    , m_typedLoad(false)
     , m_clickedFrame(0)
     , m_actionsHaveImages(false)
 {
@@ -78,7 +79,8 @@ QIcon WebView::icon() const
         return m_siteIcon;
     }
 
-    return _iconForUrl(url());
+    // TabWidget updates tab icons once the icon is loaded
+    return IconProvider::iconFromImage(mApp->iconProvider()->cachedIconForUrl(url()));
 }
 
 QString WebView::title() const
@@ -123,6 +125,8 @@ void WebView::load(const QUrl &url)
         return;
     }
 
+    m_typedLoad = true;
+
     if (isUrlValid(url)) {
         QWebView::load(url);
         emit urlChanged(url);
@@ -293,8 +297,9 @@ void WebView::slotLoadFinished()
     m_progress = 100;
 
     if (m_lastUrl != url()) {
-        mApp->history()->addHistoryEntry(this);
+        mApp->history()->addHistoryEntry(this, m_typedLoad ? HistoryModel::TypedTransition : HistoryModel::LinkTransition);
     }
+    m_typedLoad = false;
 
     mApp->autoFill()->completePage(qobject_cast<WebPage*>(page()));
 
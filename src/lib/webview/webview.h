@@ -140,6 +140,8 @@ private:
     int m_progress;
     QUrl m_aboutToLoadUrl;
     QUrl m_lastUrl;
+    // Page was loaded by user (location bar, bookmarks), not by following link
+    bool m_typedLoad;
 
     QWebElement m_mediaElement;
     QWebFrame* m_clickedFrame;